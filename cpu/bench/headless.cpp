@@ -0,0 +1,252 @@
+#include "simulation.h"
+#include "timestepper.h"
+
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#define DEFAULT_TICKS 600
+#define DEFAULT_TIMESTEP (1. / 60.)
+#define DEFAULT_WARMUP 10
+
+struct SceneInfo {
+    SimulationType type;
+    const char *name;
+    const char *path; // scene file to load instead of a built-in scene
+};
+
+static const SceneInfo SCENES[] = {
+    {FRICTION_TEST, "FRICTION_TEST", NULL},
+    {SDF_TEST, "SDF_TEST", NULL},
+    {GRANULAR_TEST, "GRANULAR_TEST", NULL},
+    {STACKS_TEST, "STACKS_TEST", NULL},
+    {WALL_TEST, "WALL_TEST", NULL},
+    {PENDULUM_TEST, "PENDULUM_TEST", NULL},
+    {ROPE_TEST, "ROPE_TEST", NULL},
+    {FLUID_TEST, "FLUID_TEST", NULL},
+    {FLUID_SOLID_TEST, "FLUID_SOLID_TEST", NULL},
+    {GAS_TEST, "GAS_TEST", NULL},
+    {GAS_ROPE_TEST, "GAS_ROPE_TEST", NULL},
+    {WATER_BALLOON_TEST, "WATER_BALLOON_TEST", NULL},
+    {CRADLE_TEST, "CRADLE_TEST", NULL},
+    {SMOKE_OPEN_TEST, "SMOKE_OPEN_TEST", NULL},
+    {SMOKE_CLOSED_TEST, "SMOKE_CLOSED_TEST", NULL},
+    {VOLCANO_TEST, "VOLCANO_TEST", NULL},
+    {WRECKING_BALL, "WRECKING_BALL", NULL},
+};
+#define NUM_SCENES (int)(sizeof(SCENES) / sizeof(SCENES[0]))
+
+static const char *GROUP_NAMES[NUM_CONSTRAINT_GROUPS] = {"stabilization", "contact", "standard", "shape"};
+
+// Nearest rank percentile of sorted times
+static double percentile(const std::vector<double> &sorted, double p) {
+    int rank = (int)ceil(p / 100. * sorted.size());
+    return sorted[std::min(std::max(rank, 1), (int)sorted.size()) - 1];
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "usage: %s [--ticks N] [--dt SECONDS] [--substeps N] [--warmup N] [--trajectory PATH [--quantum Q]]\n"
+                    "       [--trace PATH] [SCENE ...]\n",
+            prog);
+    fprintf(stderr, "runs every built-in scene when none are given, scenes may be given by name or number\n");
+    fprintf(stderr, "or as the path of a .scene file. Each tick of dt is split into substeps that share the\n");
+    fprintf(stderr, "solver iterations. --trajectory records the timed ticks of a single scene,\n");
+    fprintf(stderr, "rounding to multiples of Q when given. --trace writes the timed ticks of every scene as a\n");
+    fprintf(stderr, "Chrome trace. Built-in scenes:\n");
+    for (int s = 0; s < NUM_SCENES; s++) {
+        fprintf(stderr, "  %2d %s\n", s, SCENES[s].name);
+    }
+}
+
+// Runs one scene, timing each tick, and writes its results as a JSON object
+static void runScene(const SceneInfo &scene, int ticks, TimeStepper *stepper, int warmup, const char *trajectory, double quantum,
+                     TraceWriter *trace, bool last) {
+    Simulation sim;
+    srand(0);
+    if (scene.path != NULL) {
+        sim.load(scene.path);
+    } else {
+        sim.init(scene.type);
+    }
+
+    for (int t = 0; t < warmup; t++) {
+        stepper->step(&sim);
+    }
+
+    TrajectoryWriter recorder;
+    if (trajectory != NULL) {
+        if (!recorder.open(trajectory, quantum)) {
+            exit(1);
+        }
+        sim.setRecorder(&recorder);
+    }
+
+    sim.resetProfiler();
+    sim.setTrace(trace);
+    TraceWriter::Clock::time_point sceneStart = TraceWriter::Clock::now();
+    std::vector<double> times(ticks);
+    double particleTicks = 0, constraints[NUM_CONSTRAINT_GROUPS] = {0};
+    for (int t = 0; t < ticks; t++) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        stepper->step(&sim);
+        times[t] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        particleTicks += sim.getNumParticles();
+        for (int g = 0; g < NUM_CONSTRAINT_GROUPS; g++) {
+            constraints[g] += sim.getNumConstraints((ConstraintGroup)g);
+        }
+    }
+
+    sim.setTrace(NULL);
+    if (trace != NULL) {
+        trace->event(scene.name, "scene", sceneStart, TraceWriter::Clock::now());
+    }
+
+    // Includes waiting for the writer to catch up, which the tick times don't
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    sim.setRecorder(NULL);
+    bool recorded = recorder.close();
+    double closeTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    double total = 0;
+    for (int t = 0; t < ticks; t++) {
+        total += times[t];
+    }
+    std::vector<double> sorted(times);
+    std::sort(sorted.begin(), sorted.end());
+
+    printf("    {\n");
+    printf("      \"scene\": \"%s\",\n", scene.name);
+    printf("      \"particles\": %d,\n", sim.getNumParticles());
+    printf("      \"constraints_per_tick\": {");
+    for (int g = 0; g < NUM_CONSTRAINT_GROUPS; g++) {
+        printf("%s\"%s\": %.1f", g ? ", " : "", GROUP_NAMES[g], constraints[g] / ticks);
+    }
+    printf("},\n");
+
+    // Stage and group times are means per tick, neighbor counts are per fluid or gas particle
+    const TickProfile &profile = sim.getProfiler().getTotals();
+    printf("      \"stage_ms\": {");
+    for (int i = 0; i < NUM_TICK_STAGES; i++) {
+        printf("%s\"%s\": %.4f", i ? ", " : "", TickProfiler::getStageName((TickStage)i),
+               1000. * profile.stageSeconds[i] / ticks);
+    }
+    printf("},\n");
+    printf("      \"group_ms\": {");
+    for (int g = 0; g < NUM_CONSTRAINT_GROUPS; g++) {
+        printf("%s\"%s\": %.4f", g ? ", " : "", GROUP_NAMES[g], 1000. * profile.groupSeconds[g] / ticks);
+    }
+    printf("},\n");
+    printf("      \"contact_candidates_per_tick\": %.1f,\n", (double)profile.numCandidates / ticks);
+    printf("      \"neighbors\": {\"mean\": %.2f, \"max\": %d},\n",
+           profile.numListed > 0 ? (double)profile.numNeighbors / profile.numListed : 0., profile.maxNeighbors);
+    printf("      \"sleeping_per_tick\": {\"particles\": %.1f, \"awake_islands\": %.1f},\n",
+           (double)profile.numAsleep / ticks, (double)profile.numIslands / ticks);
+    printf("      \"ms_per_tick\": {\"mean\": %.4f, \"min\": %.4f, \"p50\": %.4f, \"p90\": %.4f, \"p99\": %.4f, "
+           "\"max\": %.4f},\n",
+           total / ticks, sorted.front(), percentile(sorted, 50), percentile(sorted, 90), percentile(sorted, 99),
+           sorted.back());
+    printf("      \"particles_per_second\": %.1f,\n", total > 0 ? particleTicks / (total / 1000.) : 0.);
+    printf("      \"kinetic_energy\": %.6g%s\n", sim.getKineticEnergy(), trajectory != NULL ? "," : "");
+    if (trajectory != NULL) {
+        // Raw size counts the positions, velocities and phases recorded each frame
+        double raw = particleTicks * (4 * sizeof(double) + sizeof(Phase));
+        printf("      \"trajectory\": {\"path\": \"%s\", \"ok\": %s, \"frames\": %d, \"bytes\": %llu, "
+               "\"bytes_per_frame\": %.1f, \"compression_ratio\": %.2f, \"close_ms\": %.4f}\n",
+               trajectory, recorded ? "true" : "false", recorder.getNumFrames(),
+               (unsigned long long)recorder.getBytesWritten(), (double)recorder.getBytesWritten() / ticks,
+               recorder.getBytesWritten() > 0 ? raw / recorder.getBytesWritten() : 0., closeTime);
+    }
+    printf("    }%s\n", last ? "" : ",");
+    fflush(stdout);
+}
+
+// Steps built-in scenes at a fixed timestep as fast as possible with no window or GL context,
+// and reports per tick timings and problem sizes as JSON on stdout
+int main(int argc, char *argv[]) {
+    int ticks = DEFAULT_TICKS, warmup = DEFAULT_WARMUP;
+    double dt = DEFAULT_TIMESTEP, quantum = 0;
+    int substeps = 1;
+    const char *trajectory = NULL, *tracePath = NULL;
+    std::vector<SceneInfo> scenes;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--ticks") && i + 1 < argc) {
+            ticks = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--dt") && i + 1 < argc) {
+            dt = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--substeps") && i + 1 < argc) {
+            substeps = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--warmup") && i + 1 < argc) {
+            warmup = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--trajectory") && i + 1 < argc) {
+            trajectory = argv[++i];
+        } else if (!strcmp(argv[i], "--quantum") && i + 1 < argc) {
+            quantum = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--trace") && i + 1 < argc) {
+            tracePath = argv[++i];
+        } else if (argv[i][0] == '-') {
+            usage(argv[0]);
+            return strcmp(argv[i], "--help") ? 1 : 0;
+        } else if (strstr(argv[i], ".scene") != NULL) {
+            // Check the file up front, so a bad scene doesn't leave half written output behind
+            SceneFile file;
+            if (!file.load(argv[i])) {
+                return 1;
+            }
+            SceneInfo info = {FRICTION_TEST, argv[i], argv[i]};
+            scenes.push_back(info);
+        } else {
+            int found = -1;
+            for (int s = 0; s < NUM_SCENES; s++) {
+                if (!strcmp(argv[i], SCENES[s].name)) {
+                    found = s;
+                }
+            }
+            char *end;
+            long index = strtol(argv[i], &end, 10);
+            if (found < 0 && *end == '\0' && index >= 0 && index < NUM_SCENES) {
+                found = index;
+            }
+            if (found < 0) {
+                fprintf(stderr, "unknown scene %s\n", argv[i]);
+                usage(argv[0]);
+                return 1;
+            }
+            scenes.push_back(SCENES[found]);
+        }
+    }
+    if (ticks <= 0 || dt <= 0 || substeps <= 0 || quantum < 0 || (trajectory != NULL && scenes.size() != 1)) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (scenes.empty()) {
+        for (int s = 0; s < NUM_SCENES; s++) {
+            scenes.push_back(SCENES[s]);
+        }
+    }
+
+    TimeStepper stepper(dt, substeps);
+
+    TraceWriter trace;
+    if (tracePath != NULL && !trace.open(tracePath)) {
+        return 1;
+    }
+
+    printf("{\n");
+    printf("  \"ticks\": %d,\n", ticks);
+    printf("  \"warmup\": %d,\n", warmup);
+    printf("  \"dt\": %.6g,\n", dt);
+    printf("  \"substeps\": %d,\n", stepper.getSubsteps());
+    printf("  \"iterations_per_substep\": %d,\n", stepper.getIterationsPerSubstep());
+    printf("  \"scenes\": [\n");
+    for (unsigned int i = 0; i < scenes.size(); i++) {
+        runScene(scenes[i], ticks, &stepper, warmup, trajectory, quantum, tracePath != NULL ? &trace : NULL,
+                 i + 1 == scenes.size());
+    }
+    printf("  ]\n");
+    printf("}\n");
+    return trace.close() ? 0 : 1;
+}
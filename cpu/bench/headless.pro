@@ -0,0 +1,51 @@
+# Headless runner, steps the built-in scenes with no window or GL context and reports
+# per tick timings as JSON. Builds against QtCore only.
+QT = core
+
+TARGET = headless
+TEMPLATE = app
+CONFIG += console c++0x
+CONFIG -= app_bundle
+
+QMAKE_CXXFLAGS += -std=c++0x -pthread
+LIBS += -pthread
+DEFINES += HEADLESS
+
+INCLUDEPATH += .. ../src ../src/solver ../src/constraint ../glm
+DEPENDPATH += .. ../src ../src/solver ../src/constraint ../glm
+
+SOURCES += headless.cpp \
+    ../src/simulation.cpp \
+    ../src/particle.cpp \
+    ../src/particlestore.cpp \
+    ../src/framearena.cpp \
+    ../src/threadpool.cpp \
+    ../src/tickprofiler.cpp \
+    ../src/timestepper.cpp \
+    ../src/tracewriter.cpp \
+    ../src/spatialgrid.cpp \
+    ../src/neighborlist.cpp \
+    ../src/islands.cpp \
+    ../src/constraint/distanceconstraint.cpp \
+    ../src/solver/lineareq.cpp \
+    ../src/solver/compressedmatrix.cpp \
+    ../src/solver/pcgequation.cpp \
+    ../src/solver/choleskyequation.cpp \
+    ../src/solver/matrix.cpp \
+    ../src/solver/solver.cpp \
+    ../src/constraint/totalshapeconstraint.cpp \
+    ../src/constraint/boundaryconstraint.cpp \
+    ../src/constraint/contactconstraint.cpp \
+    ../src/constraint/totalfluidconstraint.cpp \
+    ../src/constraint/rigidcontactconstraint.cpp \
+    ../src/constraint/gasconstraint.cpp \
+    ../src/constraint/constraintbatches.cpp \
+    ../src/constraint/sphkernels.cpp \
+    ../src/opensmokeemitter.cpp \
+    ../src/fluidemitter.cpp \
+    ../src/scenefile.cpp \
+    ../src/snapshot.cpp \
+    ../src/trajectory.cpp
+
+LIBS += -lumfpack -lamd -lcholmod -lcolamd -lccolamd -lsuitesparseconfig -lblas -llapack
+INCLUDEPATH += /usr/include/suitesparse
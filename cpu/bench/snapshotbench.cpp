@@ -0,0 +1,71 @@
+#include "simulation.h"
+
+#include <chrono>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define SCENE_PATH "snapshotbench.scene"
+#define SNAPSHOT_PATH "snapshotbench.snap"
+#define NUM_REPEATS 5
+
+static double msSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// A scene of about 12 * scale * scale particles, half in a fluid block and half in 3x2 boxes,
+// plus a rope across the top
+static void writeScene(int scale) {
+    FILE *file = fopen(SCENE_PATH, "w");
+    double width = scale * 3.;
+    fprintf(file, "boundaries %f %f 0 1000000\n", -width - 1, width + 1);
+    fprintf(file, "shape box 3 2\n");
+    fprintf(file, "fluid 1.75 %f 0 0 %f .5 1 .2\n", -width, scale * .5);
+    for (int i = 0; i < scale * scale; i++) {
+        fprintf(file, "body box %f %f 4 1\n", .75 + (i % (2 * scale)) * 1.5, 1. + (i / (2 * scale)) * 1.1);
+    }
+    fprintf(file, "rope %f %f %f %f .25 1 pinned\n", -width, scale * 2. + 4, width, scale * 2. + 4);
+    fclose(file);
+}
+
+// Compares saving and restoring snapshots against building the same scene from its scene
+// file, for scenes of increasing size. Restoring is a header check plus one copy per array.
+int main() {
+    printf("%10s %8s %12s %10s %12s %12s\n", "particles", "bodies", "snapshot KB", "save ms", "restore ms", "rebuild ms");
+
+    for (int scale = 4; scale <= 128; scale *= 2) {
+        writeScene(scale);
+
+        srand(0);
+        Simulation sim;
+        sim.load(SCENE_PATH);
+        sim.tick(.01);
+
+        double save = 0, restore = 0, rebuild = 0;
+        for (int r = 0; r < NUM_REPEATS; r++) {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            sim.saveSnapshot(SNAPSHOT_PATH);
+            save += msSince(start);
+
+            Simulation restored;
+            start = std::chrono::steady_clock::now();
+            restored.loadSnapshot(SNAPSHOT_PATH);
+            restore += msSince(start);
+
+            Simulation rebuilt;
+            start = std::chrono::steady_clock::now();
+            rebuilt.load(SCENE_PATH);
+            rebuild += msSince(start);
+        }
+
+        struct stat info;
+        stat(SNAPSHOT_PATH, &info);
+        int numBodies = scale * scale;
+        printf("%10d %8d %12.1f %10.3f %12.3f %12.3f\n", sim.getNumParticles(), numBodies, info.st_size / 1024.,
+               save / NUM_REPEATS, restore / NUM_REPEATS, rebuild / NUM_REPEATS);
+    }
+
+    unlink(SCENE_PATH);
+    unlink(SNAPSHOT_PATH);
+    return 0;
+}
@@ -0,0 +1,35 @@
+#include "simulation.h"
+
+#include <chrono>
+#include <stdio.h>
+
+#define NUM_TICKS 100
+#define TIMESTEP .01
+
+// Runs each scene with each matrix solver backend from the same start, reporting time per tick
+// and the final kinetic energy so the backends can be checked against each other
+int main() {
+    SimulationType scenes[] = {ROPE_TEST, PENDULUM_TEST, WRECKING_BALL};
+    const char *sceneNames[] = {"ROPE_TEST", "PENDULUM_TEST", "WRECKING_BALL"};
+    const char *backendNames[] = {"UMFPACK LU", "conjugate gradient", "CHOLMOD Cholesky"};
+
+    for (int s = 0; s < 3; s++) {
+        printf("%s, %d ticks\n", sceneNames[s], NUM_TICKS);
+        for (int b = 0; b < NUM_SOLVER_BACKENDS; b++) {
+            srand(0);
+            Simulation sim;
+            sim.init(scenes[s]);
+            sim.setSolverBackend((SolverBackend)b);
+
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            for (int t = 0; t < NUM_TICKS; t++) {
+                sim.tick(TIMESTEP);
+            }
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+            printf("  %-20s %9.3f ms/tick  (%d particles, kinetic energy %.6f)\n",
+                   backendNames[b], ms / NUM_TICKS, sim.getNumParticles(), sim.getKineticEnergy());
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,138 @@
+#include "sphkernels.h"
+
+#include <chrono>
+#include <stdio.h>
+
+// Constants of TotalFluidConstraint
+#define K_P .1
+#define E_P 4
+#define DQ_P .2
+
+#define NUM_PARTICLES 4096
+#define NUM_ROUNDS 50
+
+// One fluid particle's neighbors, packed the same way SPHNeighbors lays them out
+struct Block {
+    std::vector<int> offsets;
+    std::vector<double> rx, ry, mass, solid, lambda;
+};
+
+// Particles on a jittered grid at the usual particle spacing, each with every other particle within H
+static void makeBlock(Block *b) {
+    int side = 64;
+    std::vector<glm::dvec2> ps;
+    srand(0);
+    for (int i = 0; i < NUM_PARTICLES; i++) {
+        double jx = (rand() / (double)RAND_MAX - .5) * .1, jy = (rand() / (double)RAND_MAX - .5) * .1;
+        ps.push_back(glm::dvec2((i % side) * PARTICLE_DIAM + jx, (i / side) * PARTICLE_DIAM + jy));
+    }
+
+    b->offsets.push_back(0);
+    for (int i = 0; i < NUM_PARTICLES; i++) {
+        int cx = i % side, cy = i / side;
+        for (int y = cy - 4; y <= cy + 4; y++) {
+            for (int x = cx - 4; x <= cx + 4; x++) {
+                int j = y * side + x;
+                if (x < 0 || y < 0 || x >= side || y >= side || j == i) {
+                    continue;
+                }
+                glm::dvec2 r = ps[i] - ps[j];
+                if (glm::dot(r, r) < H2) {
+                    b->rx.push_back(r.x);
+                    b->ry.push_back(r.y);
+                    b->mass.push_back(1.);
+                    b->solid.push_back(j % 7 == 0 ? 0. : 1.);
+                    b->lambda.push_back(-.01 * (j % 5));
+                }
+            }
+        }
+        b->offsets.push_back(b->rx.size());
+    }
+}
+
+// The per-neighbor math the constraints used before the packed kernels, kept here for comparison
+static double poly6(double r2) {
+    if (r2 >= H2)
+        return 0;
+    double term2 = (H2 - r2);
+    return (315. / (64. * M_PI * H9)) * (term2 * term2 * term2);
+}
+
+static glm::dvec2 spikyGrad(const glm::dvec2 &r, double rlen) {
+    if (rlen >= H)
+        return glm::dvec2();
+    if (rlen == 0)
+        return glm::dvec2();
+    return -glm::normalize(r) * (45. / (M_PI * H6)) * (H - rlen) * (H - rlen);
+}
+
+static double runScalar(const Block &b) {
+    double check = 0.;
+    for (int k = 0; k < NUM_PARTICLES; k++) {
+        double pi = 0., denom = 0.;
+        glm::dvec2 sum = glm::dvec2(), delta = glm::dvec2();
+        for (int x = b.offsets[k]; x < b.offsets[k + 1]; x++) {
+            glm::dvec2 r = glm::dvec2(b.rx[x], b.ry[x]);
+            double rlen = glm::length(r);
+            pi += poly6(glm::dot(r, r)) * b.mass[x];
+            glm::dvec2 gr = spikyGrad(r, rlen);
+            denom += glm::dot(gr, gr);
+            sum += b.solid[x] * gr;
+        }
+        for (int x = b.offsets[k]; x < b.offsets[k + 1]; x++) {
+            glm::dvec2 r = glm::dvec2(b.rx[x], b.ry[x]);
+            double rlen = glm::length(r);
+            double lambdaCorr = -K_P * pow((poly6(rlen * rlen) / poly6(DQ_P * DQ_P * H * H)), E_P);
+            delta += (b.lambda[x] + lambdaCorr) * spikyGrad(r, rlen);
+        }
+        check += pi + denom + glm::dot(sum, sum) + delta.x + delta.y;
+    }
+    return check;
+}
+
+static double runPacked(const Block &b) {
+    double check = 0.;
+    for (int k = 0; k < NUM_PARTICLES; k++) {
+        int start = b.offsets[k], n = b.offsets[k + 1] - start;
+        SPHDensity dens = sphDensity(&b.rx[start], &b.ry[start], &b.mass[start], &b.solid[start], n);
+        glm::dvec2 delta = sphDelta(&b.rx[start], &b.ry[start], &b.lambda[start], n, K_P, E_P, DQ_P * H);
+        check += dens.pi + dens.gradSq + glm::dot(dens.gradSum, dens.gradSum) + delta.x + delta.y;
+    }
+    return check;
+}
+
+// Best particles per second over NUM_ROUNDS runs
+static double time(double (*run)(const Block &), const Block &b, double *check) {
+    double best = 0.;
+    for (int i = 0; i < NUM_ROUNDS; i++) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        *check = run(b);
+        double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (NUM_PARTICLES / secs > best) {
+            best = NUM_PARTICLES / secs;
+        }
+    }
+    return best;
+}
+
+int main() {
+#if defined(SPH_AVX2)
+    const char *isa = "AVX2";
+#elif defined(SPH_SSE2)
+    const char *isa = "SSE2";
+#else
+    const char *isa = "scalar";
+#endif
+
+    Block b;
+    makeBlock(&b);
+    printf("%d particles, %.1f neighbors each, kernels built for %s\n",
+           NUM_PARTICLES, b.rx.size() / (double)NUM_PARTICLES, isa);
+
+    double before, after;
+    double scalar = time(runScalar, b, &before), packed = time(runPacked, b, &after);
+    printf("per-neighbor scalar: %12.0f particles/s  (check %.6f)\n", scalar, before);
+    printf("packed kernels:      %12.0f particles/s  (check %.6f)\n", packed, after);
+    printf("speedup: %.2fx\n", packed / scalar);
+    return 0;
+}
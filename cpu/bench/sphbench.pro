@@ -0,0 +1,23 @@
+# Microbenchmark for the packed SPH kernels used by the fluid and gas constraints.
+# Add DEFINES += SPH_SCALAR to time the scalar fallback, or -mavx2 for the AVX2 versions.
+QT += core gui opengl
+
+TARGET = sphbench
+TEMPLATE = app
+CONFIG += console c++0x
+CONFIG -= app_bundle
+
+QMAKE_CXXFLAGS += -std=c++0x
+# QMAKE_CXXFLAGS += -mavx2
+
+INCLUDEPATH += .. ../src ../src/constraint ../glm
+DEPENDPATH += ../src ../src/constraint ../glm
+
+SOURCES += sphbench.cpp \
+    ../src/particle.cpp \
+    ../src/particlestore.cpp \
+    ../src/spatialgrid.cpp \
+    ../src/neighborlist.cpp \
+    ../src/constraint/sphkernels.cpp
+
+HEADERS += ../src/constraint/sphkernels.h
@@ -4,7 +4,11 @@ TARGET = particles
 TEMPLATE = app
 
 CONFIG += c++0x
-QMAKE_CXXFLAGS += -std=c++0x
+QMAKE_CXXFLAGS += -std=c++0x -pthread
+LIBS += -pthread
+
+# The SPH kernels use SSE2 by default, uncomment for the AVX2 versions
+# QMAKE_CXXFLAGS += -mavx2
 
 # If you add your own folders, add them to INCLUDEPATH and DEPENDPATH, e.g.
 # INCLUDEPATH += folder1 folder2
@@ -18,8 +22,21 @@ SOURCES += src/main.cpp \
     src/view.cpp \
     src/simulation.cpp \
     src/particle.cpp \
+    src/particlestore.cpp \
+    src/framearena.cpp \
+    src/threadpool.cpp \
+    src/tickprofiler.cpp \
+    src/simulationthread.cpp \
+    src/timestepper.cpp \
+    src/tracewriter.cpp \
+    src/spatialgrid.cpp \
+    src/neighborlist.cpp \
+    src/islands.cpp \
     src/constraint/distanceconstraint.cpp \
     src/solver/lineareq.cpp \
+    src/solver/compressedmatrix.cpp \
+    src/solver/pcgequation.cpp \
+    src/solver/choleskyequation.cpp \
     src/solver/matrix.cpp \
     src/solver/matrix.inl \
     src/solver/solver.cpp \
@@ -29,16 +46,35 @@ SOURCES += src/main.cpp \
     src/constraint/totalfluidconstraint.cpp \
     src/constraint/rigidcontactconstraint.cpp \
     src/constraint/gasconstraint.cpp \
+    src/constraint/constraintbatches.cpp \
+    src/constraint/sphkernels.cpp \
     src/opensmokeemitter.cpp \
-    src/fluidemitter.cpp
+    src/fluidemitter.cpp \
+    src/scenefile.cpp \
+    src/snapshot.cpp \
+    src/trajectory.cpp
 
 HEADERS += src/mainwindow.h \
     src/view.h \
     src/simulation.h \
     src/particle.h \
+    src/particlestore.h \
+    src/framearena.h \
+    src/threadpool.h \
+    src/tickprofiler.h \
+    src/simulationthread.h \
+    src/triplebuffer.h \
+    src/timestepper.h \
+    src/tracewriter.h \
+    src/spatialgrid.h \
+    src/neighborlist.h \
+    src/islands.h \
     src/includes.h \
     src/constraint/distanceconstraint.h \
     src/solver/lineareq.h \
+    src/solver/compressedmatrix.h \
+    src/solver/pcgequation.h \
+    src/solver/choleskyequation.h \
     src/solver/matrix.h \
     src/solver/solver.h \
     src/constraint/totalshapeconstraint.h \
@@ -47,8 +83,13 @@ HEADERS += src/mainwindow.h \
     src/constraint/totalfluidconstraint.h \
     src/constraint/rigidcontactconstraint.h \
     src/constraint/gasconstraint.h \
+    src/constraint/constraintbatches.h \
+    src/constraint/sphkernels.h \
     src/opensmokeemitter.h \
-    src/fluidemitter.h
+    src/fluidemitter.h \
+    src/scenefile.h \
+    src/snapshot.h \
+    src/trajectory.h
 
 # UMFPACK
 # INCLUDEPATH += $$PWD/lib/umfpack/include
@@ -7,11 +7,12 @@ BoundaryConstraint::BoundaryConstraint(int index, double val, bool xBoundary, bo
 BoundaryConstraint::~BoundaryConstraint() {
 }
 
-void BoundaryConstraint::project(QList<Particle *> *estimates, int *counts) {
-    Particle *p = estimates->at(idx);
+void BoundaryConstraint::project(ParticleStore *estimates, int *counts) {
+    glm::dvec2 &p = estimates->p[idx], &ep = estimates->ep[idx];
+    Phase ph = estimates->ph[idx];
 
     // Add a little random jitter for fluids and gases so particles do not become trapped on boundaries
-    double extra = p->ph == FLUID || p->ph == GAS ? frand() * .003 : 0;
+    double extra = ph == FLUID || ph == GAS ? frand() * .003 : 0;
     double d = (PARTICLE_RAD + extra);
     glm::dvec2 n = glm::dvec2();
 
@@ -20,23 +21,23 @@ void BoundaryConstraint::project(QList<Particle *> *estimates, int *counts) {
         if (isX) {
 
             // Quit if no longer valid
-            if (p->ep.x >= value + PARTICLE_RAD) {
+            if (ep.x >= value + PARTICLE_RAD) {
                 return;
             }
-            p->ep.x = value + d;
+            ep.x = value + d;
             if (stable) {
-                p->p.x = value + d;
+                p.x = value + d;
             }
             n = glm::dvec2(1, 0);
         } else {
 
             // Quit if no longer valid
-            if (p->ep.y >= value + PARTICLE_RAD) {
+            if (ep.y >= value + PARTICLE_RAD) {
                 return;
             }
-            p->ep.y = value + d;
+            ep.y = value + d;
             if (stable) {
-                p->p.y = value + d;
+                p.y = value + d;
             }
             n = glm::dvec2(0, 1);
         }
@@ -44,23 +45,23 @@ void BoundaryConstraint::project(QList<Particle *> *estimates, int *counts) {
         if (isX) {
 
             // Quit if no longer valid
-            if (p->ep.x <= value - PARTICLE_RAD) {
+            if (ep.x <= value - PARTICLE_RAD) {
                 return;
             }
-            p->ep.x = value - d;
+            ep.x = value - d;
             if (stable) {
-                p->p.x = value - d;
+                p.x = value - d;
             }
             n = glm::dvec2(-1, 0);
         } else {
 
             // Quit if no longer valid
-            if (p->ep.y <= value - PARTICLE_RAD) {
+            if (ep.y <= value - PARTICLE_RAD) {
                 return;
             }
-            p->ep.y = value - d;
+            ep.y = value - d;
             if (stable) {
-                p->p.y = value - d;
+                p.y = value - d;
             }
             n = glm::dvec2(0, -1);
         }
@@ -71,7 +72,7 @@ void BoundaryConstraint::project(QList<Particle *> *estimates, int *counts) {
     }
 
     // Apply friction - boundaries have a coefficient of friction of 1
-    glm::dvec2 dp = (p->ep - p->p) / (double)counts[idx],
+    glm::dvec2 dp = (ep - p) / (double)counts[idx],
                dpt = dp - glm::dot(dp, n) * n;
     double ldpt = glm::length(dpt);
 
@@ -80,34 +81,34 @@ void BoundaryConstraint::project(QList<Particle *> *estimates, int *counts) {
     }
 
     // Choose between static and kinetic friction
-    if (ldpt < sqrt(p->sFriction) * d) {
-        p->ep -= dpt;
+    if (ldpt < sqrt(estimates->sFriction[idx]) * d) {
+        ep -= dpt;
     } else {
-        p->ep -= dpt * min(sqrt(p->kFriction) * d / ldpt, 1.);
+        ep -= dpt * min(sqrt(estimates->kFriction[idx]) * d / ldpt, 1.);
     }
 }
 
-void BoundaryConstraint::draw(QList<Particle *> *particles) {
+void BoundaryConstraint::draw(ParticleStore *particles) {
 }
 
-double BoundaryConstraint::evaluate(QList<Particle *> *estimates) {
-    Particle *p = estimates->at(idx);
+double BoundaryConstraint::evaluate(ParticleStore *estimates) {
+    glm::dvec2 p = estimates->getP(idx, stable);
     if (isGreaterThan) {
         if (isX) {
-            return (value + PARTICLE_RAD) - p->getP(stable).x;
+            return (value + PARTICLE_RAD) - p.x;
         } else {
-            return (value + PARTICLE_RAD) - p->getP(stable).y;
+            return (value + PARTICLE_RAD) - p.y;
         }
     } else {
         if (isX) {
-            return p->getP(stable).x - (value - PARTICLE_RAD);
+            return p.x - (value - PARTICLE_RAD);
         } else {
-            return p->getP(stable).y - (value - PARTICLE_RAD);
+            return p.y - (value - PARTICLE_RAD);
         }
     }
 }
 
-glm::dvec2 BoundaryConstraint::gradient(QList<Particle *> *estimates, int respect) {
+glm::dvec2 BoundaryConstraint::gradient(ParticleStore *estimates, int respect) {
     if (respect != idx) {
         return glm::dvec2();
     }
@@ -130,3 +131,7 @@ glm::dvec2 BoundaryConstraint::gradient(QList<Particle *> *estimates, int respec
 void BoundaryConstraint::updateCounts(int *counts) {
     counts[idx]++;
 }
+
+void BoundaryConstraint::getStencil(std::vector<int> *out) {
+    out->push_back(idx);
+}
@@ -1,7 +1,7 @@
 #ifndef BOUNDARYCONSTRAINT_H
 #define BOUNDARYCONSTRAINT_H
 
-#include "particle.h"
+#include "particlestore.h"
 
 // Collision with the boundaries of the world
 class BoundaryConstraint : public Constraint {
@@ -9,12 +9,13 @@ public:
     BoundaryConstraint(int index, double val, bool xBoundary, bool greater, bool st = false);
     virtual ~BoundaryConstraint();
 
-    void project(QList<Particle *> *estimates, int *counts);
-    void draw(QList<Particle *> *particles);
+    void project(ParticleStore *estimates, int *counts);
+    void draw(ParticleStore *particles);
 
-    double evaluate(QList<Particle *> *estimates);
-    glm::dvec2 gradient(QList<Particle *> *estimates, int respect);
+    double evaluate(ParticleStore *estimates);
+    glm::dvec2 gradient(ParticleStore *estimates, int respect);
     void updateCounts(int *counts);
+    void getStencil(std::vector<int> *out);
 
 private:
     int idx;
@@ -0,0 +1,143 @@
+#include "constraintbatches.h"
+
+DeltaBuffers::DeltaBuffers() : m_numParticles(0) {
+}
+
+DeltaBuffers::~DeltaBuffers() {
+}
+
+void DeltaBuffers::reset(int numParticles) {
+    m_numParticles = numParticles;
+    m_deltas.assign(JACOBI_SLICES * numParticles, glm::dvec2());
+}
+
+void DeltaBuffers::apply(ParticleStore *estimates, ThreadPool *pool) {
+    auto applyRange = [this, estimates](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            glm::dvec2 total;
+            for (int s = 0; s < JACOBI_SLICES; s++) {
+                total += m_deltas[s * m_numParticles + i];
+            }
+            estimates->ep[i] += total;
+        }
+    };
+
+    if (pool == NULL) {
+        applyRange(0, m_numParticles);
+    } else {
+        pool->parallelFor(m_numParticles, applyRange);
+    }
+}
+
+ConstraintBatches::ConstraintBatches() {
+}
+
+ConstraintBatches::~ConstraintBatches() {
+}
+
+void ConstraintBatches::add(Constraint *c) {
+    if (RigidContactConstraint *rc = dynamic_cast<RigidContactConstraint *>(c)) {
+        add(rc);
+    } else if (ContactConstraint *cc = dynamic_cast<ContactConstraint *>(c)) {
+        add(cc);
+    } else if (BoundaryConstraint *bc = dynamic_cast<BoundaryConstraint *>(c)) {
+        add(bc);
+    } else if (DistanceConstraint *dc = dynamic_cast<DistanceConstraint *>(c)) {
+        add(dc);
+    } else if (TotalFluidConstraint *fc = dynamic_cast<TotalFluidConstraint *>(c)) {
+        add(fc);
+    } else if (GasConstraint *gc = dynamic_cast<GasConstraint *>(c)) {
+        add(gc);
+    } else if (TotalShapeConstraint *sc = dynamic_cast<TotalShapeConstraint *>(c)) {
+        add(sc);
+    } else {
+        cout << "Constraint of unknown type cannot be batched." << endl;
+        exit(1);
+    }
+}
+
+void ConstraintBatches::clear() {
+    rigidContacts.clear();
+    contacts.clear();
+    boundaries.clear();
+    distances.clear();
+    gases.clear();
+    fluids.clear();
+    shapes.clear();
+}
+
+int ConstraintBatches::size() const {
+    return rigidContacts.size() + contacts.size() + boundaries.size() + distances.size() +
+           gases.size() + fluids.size() + shapes.size();
+}
+
+void ConstraintBatches::color(int numParticles) {
+    rigidContacts.color(numParticles);
+    contacts.color(numParticles);
+    distances.color(numParticles);
+}
+
+void ConstraintBatches::project(ParticleStore *estimates, int *counts, ThreadPool *pool) {
+    rigidContacts.project(estimates, counts, pool);
+    contacts.project(estimates, counts, pool);
+    boundaries.project(estimates, counts);
+    distances.project(estimates, counts, pool);
+    gases.project(estimates, counts);
+    fluids.project(estimates, counts);
+    shapes.project(estimates, counts);
+}
+
+void ConstraintBatches::projectJacobi(ParticleStore *estimates, int *counts, DeltaBuffers *buffers, ThreadPool *pool) {
+    if (rigidContacts.size() + contacts.size() + distances.size() + shapes.size() > 0) {
+        buffers->reset(estimates->size());
+
+        // Shapes write their body's fit, which rigid contacts read, so fit every body up front
+        // and leave the slices nothing but reads of shared state
+        for (int i = 0; i < shapes.size(); i++) {
+            shapes.at(i)->match(estimates);
+        }
+
+        auto projectSlices = [this, estimates, counts, buffers](int begin, int end) {
+            for (int s = begin; s < end; s++) {
+                glm::dvec2 *deltas = buffers->getSlice(s);
+                rigidContacts.projectSlice(estimates, counts, deltas, s, JACOBI_SLICES);
+                contacts.projectSlice(estimates, counts, deltas, s, JACOBI_SLICES);
+                distances.projectSlice(estimates, counts, deltas, s, JACOBI_SLICES);
+                shapes.projectSlice(estimates, counts, deltas, s, JACOBI_SLICES);
+            }
+        };
+
+        if (pool == NULL) {
+            projectSlices(0, JACOBI_SLICES);
+        } else {
+            pool->parallelFor(JACOBI_SLICES, projectSlices);
+        }
+        buffers->apply(estimates, pool);
+    }
+
+    boundaries.project(estimates, counts);
+    gases.project(estimates, counts);
+    fluids.project(estimates, counts);
+}
+
+void ConstraintBatches::updateCounts(int *counts) {
+    rigidContacts.updateCounts(counts);
+    contacts.updateCounts(counts);
+    boundaries.updateCounts(counts);
+    distances.updateCounts(counts);
+    gases.updateCounts(counts);
+    fluids.updateCounts(counts);
+    shapes.updateCounts(counts);
+}
+
+void ConstraintBatches::gather(QList<Constraint *> *out, bool linearOnly) const {
+    gatherBatch(rigidContacts, out);
+    gatherBatch(contacts, out);
+    gatherBatch(boundaries, out);
+    gatherBatch(distances, out);
+    if (!linearOnly) {
+        gatherBatch(gases, out);
+        gatherBatch(fluids, out);
+    }
+    gatherBatch(shapes, out);
+}
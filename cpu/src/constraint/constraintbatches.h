@@ -0,0 +1,211 @@
+#ifndef CONSTRAINTBATCHES_H
+#define CONSTRAINTBATCHES_H
+
+#include "boundaryconstraint.h"
+#include "contactconstraint.h"
+#include "distanceconstraint.h"
+#include "gasconstraint.h"
+#include "rigidcontactconstraint.h"
+#include "totalfluidconstraint.h"
+#include "totalshapeconstraint.h"
+#include "threadpool.h"
+
+#include <vector>
+
+// Most colors handed out when coloring a batch, anything left over is solved serially
+#define MAX_COLORS 64
+
+// Colors with fewer constraints than this are solved serially, as threading costs more than it saves
+#define MIN_PARALLEL_COLOR 128
+
+// Number of delta buffers a Jacobi pass is split across. This is fixed rather than one per thread
+// so the corrections are always summed in the same order, whatever the number of threads.
+#define JACOBI_SLICES 16
+
+// Corrections gathered during a Jacobi pass, one buffer per slice of the constraints
+class DeltaBuffers {
+public:
+    DeltaBuffers();
+    virtual ~DeltaBuffers();
+
+    // Zero every buffer, sized for numParticles
+    void reset(int numParticles);
+    inline glm::dvec2 *getSlice(int s) { return m_deltas.data() + s * m_numParticles; }
+
+    // Sum the buffers in slice order and add the totals to ep
+    void apply(ParticleStore *estimates, ThreadPool *pool);
+
+private:
+    int m_numParticles;
+    std::vector<glm::dvec2> m_deltas;
+};
+
+// A contiguous run of constraints that all share one concrete type
+template <typename T>
+class ConstraintBatch {
+public:
+    ConstraintBatch() : m_colored(false) {}
+
+    inline void append(T *c) {
+        m_constraints.push_back(c);
+        m_colored = false;
+    }
+    inline void clear() {
+        m_constraints.clear();
+        m_colored = false;
+    }
+    inline int size() const { return m_constraints.size(); }
+    inline T *at(int i) const { return m_constraints[i]; }
+    inline int getNumColors() const { return m_colored ? m_colorStarts.size() - 1 : 0; }
+
+    // Qualified calls skip the vtable, so each batch runs one known kernel back to back.
+    // Colored batches given a pool solve each color across all of its threads.
+    void project(ParticleStore *estimates, int *counts, ThreadPool *pool = NULL) {
+        if (!m_colored || pool == NULL) {
+            projectRange(estimates, counts, 0, m_constraints.size());
+            return;
+        }
+
+        for (unsigned int c = 0; c + 1 < m_colorStarts.size(); c++) {
+            int start = m_colorStarts[c], end = m_colorStarts[c + 1];
+            if (end - start < MIN_PARALLEL_COLOR || c == MAX_COLORS) {
+                projectRange(estimates, counts, start, end);
+            } else {
+                pool->parallelFor(end - start, [this, estimates, counts, start](int begin, int end) {
+                    projectRange(estimates, counts, start + begin, start + end);
+                });
+            }
+        }
+    }
+
+    // Project slice s of numSlices equal parts of the batch, adding corrections to deltas
+    void projectSlice(ParticleStore *estimates, int *counts, glm::dvec2 *deltas, int s, int numSlices) {
+        int n = m_constraints.size(), start = (long long)n * s / numSlices, end = (long long)n * (s + 1) / numSlices;
+        for (int i = start; i < end; i++) {
+            m_constraints[i]->T::project(estimates, counts, deltas);
+        }
+    }
+
+    // Greedily color the constraint graph so no two constraints of one color share a particle,
+    // then reorder the batch color by color. Only for two-particle constraint types.
+    void color(int numParticles) {
+        m_used.assign(numParticles, 0);
+        m_colors.resize(m_constraints.size());
+        m_colorStarts.assign(MAX_COLORS + 2, 0);
+
+        for (unsigned int i = 0; i < m_constraints.size(); i++) {
+            int a = m_constraints[i]->getFirst(), b = m_constraints[i]->getSecond();
+            unsigned long long taken = m_used[a] | m_used[b];
+
+            int c = 0;
+            while (c < MAX_COLORS && ((taken >> c) & 1)) {
+                c++;
+            }
+            if (c < MAX_COLORS) {
+                m_used[a] |= 1ull << c;
+                m_used[b] |= 1ull << c;
+            }
+            m_colors[i] = c;
+            m_colorStarts[c + 1]++;
+        }
+
+        // Stable counting sort by color, dropping empty colors off the end
+        int last = 0;
+        for (int c = 0; c <= MAX_COLORS; c++) {
+            if (m_colorStarts[c + 1] > 0) {
+                last = c;
+            }
+            m_colorStarts[c + 1] += m_colorStarts[c];
+        }
+        m_colorStarts.resize(last + 2);
+
+        m_sorted.resize(m_constraints.size());
+        std::vector<int> next(m_colorStarts.begin(), m_colorStarts.end() - 1);
+        for (unsigned int i = 0; i < m_constraints.size(); i++) {
+            m_sorted[next[m_colors[i]]++] = m_constraints[i];
+        }
+        m_constraints.swap(m_sorted);
+        m_colored = true;
+    }
+
+    void updateCounts(int *counts) {
+        for (unsigned int i = 0; i < m_constraints.size(); i++) {
+            m_constraints[i]->T::updateCounts(counts);
+        }
+    }
+
+private:
+    inline void projectRange(ParticleStore *estimates, int *counts, int start, int end) {
+        for (int i = start; i < end; i++) {
+            m_constraints[i]->T::project(estimates, counts);
+        }
+    }
+
+    std::vector<T *> m_constraints;
+
+    // Coloring results, where color c is m_constraints[m_colorStarts[c]] to m_constraints[m_colorStarts[c + 1]]
+    bool m_colored;
+    std::vector<int> m_colorStarts;
+    std::vector<int> m_colors;
+    std::vector<unsigned long long> m_used;
+    std::vector<T *> m_sorted;
+};
+
+// All the constraints of one constraint group, sorted into a batch per type. Batches are
+// always solved in the same fixed type order, and constraints keep the order they were
+// added in within their batch. Contact detection adds a particle's rigid contacts, contacts
+// and boundaries one after another, so the CONTACT group no longer runs in that interleaved
+// order and Gauss-Seidel results differ slightly from solving the constraints as they were
+// added. Each constraint is still projected exactly once per iteration with the same counts.
+class ConstraintBatches {
+public:
+    ConstraintBatches();
+    virtual ~ConstraintBatches();
+
+    // Typed adds go straight to their batch, anything else is sorted by its dynamic type
+    void add(Constraint *c);
+    inline void add(RigidContactConstraint *c) { rigidContacts.append(c); }
+    inline void add(ContactConstraint *c) { contacts.append(c); }
+    inline void add(BoundaryConstraint *c) { boundaries.append(c); }
+    inline void add(DistanceConstraint *c) { distances.append(c); }
+    inline void add(GasConstraint *c) { gases.append(c); }
+    inline void add(TotalFluidConstraint *c) { fluids.append(c); }
+    inline void add(TotalShapeConstraint *c) { shapes.append(c); }
+
+    void clear();
+    int size() const;
+
+    // Color the batches that can be solved in parallel
+    void color(int numParticles);
+
+    // Solve or count every batch in order, colored batches in parallel if given a pool
+    void project(ParticleStore *estimates, int *counts, ThreadPool *pool = NULL);
+
+    // Solve the rigid contact, contact, distance and shape batches as one Jacobi step, all working
+    // from the same ep and applying their summed corrections at the end. The remaining batches
+    // follow one after another as usual.
+    void projectJacobi(ParticleStore *estimates, int *counts, DeltaBuffers *buffers, ThreadPool *pool = NULL);
+    void updateCounts(int *counts);
+
+    // Flatten back into a single list in solve order, for the matrix solver. linearOnly leaves
+    // out the gases and fluids, which have no gradient and are always projected directly.
+    void gather(QList<Constraint *> *out, bool linearOnly = false) const;
+
+    ConstraintBatch<RigidContactConstraint> rigidContacts;
+    ConstraintBatch<ContactConstraint> contacts;
+    ConstraintBatch<BoundaryConstraint> boundaries;
+    ConstraintBatch<DistanceConstraint> distances;
+    ConstraintBatch<GasConstraint> gases;
+    ConstraintBatch<TotalFluidConstraint> fluids;
+    ConstraintBatch<TotalShapeConstraint> shapes;
+
+private:
+    template <typename T>
+    static void gatherBatch(const ConstraintBatch<T> &batch, QList<Constraint *> *out) {
+        for (int i = 0; i < batch.size(); i++) {
+            out->append(batch.at(i));
+        }
+    }
+};
+
+#endif // CONSTRAINTBATCHES_H
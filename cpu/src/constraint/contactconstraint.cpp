@@ -7,14 +7,18 @@ ContactConstraint::ContactConstraint(int first, int second, bool st)
 ContactConstraint::~ContactConstraint() {
 }
 
-void ContactConstraint::project(QList<Particle *> *estimates, int *counts) {
-    Particle *p1 = estimates->at(i1), *p2 = estimates->at(i2);
-    if (p1->tmass == 0.f && p2->tmass == 0.f) {
+void ContactConstraint::project(ParticleStore *estimates, int *counts) {
+    project(estimates, counts, estimates->ep.data());
+}
+
+void ContactConstraint::project(ParticleStore *estimates, int *counts, glm::dvec2 *deltas) {
+    double w1 = estimates->tmass[i1], w2 = estimates->tmass[i2];
+    if (w1 == 0.f && w2 == 0.f) {
         return;
     }
 
-    glm::dvec2 diff = p1->getP(stable) - p2->getP(stable);
-    double wSum = p1->tmass + p2->tmass,
+    glm::dvec2 diff = estimates->getP(i1, stable) - estimates->getP(i2, stable);
+    double wSum = w1 + w2,
            dist = glm::length(diff),
            mag = dist - PARTICLE_DIAM;
 
@@ -25,51 +29,51 @@ void ContactConstraint::project(QList<Particle *> *estimates, int *counts) {
 
     double scale = mag / wSum;
     glm::dvec2 dp = (scale / dist) * diff,
-               dp1 = -p1->tmass * dp / (double)counts[i1],
-               dp2 = p2->tmass * dp / (double)counts[i2];
+               dp1 = -w1 * dp / (double)counts[i1],
+               dp2 = w2 * dp / (double)counts[i2];
 
-    p1->ep += dp1;
-    p2->ep += dp2;
+    deltas[i1] += dp1;
+    deltas[i2] += dp2;
 
     if (stable) {
-        p1->p += dp1;
-        p2->p += dp2;
+        estimates->p[i1] += dp1;
+        estimates->p[i2] += dp2;
     }
 }
 
-void ContactConstraint::draw(QList<Particle *> *particles) {
-    Particle *p1 = particles->at(i1), *p2 = particles->at(i2);
+void ContactConstraint::draw(ParticleStore *particles) {
+#ifndef HEADLESS
+    const glm::dvec2 &p1 = particles->p[i1], &p2 = particles->p[i2];
 
     glColor3f(1, 1, 0);
     glBegin(GL_LINES);
 
-    glVertex2f(p1->p.x, p1->p.y);
-    glVertex2f(p2->p.x, p2->p.y);
+    glVertex2f(p1.x, p1.y);
+    glVertex2f(p2.x, p2.y);
 
     glEnd();
 
     glPointSize(3);
     glBegin(GL_POINTS);
 
-    glVertex2f(p1->p.x, p1->p.y);
-    glVertex2f(p2->p.x, p2->p.y);
+    glVertex2f(p1.x, p1.y);
+    glVertex2f(p2.x, p2.y);
 
     glEnd();
+#endif
 }
 
-double ContactConstraint::evaluate(QList<Particle *> *estimates) {
-    Particle *p1 = estimates->at(i1), *p2 = estimates->at(i2);
-    double dist = glm::length(p1->getP(stable) - p2->getP(stable));
+double ContactConstraint::evaluate(ParticleStore *estimates) {
+    double dist = glm::length(estimates->getP(i1, stable) - estimates->getP(i2, stable));
     return dist > PARTICLE_DIAM ? 0 : dist - PARTICLE_DIAM;
 }
 
-glm::dvec2 ContactConstraint::gradient(QList<Particle *> *estimates, int respect) {
+glm::dvec2 ContactConstraint::gradient(ParticleStore *estimates, int respect) {
     if (!(respect == i1 || respect == i2)) {
         return glm::dvec2();
     }
 
-    Particle *p1 = estimates->at(i1), *p2 = estimates->at(i2);
-    glm::dvec2 diff = p1->getP(stable) - p2->getP(stable);
+    glm::dvec2 diff = estimates->getP(i1, stable) - estimates->getP(i2, stable);
     double dist = glm::length(diff);
 
     if (dist > PARTICLE_DIAM) {
@@ -88,3 +92,8 @@ void ContactConstraint::updateCounts(int *counts) {
     counts[i1]++;
     counts[i2]++;
 }
+
+void ContactConstraint::getStencil(std::vector<int> *out) {
+    out->push_back(i1);
+    out->push_back(i2);
+}
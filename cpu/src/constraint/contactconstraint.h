@@ -1,7 +1,7 @@
 #ifndef CONTACTCONSTRAINT_H
 #define CONTACTCONSTRAINT_H
 
-#include "particle.h"
+#include "particlestore.h"
 
 // Contact between two particles where AT LEAST ONE is not a solid
 class ContactConstraint : public Constraint {
@@ -9,12 +9,20 @@ public:
     ContactConstraint(int first, int second, bool st = false);
     virtual ~ContactConstraint();
 
-    void project(QList<Particle *> *estimates, int *counts);
-    void draw(QList<Particle *> *particles);
+    void project(ParticleStore *estimates, int *counts);
 
-    double evaluate(QList<Particle *> *estimates);
-    glm::dvec2 gradient(QList<Particle *> *estimates, int respect);
+    // Project, adding the corrections to ep into deltas instead of estimates->ep
+    void project(ParticleStore *estimates, int *counts, glm::dvec2 *deltas);
+    void draw(ParticleStore *particles);
+
+    double evaluate(ParticleStore *estimates);
+    glm::dvec2 gradient(ParticleStore *estimates, int respect);
     void updateCounts(int *counts);
+    void getStencil(std::vector<int> *out);
+
+    // The two particles this constraint moves
+    inline int getFirst() const { return i1; }
+    inline int getSecond() const { return i2; }
 
 private:
     int i1, i2;
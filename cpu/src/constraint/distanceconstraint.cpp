@@ -4,67 +4,71 @@ DistanceConstraint::DistanceConstraint(double distance, int first, int second, b
     : Constraint(), d(distance), i1(first), i2(second), stable(st) {
 }
 
-DistanceConstraint::DistanceConstraint(int first, int second, QList<Particle *> *particles)
-    : Constraint(), d(0.0), i1(first), i2(second) {
-    d = glm::length(particles->at(i1)->p - particles->at(i2)->p);
+DistanceConstraint::DistanceConstraint(int first, int second, ParticleStore *particles)
+    : Constraint(), d(0.0), i1(first), i2(second), stable(false) {
+    d = glm::length(particles->p[i1] - particles->p[i2]);
 }
 
 DistanceConstraint::~DistanceConstraint() {
 }
 
-void DistanceConstraint::project(QList<Particle *> *estimates, int *counts) {
-    Particle *p1 = estimates->at(i1), *p2 = estimates->at(i2);
+void DistanceConstraint::project(ParticleStore *estimates, int *counts) {
+    project(estimates, counts, estimates->ep.data());
+}
+
+void DistanceConstraint::project(ParticleStore *estimates, int *counts, glm::dvec2 *deltas) {
+    double w1 = estimates->imass[i1], w2 = estimates->imass[i2];
 
-    if (p1->imass == 0.f && p2->imass == 0.f) {
+    if (w1 == 0.f && w2 == 0.f) {
         return;
     }
 
-    glm::dvec2 diff = p1->ep - p2->ep;
-    double wSum = p1->imass + p2->imass,
+    glm::dvec2 diff = estimates->ep[i1] - estimates->ep[i2];
+    double wSum = w1 + w2,
            dist = glm::length(diff),
            mag = dist - d,
            scale = mag / wSum;
 
     glm::dvec2 dp = (scale / dist) * diff,
-               dp1 = -p1->imass * dp / (double)counts[i1],
-               dp2 = p2->imass * dp / (double)counts[i2];
+               dp1 = -w1 * dp / (double)counts[i1],
+               dp2 = w2 * dp / (double)counts[i2];
 
-    p1->ep += dp1;
-    p2->ep += dp2;
+    deltas[i1] += dp1;
+    deltas[i2] += dp2;
 }
 
-void DistanceConstraint::draw(QList<Particle *> *particles) {
-    Particle *p1 = particles->at(i1), *p2 = particles->at(i2);
+void DistanceConstraint::draw(ParticleStore *particles) {
+#ifndef HEADLESS
+    const glm::dvec2 &p1 = particles->p[i1], &p2 = particles->p[i2];
 
     glColor3f(1, 1, 0);
     glBegin(GL_LINES);
 
-    glVertex2f(p1->p.x, p1->p.y);
-    glVertex2f(p2->p.x, p2->p.y);
+    glVertex2f(p1.x, p1.y);
+    glVertex2f(p2.x, p2.y);
 
     glEnd();
 
     glPointSize(3);
     glBegin(GL_POINTS);
 
-    glVertex2f(p1->p.x, p1->p.y);
-    glVertex2f(p2->p.x, p2->p.y);
+    glVertex2f(p1.x, p1.y);
+    glVertex2f(p2.x, p2.y);
 
     glEnd();
+#endif
 }
 
-double DistanceConstraint::evaluate(QList<Particle *> *estimates) {
-    Particle *p1 = estimates->at(i1), *p2 = estimates->at(i2);
-    return glm::length(p1->getP(stable) - p2->getP(stable)) - d;
+double DistanceConstraint::evaluate(ParticleStore *estimates) {
+    return glm::length(estimates->getP(i1, stable) - estimates->getP(i2, stable)) - d;
 }
 
-glm::dvec2 DistanceConstraint::gradient(QList<Particle *> *estimates, int respect) {
+glm::dvec2 DistanceConstraint::gradient(ParticleStore *estimates, int respect) {
     if (!(respect == i1 || respect == i2)) {
         return glm::dvec2();
     }
 
-    Particle *p1 = estimates->at(i1), *p2 = estimates->at(i2);
-    glm::dvec2 n = glm::normalize(p1->getP(stable) - p2->getP(stable));
+    glm::dvec2 n = glm::normalize(estimates->getP(i1, stable) - estimates->getP(i2, stable));
     if (respect == i1) {
         return n;
     } else {
@@ -76,3 +80,8 @@ void DistanceConstraint::updateCounts(int *counts) {
     counts[i1]++;
     counts[i2]++;
 }
+
+void DistanceConstraint::getStencil(std::vector<int> *out) {
+    out->push_back(i1);
+    out->push_back(i2);
+}
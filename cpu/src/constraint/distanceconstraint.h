@@ -1,21 +1,31 @@
 #ifndef DISTANCECONSTRAINT_H
 #define DISTANCECONSTRAINT_H
 
-#include "particle.h"
+#include "particlestore.h"
 
 // Two particles must be exactly a certain distance away
 class DistanceConstraint : public Constraint {
 public:
     DistanceConstraint(double distance, int first, int second, bool st = false);
-    DistanceConstraint(int first, int second, QList<Particle *> *particles);
+    DistanceConstraint(int first, int second, ParticleStore *particles);
     virtual ~DistanceConstraint();
 
-    void project(QList<Particle *> *estimates, int *counts);
-    void draw(QList<Particle *> *particles);
+    void project(ParticleStore *estimates, int *counts);
 
-    double evaluate(QList<Particle *> *estimates);
-    glm::dvec2 gradient(QList<Particle *> *estimates, int respect);
+    // Project, adding the corrections to ep into deltas instead of estimates->ep
+    void project(ParticleStore *estimates, int *counts, glm::dvec2 *deltas);
+    void draw(ParticleStore *particles);
+
+    double evaluate(ParticleStore *estimates);
+    glm::dvec2 gradient(ParticleStore *estimates, int respect);
     void updateCounts(int *counts);
+    void getStencil(std::vector<int> *out);
+
+    // The two particles this constraint moves
+    inline int getFirst() const { return i1; }
+    inline int getSecond() const { return i2; }
+    inline double getDistance() const { return d; }
+    inline bool isStable() const { return stable; }
 
 private:
     double d;
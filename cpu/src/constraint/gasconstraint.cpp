@@ -1,118 +1,87 @@
 #include "gasconstraint.h"
 
-GasConstraint::GasConstraint(double density, QList<int> *particles, bool open)
-    : Constraint(), p0(density), m_open(open) {
-    neighbors = new QList<int>[particles->size()];
-    deltas = new glm::dvec2[particles->size()];
-
-    numParticles = particles->size();
+const double GasConstraint::K_P = .2;
+const double GasConstraint::DQ_P = .25;
+const double GasConstraint::S_SOLID = .5;
 
+GasConstraint::GasConstraint(double density, QList<int> *particles, NeighborList *neighborList, bool open)
+    : Constraint(), p0(density), m_open(open), neighborList(neighborList) {
     for (int i = 0; i < particles->size(); i++) {
         ps.append(particles->at(i));
     }
 }
 
 GasConstraint::~GasConstraint() {
-    delete[] neighbors;
 }
 
-void GasConstraint::addParticle(Particle *p, int index) {
-    delete[] neighbors;
-    delete[] deltas;
-    numParticles++;
-    neighbors = new QList<int>[numParticles];
-    deltas = new glm::dvec2[numParticles];
+// As with fluids, the deltas only grow in project
+void GasConstraint::addParticle(int index) {
     ps.append(index);
 }
 
-void GasConstraint::project(QList<Particle *> *estimates, int *counts) {
+void GasConstraint::addParticles(int first, int count) {
+    ps.reserve(ps.size() + count);
+    for (int i = first; i < first + count; i++) {
+        ps.append(i);
+    }
+}
+
+void GasConstraint::project(ParticleStore *estimates, int *counts) {
+
+    // Make sure the shared neighbor lists still cover every particle within H
+    neighborList->refresh(estimates);
 
-    // Find neighboring particles and estimate pi for each particle
-    lambdas.clear();
+    // Pack up the neighbors of each particle for the SPH kernels
+    packed.gather(estimates, neighborList, ps, S_SOLID, 1.);
+
+    // Estimate pi and lambda for each particle
+    lambdas.assign(estimates->size(), 0.);
     for (int k = 0; k < ps.size(); k++) {
-        neighbors[k].clear();
-        int i = ps[k];
-        Particle *p_i = estimates->at(i);
-        double pi = 0., denom = 0.;
-
-        // Find neighbors
-        for (int j = 0; j < estimates->size(); j++) {
-
-            // Check if the next particle is actually this particle
-            if (j != i) {
-                Particle *p_j = estimates->at(j);
-
-                // Ignore fixed particles
-                if (p_j->imass == 0)
-                    continue;
-                glm::dvec2 r = p_i->ep - p_j->ep;
-                double rlen2 = glm::dot(r, r);
-                if (rlen2 < H2) {
-
-                    // Found a neighbor! Remember it and add to pi and the gamma denominator
-                    neighbors[k].append(j);
-                    double incr = poly6(rlen2) / p_j->imass;
-                    if (p_j->ph == SOLID) {
-                        incr *= S_SOLID;
-                    }
-                    pi += incr;
-
-                    glm::dvec2 gr = grad(estimates, k, j);
-                    denom += glm::dot(gr, gr);
-                }
-
-                // If it is, cut to the chase
-            } else {
-                neighbors[k].append(j);
-                pi += poly6(0) / p_i->imass;
-            }
-        }
+        int i = ps[k], start = packed.getOffset(k), n = packed.getCount(k);
+        SPHDensity dens = sphDensity(packed.rx.data() + start, packed.ry.data() + start,
+                                     packed.mass.data() + start, packed.solid.data() + start, n);
 
-        glm::dvec2 gr = grad(estimates, k, i);
-        denom += glm::dot(gr, gr);
+        // The particle itself adds to its density, but its own gradient terms vanish
+        double pi = dens.pi + poly6(0) / estimates->imass[i],
+               denom = (dens.gradSq + glm::dot(dens.gradSum, dens.gradSum)) / (p0 * p0);
 
         // Compute the gamma value
         //        cout << i << " estimated " << pi << endl;
-
         double p_rat = (pi / p0);
         if (m_open)
-            p_i->f += p_i->v * (1. - p_rat) * -50.;
+            estimates->f[i] += estimates->v[i] * (1. - p_rat) * -50.;
         //        if(p_rat < 1) p_rat = 1;
         double lambda = -(p_rat - 1.) / (denom + RELAXATION);
         lambdas[i] = lambda;
     }
 
     // Compute actual deltas
+    deltas.resize(ps.size());
     for (int k = 0; k < ps.size(); k++) {
-        glm::dvec2 delta = glm::dvec2();
         glm::dvec2 f_vort = glm::dvec2();
-        int i = ps[k];
-        Particle *p_i = estimates->at(i);
-
-        for (int x = 0; x < neighbors[k].size(); x++) {
-            int j = neighbors[k][x];
-            if (i == j)
-                continue;
-            Particle *p_j = estimates->at(j);
-            glm::dvec2 r = p_i->ep - p_j->ep;
-            double rlen = glm::length(r);
-            glm::dvec2 sg = spikyGrad(r, rlen);
-            double lambdaCorr = -K_P * pow((poly6(rlen * rlen) / poly6(DQ_P * DQ_P * H * H)), E_P);
-            delta += (lambdas[i] + lambdas[j] + lambdaCorr) * sg;
+        int i = ps[k], start = packed.getOffset(k), n = packed.getCount(k);
+
+        for (int x = start; x < start + n; x++) {
+            int j = packed.js[x];
+            packed.lambda[x] = lambdas[i] + lambdas[j];
+
             //            vorticity
+            glm::dvec2 r = glm::dvec2(packed.rx[x], packed.ry[x]);
             glm::dvec2 gradient = spikyGrad(r, glm::dot(r, r));
-            glm::dvec2 w = gradient * p_j->v;
+            glm::dvec2 w = gradient * estimates->v[j];
             glm::dvec3 cross = glm::cross(glm::dvec3(0, 0, glm::length(w)), glm::dvec3(r.x, r.y, 0));
             f_vort += glm::dvec2(cross.x, cross.y) * poly6(glm::dot(r, r));
         }
+        glm::dvec2 delta = sphDelta(packed.rx.data() + start, packed.ry.data() + start,
+                                    packed.lambda.data() + start, n, K_P, E_P, DQ_P * H);
         deltas[k] = (delta / p0);
-        p_i->f += f_vort;
+        estimates->f[i] += f_vort;
     }
 
+    // Neighbor counts include the particle itself
     for (int k = 0; k < ps.size(); k++) {
         int i = ps[k];
-        Particle *p_i = estimates->at(i);
-        p_i->ep += deltas[k] / ((double)neighbors[k].size() + counts[i]);
+        estimates->ep[i] += deltas[k] / ((double)packed.getCount(k) + 1 + counts[i]);
     }
 
     //    // Find neighboring particles and estimate pi for each particle
@@ -198,14 +167,11 @@ void GasConstraint::project(QList<Particle *> *estimates, int *counts) {
     //    }
 }
 
-void GasConstraint::draw(QList<Particle *> *particles) {
+void GasConstraint::draw(ParticleStore *particles) {
 }
 
 double GasConstraint::poly6(double r2) {
-    if (r2 >= H2)
-        return 0;
-    double term2 = (H2 - r2);
-    return (315. / (64. * M_PI * H9)) * (term2 * term2 * term2);
+    return sphPoly6(r2);
     // return (H-r) / (H*H);
 }
 
@@ -218,34 +184,20 @@ glm::dvec2 GasConstraint::spikyGrad(const glm::dvec2 &r, double rlen) {
     // return -r / (H*H*rlen);
 }
 
-glm::dvec2 GasConstraint::grad(QList<Particle *> *estimates, int k, int j) {
-    int i = ps[k];
-    Particle *p_i = estimates->at(i), *p_j = estimates->at(j);
-    glm::dvec2 r = p_i->ep - p_j->ep;
-    double rlen = glm::length(r);
-    if (p_i != p_j) {
-        return -spikyGrad(r, rlen) / (p0);
-    }
-
-    glm::dvec2 out = glm::dvec2();
-    for (int x = 0; x < neighbors[k].size(); x++) {
-        r = p_i->ep - estimates->at(neighbors[k][x])->ep;
-        rlen = glm::length(r);
-        out += spikyGrad(r, rlen);
-    }
-
-    return out / (p0);
-}
-
-double GasConstraint::evaluate(QList<Particle *> *estimates) {
+double GasConstraint::evaluate(ParticleStore *estimates) {
     std::cout << "You shouldn't be calling evaluate on fluids" << std::endl;
     exit(1);
 }
 
-glm::dvec2 GasConstraint::gradient(QList<Particle *> *estimates, int respect) {
+glm::dvec2 GasConstraint::gradient(ParticleStore *estimates, int respect) {
     std::cout << "You shouldn't be calling gradient on fluids" << std::endl;
     exit(1);
 }
 
 void GasConstraint::updateCounts(int *counts) {
 }
+
+void GasConstraint::getStencil(std::vector<int> *out) {
+    // Gases are always projected directly, never through the matrix solver
+    (void)out;
+}
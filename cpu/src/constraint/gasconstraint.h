@@ -11,43 +11,51 @@
 // Epsilon in gamma correction denominator
 #define RELAXATION .01
 
-// Pressure terms
-#define K_P .2
-#define E_P 4
-#define DQ_P .25
-
-// Fluid-solid coupling constant
-#define S_SOLID .5
-
-#include "particle.h"
+#include "neighborlist.h"
+#include "particlestore.h"
+#include "sphkernels.h"
 #include <QSet>
 
 class GasConstraint : public Constraint {
 public:
-    GasConstraint(double density, QList<int> *particles, bool open);
+    // Pressure terms, tuned apart from TotalFluidConstraint's
+    static const double K_P;
+    static const int E_P = 4;
+    static const double DQ_P;
+
+    // Fluid-solid coupling constant
+    static const double S_SOLID;
+
+    GasConstraint(double density, QList<int> *particles, NeighborList *neighborList, bool open);
     virtual ~GasConstraint();
 
-    void project(QList<Particle *> *estimates, int *counts);
-    void draw(QList<Particle *> *particles);
+    void project(ParticleStore *estimates, int *counts);
+    void draw(ParticleStore *particles);
 
-    double evaluate(QList<Particle *> *estimates);
-    glm::dvec2 gradient(QList<Particle *> *estimates, int respect);
+    double evaluate(ParticleStore *estimates);
+    glm::dvec2 gradient(ParticleStore *estimates, int respect);
     void updateCounts(int *counts);
+    void getStencil(std::vector<int> *out);
 
     double poly6(double rlen);
     glm::dvec2 spikyGrad(const glm::dvec2 &r, double rlen);
-    glm::dvec2 grad(QList<Particle *> *estimates, int k, int j);
 
-    void addParticle(Particle *p, int index);
+    // Add particle index, or the count particles starting at first
+    void addParticle(int index);
+    void addParticles(int first, int count);
+
+    inline double getDensity() const { return p0; }
+    inline const QList<int> &getParticles() const { return ps; }
+    inline bool isOpen() const { return m_open; }
 
 private:
     double p0;
     QList<int> ps;
-    QList<int> *neighbors;
-    int numParticles;
-    glm::dvec2 *deltas;
-    QHash<int, double> lambdas;
+    std::vector<glm::dvec2> deltas;
+    std::vector<double> lambdas;
     bool m_open;
+    NeighborList *neighborList;
+    SPHNeighbors packed;
 };
 
 #endif // GASCONSTRAINT_H
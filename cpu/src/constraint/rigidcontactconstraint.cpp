@@ -7,8 +7,8 @@ RigidContactConstraint::RigidContactConstraint(int first, int second, QList<Body
 RigidContactConstraint::~RigidContactConstraint() {
 }
 
-bool RigidContactConstraint::initBoundary(Particle *p1, Particle *p2) {
-    glm::dvec2 x12 = p1->getP(stable) - p2->getP(stable);
+bool RigidContactConstraint::initBoundary(ParticleStore *estimates) {
+    glm::dvec2 x12 = estimates->getP(i1, stable) - estimates->getP(i2, stable);
     double len = glm::length(x12);
     d = PARTICLE_DIAM - len;
     if (d < EPSILON)
@@ -23,12 +23,15 @@ bool RigidContactConstraint::initBoundary(Particle *p1, Particle *p2) {
     return false;
 }
 
-void RigidContactConstraint::project(QList<Particle *> *estimates, int *counts) {
-    Particle *p1 = estimates->at(i1), *p2 = estimates->at(i2);
-    SDFData dat1 = p1->getSDFData(bods, i1), dat2 = p2->getSDFData(bods, i2);
+void RigidContactConstraint::project(ParticleStore *estimates, int *counts) {
+    project(estimates, counts, estimates->ep.data());
+}
+
+void RigidContactConstraint::project(ParticleStore *estimates, int *counts, glm::dvec2 *deltas) {
+    SDFData dat1 = estimates->getSDFData(bods, i1), dat2 = estimates->getSDFData(bods, i2);
 
     if (dat1.distance < 0 || dat2.distance < 0) {
-        glm::dvec2 x12 = p2->getP(stable) - p1->getP(stable);
+        glm::dvec2 x12 = estimates->getP(i2, stable) - estimates->getP(i1, stable);
         double len = glm::length(x12);
         d = PARTICLE_DIAM - len;
         if (d < EPSILON)
@@ -44,63 +47,69 @@ void RigidContactConstraint::project(QList<Particle *> *estimates, int *counts)
         }
 
         if (d < PARTICLE_DIAM + EPSILON) {
-            if (initBoundary(p1, p2)) {
+            if (initBoundary(estimates)) {
                 return;
             }
         }
     }
 
-    double wSum = p1->tmass + p2->tmass;
+    // Friction works from local copies including this constraint's own correction
+    glm::dvec2 &p1 = estimates->p[i1], &p2 = estimates->p[i2],
+               ep1 = estimates->ep[i1], ep2 = estimates->ep[i2];
+    glm::dvec2 &dep1 = deltas[i1], &dep2 = deltas[i2];
+    double w1 = estimates->tmass[i1], w2 = estimates->tmass[i2],
+           wSum = w1 + w2;
     glm::dvec2 dp = (1.0 / wSum) * d * n,
-               dp1 = -p1->tmass * dp / (double)counts[i1],
-               dp2 = p2->tmass * dp / (double)counts[i2];
+               dp1 = -w1 * dp / (double)counts[i1],
+               dp2 = w2 * dp / (double)counts[i2];
 
     if (!stable) {
-        p1->ep += dp1;
-        p2->ep += dp2;
+        ep1 += dp1;
+        ep2 += dp2;
+        dep1 += dp1;
+        dep2 += dp2;
     } else {
-        p1->p += dp1;
-        p2->p += dp2;
+        p1 += dp1;
+        p2 += dp2;
     }
 
     // Apply friction
     glm::dvec2 nf = glm::normalize(n);
-    glm::dvec2 dpf = (p1->ep - p1->p) - (p2->ep - p2->p),
+    glm::dvec2 dpf = (ep1 - p1) - (ep2 - p2),
                dpt = dpf - glm::dot(dpf, nf) * nf;
     double ldpt = glm::length(dpt);
     if (ldpt < EPSILON) {
         return;
     }
-    double sFric = sqrt(p1->sFriction * p2->sFriction),
-           kFric = sqrt(p1->kFriction * p2->kFriction);
+    double sFric = sqrt(estimates->sFriction[i1] * estimates->sFriction[i2]),
+           kFric = sqrt(estimates->kFriction[i1] * estimates->kFriction[i2]);
 
     if (ldpt < sFric * d) {
         if (stable) {
-            p1->p -= dpt * p1->tmass / wSum;
-            p2->p += dpt * p2->tmass / wSum;
+            p1 -= dpt * w1 / wSum;
+            p2 += dpt * w2 / wSum;
         }
-        p1->ep -= dpt * p1->tmass / wSum;
-        p2->ep += dpt * p2->tmass / wSum;
+        dep1 -= dpt * w1 / wSum;
+        dep2 += dpt * w2 / wSum;
     } else {
         glm::dvec2 delta = dpt * min(kFric * d / ldpt, 1.);
         if (stable) {
-            p1->p -= delta * p1->tmass / wSum;
-            p2->p += delta * p2->tmass / wSum;
+            p1 -= delta * w1 / wSum;
+            p2 += delta * w2 / wSum;
         }
-        p1->ep -= delta * p1->tmass / wSum;
-        p2->ep += delta * p2->tmass / wSum;
+        dep1 -= delta * w1 / wSum;
+        dep2 += delta * w2 / wSum;
     }
 }
 
-void RigidContactConstraint::draw(QList<Particle *> *particles) {
+void RigidContactConstraint::draw(ParticleStore *particles) {
 }
 
-double RigidContactConstraint::evaluate(QList<Particle *> *estimates) {
-    Particle *p1 = estimates->at(i1), *p2 = estimates->at(i2);
-    SDFData dat1 = p1->getSDFData(bods, i1), dat2 = p2->getSDFData(bods, i2);
+double RigidContactConstraint::evaluate(ParticleStore *estimates) {
+    SDFData dat1 = estimates->getSDFData(bods, i1), dat2 = estimates->getSDFData(bods, i2);
 
     if (dat1.distance < 0 || dat2.distance < 0) {
-        glm::dvec2 x12 = p2->getP(stable) - p1->getP(stable);
+        glm::dvec2 x12 = estimates->getP(i2, stable) - estimates->getP(i1, stable);
         double len = glm::length(x12);
         d = PARTICLE_DIAM - len;
         n = len > EPSILON ? -x12 / len : glm::dvec2(0, 1);
@@ -114,14 +123,14 @@ double RigidContactConstraint::evaluate(QList<Particle *> *estimates) {
         }
 
         if (d < PARTICLE_DIAM + EPSILON) {
-            initBoundary(p1, p2);
+            initBoundary(estimates);
         }
     }
 
     return d;
 }
 
-glm::dvec2 RigidContactConstraint::gradient(QList<Particle *> *estimates, int respect) {
+glm::dvec2 RigidContactConstraint::gradient(ParticleStore *estimates, int respect) {
     if (respect == i1) {
         return -n;
     }
@@ -137,3 +146,8 @@ void RigidContactConstraint::updateCounts(int *counts) {
     counts[i1]++;
     counts[i2]++;
 }
+
+void RigidContactConstraint::getStencil(std::vector<int> *out) {
+    out->push_back(i1);
+    out->push_back(i2);
+}
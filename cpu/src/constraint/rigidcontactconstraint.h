@@ -1,21 +1,29 @@
 #ifndef RIGIDCONTACTCONSTRAINT_H
 #define RIGIDCONTACTCONSTRAINT_H
 
-#include "particle.h"
+#include "particlestore.h"
 
 class RigidContactConstraint : public Constraint {
 public:
     RigidContactConstraint(int first, int second, QList<Body *> *bodies, bool st = false);
     virtual ~RigidContactConstraint();
 
-    bool initBoundary(Particle *p1, Particle *p2);
+    bool initBoundary(ParticleStore *estimates);
 
-    void project(QList<Particle *> *estimates, int *counts);
-    void draw(QList<Particle *> *particles);
+    void project(ParticleStore *estimates, int *counts);
 
-    double evaluate(QList<Particle *> *estimates);
-    glm::dvec2 gradient(QList<Particle *> *estimates, int respect);
+    // Project, adding the corrections to ep into deltas instead of estimates->ep
+    void project(ParticleStore *estimates, int *counts, glm::dvec2 *deltas);
+    void draw(ParticleStore *particles);
+
+    double evaluate(ParticleStore *estimates);
+    glm::dvec2 gradient(ParticleStore *estimates, int respect);
     void updateCounts(int *counts);
+    void getStencil(std::vector<int> *out);
+
+    // The two particles this constraint moves
+    inline int getFirst() const { return i1; }
+    inline int getSecond() const { return i2; }
 
 private:
     QList<Body *> *bods;
@@ -0,0 +1,208 @@
+#include "sphkernels.h"
+
+#if defined(SPH_AVX2)
+#include <immintrin.h>
+#elif defined(SPH_SSE2)
+#include <emmintrin.h>
+#endif
+
+#define POLY6_SCALE (315. / (64. * M_PI * H9))
+#define SPIKY_SCALE (45. / (M_PI * H6))
+
+// Thin wrappers so both vector widths share the same kernel bodies below
+#if defined(SPH_AVX2)
+
+#define SPH_WIDTH 4
+typedef __m256d vd;
+static inline vd vset(double a) { return _mm256_set1_pd(a); }
+static inline vd vload(const double *p) { return _mm256_loadu_pd(p); }
+static inline vd vadd(vd a, vd b) { return _mm256_add_pd(a, b); }
+static inline vd vsub(vd a, vd b) { return _mm256_sub_pd(a, b); }
+static inline vd vmul(vd a, vd b) { return _mm256_mul_pd(a, b); }
+static inline vd vdiv(vd a, vd b) { return _mm256_div_pd(a, b); }
+static inline vd vsqrt(vd a) { return _mm256_sqrt_pd(a); }
+static inline vd vmax(vd a, vd b) { return _mm256_max_pd(a, b); }
+static inline vd vand(vd a, vd b) { return _mm256_and_pd(a, b); }
+static inline vd vgt(vd a, vd b) { return _mm256_cmp_pd(a, b, _CMP_GT_OQ); }
+static inline vd vlt(vd a, vd b) { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+static inline double vsum(vd a) {
+    double lanes[4];
+    _mm256_storeu_pd(lanes, a);
+    return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+
+#elif defined(SPH_SSE2)
+
+#define SPH_WIDTH 2
+typedef __m128d vd;
+static inline vd vset(double a) { return _mm_set1_pd(a); }
+static inline vd vload(const double *p) { return _mm_loadu_pd(p); }
+static inline vd vadd(vd a, vd b) { return _mm_add_pd(a, b); }
+static inline vd vsub(vd a, vd b) { return _mm_sub_pd(a, b); }
+static inline vd vmul(vd a, vd b) { return _mm_mul_pd(a, b); }
+static inline vd vdiv(vd a, vd b) { return _mm_div_pd(a, b); }
+static inline vd vsqrt(vd a) { return _mm_sqrt_pd(a); }
+static inline vd vmax(vd a, vd b) { return _mm_max_pd(a, b); }
+static inline vd vand(vd a, vd b) { return _mm_and_pd(a, b); }
+static inline vd vgt(vd a, vd b) { return _mm_cmpgt_pd(a, b); }
+static inline vd vlt(vd a, vd b) { return _mm_cmplt_pd(a, b); }
+static inline double vsum(vd a) {
+    double lanes[2];
+    _mm_storeu_pd(lanes, a);
+    return lanes[0] + lanes[1];
+}
+
+#endif
+
+SPHNeighbors::SPHNeighbors() {
+    m_offsets.assign(1, 0);
+}
+
+SPHNeighbors::~SPHNeighbors() {
+}
+
+void SPHNeighbors::gather(ParticleStore *estimates, NeighborList *neighborList, const QList<int> &ps,
+                          double massSolid, double gradSolid) {
+    js.clear();
+    rx.clear();
+    ry.clear();
+    mass.clear();
+    solid.clear();
+    m_offsets.resize(ps.size() + 1);
+    m_offsets[0] = 0;
+
+    for (int k = 0; k < ps.size(); k++) {
+        int i = ps[k];
+        const glm::dvec2 &ep = estimates->ep[i];
+
+        int numCandidates = neighborList->getNumNeighbors(i);
+        const int *candidates = neighborList->getNeighbors(i);
+        for (int c = 0; c < numCandidates; c++) {
+            int j = candidates[c];
+
+            // Fixed particles are ignored, and the particle itself is handled by the constraint
+            if (j == i || estimates->imass[j] == 0) {
+                continue;
+            }
+
+            glm::dvec2 r = ep - estimates->ep[j];
+            if (glm::dot(r, r) < H2) {
+                bool isSolid = estimates->ph[j] == SOLID;
+                js.push_back(j);
+                rx.push_back(r.x);
+                ry.push_back(r.y);
+                mass.push_back((isSolid ? massSolid : 1.) / estimates->imass[j]);
+                solid.push_back(isSolid ? gradSolid : 1.);
+            }
+        }
+        m_offsets[k + 1] = js.size();
+    }
+    lambda.resize(js.size());
+}
+
+SPHDensity sphDensity(const double *rx, const double *ry, const double *mass, const double *solid, int n) {
+    double pi = 0., gradSq = 0., gx = 0., gy = 0.;
+    int x = 0;
+
+#ifdef SPH_WIDTH
+    const vd zero = vset(0.), h = vset(H), h2 = vset(H2), poly = vset(POLY6_SCALE), spiky = vset(-SPIKY_SCALE);
+    vd vpi = zero, vgradSq = zero, vgx = zero, vgy = zero;
+    for (; x + SPH_WIDTH <= n; x += SPH_WIDTH) {
+        vd dx = vload(rx + x), dy = vload(ry + x);
+        vd r2 = vadd(vmul(dx, dx), vmul(dy, dy)), rlen = vsqrt(r2);
+
+        vd t = vmax(vsub(h2, r2), zero);
+        vpi = vadd(vpi, vmul(vmul(poly, vmul(vmul(t, t), t)), vload(mass + x)));
+
+        // Spiky gradient, masked to zero for coincident particles and outside the kernel
+        vd hr = vsub(h, rlen),
+           valid = vand(vgt(rlen, zero), vlt(rlen, h)),
+           g = vand(valid, vdiv(vmul(spiky, vmul(hr, hr)), rlen)),
+           sx = vmul(g, dx), sy = vmul(g, dy), s = vload(solid + x);
+        vgradSq = vadd(vgradSq, vadd(vmul(sx, sx), vmul(sy, sy)));
+        vgx = vadd(vgx, vmul(s, sx));
+        vgy = vadd(vgy, vmul(s, sy));
+    }
+    pi = vsum(vpi);
+    gradSq = vsum(vgradSq);
+    gx = vsum(vgx);
+    gy = vsum(vgy);
+#endif
+
+    for (; x < n; x++) {
+        double r2 = rx[x] * rx[x] + ry[x] * ry[x], rlen = sqrt(r2);
+
+        double t = H2 - r2 > 0 ? H2 - r2 : 0;
+        pi += POLY6_SCALE * (t * t * t) * mass[x];
+
+        if (rlen > 0 && rlen < H) {
+            double hr = H - rlen,
+                   g = (-SPIKY_SCALE * (hr * hr)) / rlen,
+                   sx = g * rx[x], sy = g * ry[x];
+            gradSq += sx * sx + sy * sy;
+            gx += solid[x] * sx;
+            gy += solid[x] * sy;
+        }
+    }
+
+    SPHDensity out;
+    out.pi = pi;
+    out.gradSq = gradSq;
+    out.gradSum = glm::dvec2(gx, gy);
+    return out;
+}
+
+glm::dvec2 sphDelta(const double *rx, const double *ry, const double *lambda, int n, double kP, int eP, double dq) {
+    double invWq = 1. / sphPoly6(dq * dq), dx = 0., dy = 0.;
+    int x = 0;
+
+#ifdef SPH_WIDTH
+    const vd zero = vset(0.), one = vset(1.), h = vset(H), h2 = vset(H2), poly = vset(POLY6_SCALE),
+             spiky = vset(-SPIKY_SCALE), negKP = vset(-kP), vinvWq = vset(invWq);
+    vd vdx = zero, vdy = zero;
+    for (; x + SPH_WIDTH <= n; x += SPH_WIDTH) {
+        vd rx4 = vload(rx + x), ry4 = vload(ry + x);
+        vd r2 = vadd(vmul(rx4, rx4), vmul(ry4, ry4)), rlen = vsqrt(r2);
+
+        // Artificial pressure
+        vd t = vmax(vsub(h2, r2), zero),
+           ratio = vmul(vmul(poly, vmul(vmul(t, t), t)), vinvWq),
+           power = one;
+        for (int e = 0; e < eP; e++) {
+            power = vmul(power, ratio);
+        }
+        vd scale = vadd(vload(lambda + x), vmul(negKP, power));
+
+        vd hr = vsub(h, rlen),
+           valid = vand(vgt(rlen, zero), vlt(rlen, h)),
+           g = vand(valid, vdiv(vmul(spiky, vmul(hr, hr)), rlen)),
+           sg = vmul(scale, g);
+        vdx = vadd(vdx, vmul(sg, rx4));
+        vdy = vadd(vdy, vmul(sg, ry4));
+    }
+    dx = vsum(vdx);
+    dy = vsum(vdy);
+#endif
+
+    for (; x < n; x++) {
+        double r2 = rx[x] * rx[x] + ry[x] * ry[x], rlen = sqrt(r2);
+        if (!(rlen > 0 && rlen < H)) {
+            continue;
+        }
+
+        double t = H2 - r2 > 0 ? H2 - r2 : 0,
+               ratio = (POLY6_SCALE * (t * t * t)) * invWq,
+               power = 1.;
+        for (int e = 0; e < eP; e++) {
+            power *= ratio;
+        }
+
+        double hr = H - rlen,
+               g = (-SPIKY_SCALE * (hr * hr)) / rlen,
+               sg = (lambda[x] + -kP * power) * g;
+        dx += sg * rx[x];
+        dy += sg * ry[x];
+    }
+
+    return glm::dvec2(dx, dy);
+}
@@ -0,0 +1,69 @@
+#ifndef SPHKERNELS_H
+#define SPHKERNELS_H
+
+#include "neighborlist.h"
+#include "particlestore.h"
+
+#include <vector>
+
+#define H 2.
+#define H2 4.
+#define H6 64.
+#define H9 512.
+
+// Vector width the kernels were built for, AVX2 when compiled with -mavx2, SSE2 on any other x86-64
+// compiler, and plain scalar code otherwise. Define SPH_SCALAR to force the scalar versions.
+#if defined(__AVX2__) && !defined(SPH_SCALAR)
+#define SPH_AVX2
+#elif defined(__SSE2__) && !defined(SPH_SCALAR)
+#define SPH_SSE2
+#endif
+
+// The neighbors of every particle of a fluid or gas within the kernel radius, excluding the particle
+// itself and fixed particles, packed into flat arrays so the kernels can stream through them. Neighbor
+// x of particle k lives at index getOffset(k) + x.
+class SPHNeighbors {
+public:
+    SPHNeighbors();
+    virtual ~SPHNeighbors();
+
+    // Pack the neighbors of particles ps from the shared neighbor list, scaling the mass of solids
+    // by massSolid and their gradient contributions by gradSolid
+    void gather(ParticleStore *estimates, NeighborList *neighborList, const QList<int> &ps,
+                double massSolid, double gradSolid);
+
+    inline int getOffset(int k) const { return m_offsets[k]; }
+    inline int getCount(int k) const { return m_offsets[k + 1] - m_offsets[k]; }
+
+    std::vector<int> js;               // particle index of each neighbor
+    std::vector<double> rx, ry;        // offset from the particle to the neighbor, ep_i - ep_j
+    std::vector<double> mass, solid;   // mass and gradient weights, scaled down for solids
+    std::vector<double> lambda;        // scratch space for the summed lambdas of each pair
+
+private:
+    std::vector<int> m_offsets;
+};
+
+// Sums over one particle's packed neighbors for its density constraint
+struct SPHDensity {
+    double pi;          // density, sum of poly6 * mass
+    double gradSq;      // sum of squared spiky gradients
+    glm::dvec2 gradSum; // sum of spiky gradients weighted by solid coupling
+};
+
+// Density and gradient sums over n packed neighbors
+SPHDensity sphDensity(const double *rx, const double *ry, const double *mass, const double *solid, int n);
+
+// Position correction over n packed neighbors, the sum of (lambda + s_corr) * spiky gradient where
+// s_corr = -kP * (poly6(r) / poly6(dq))^eP is the artificial pressure term
+glm::dvec2 sphDelta(const double *rx, const double *ry, const double *lambda, int n, double kP, int eP, double dq);
+
+// Poly6 kernel, as a function of squared distance
+inline double sphPoly6(double r2) {
+    if (r2 >= H2)
+        return 0;
+    double term2 = (H2 - r2);
+    return (315. / (64. * M_PI * H9)) * (term2 * term2 * term2);
+}
+
+#endif // SPHKERNELS_H
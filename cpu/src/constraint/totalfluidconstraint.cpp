@@ -1,85 +1,65 @@
 #include "totalfluidconstraint.h"
 
-TotalFluidConstraint::TotalFluidConstraint(double density, QList<int> *particles)
-    : Constraint(), p0(density) {
-    neighbors = new QList<int>[particles->size()];
-    deltas = new glm::dvec2[particles->size()];
+#include <algorithm>
+#include <functional>
 
-    numParticles = particles->size();
+const double TotalFluidConstraint::K_P = .1;
+const double TotalFluidConstraint::DQ_P = .2;
+const double TotalFluidConstraint::S_SOLID = 0.;
 
+TotalFluidConstraint::TotalFluidConstraint(double density, QList<int> *particles, NeighborList *neighborList)
+    : Constraint(), p0(density), neighborList(neighborList) {
     for (int i = 0; i < particles->size(); i++) {
         ps.append(particles->at(i));
     }
 }
 
 TotalFluidConstraint::~TotalFluidConstraint() {
-    delete[] neighbors;
 }
 
+// The deltas only grow, in project, so changing which particles belong to the fluid never
+// reallocates anything but ps itself
 void TotalFluidConstraint::addParticle(int index) {
-    delete[] neighbors;
-    delete[] deltas;
-    numParticles++;
-    neighbors = new QList<int>[numParticles];
-    deltas = new glm::dvec2[numParticles];
     ps.append(index);
 }
 
-void TotalFluidConstraint::removeParticle(int index) {
-    delete[] neighbors;
-    delete[] deltas;
-    // if(ps.contains(index)) {
-    numParticles--;
-    neighbors = new QList<int>[numParticles];
-    deltas = new glm::dvec2[numParticles];
-    ps.removeAt(index);
-    // }
+void TotalFluidConstraint::addParticles(int first, int count) {
+    ps.reserve(ps.size() + count);
+    for (int i = first; i < first + count; i++) {
+        ps.append(i);
+    }
+}
+
+void TotalFluidConstraint::removeParticle(int k) {
+    ps[k] = ps.last();
+    ps.removeLast();
+}
+
+void TotalFluidConstraint::removeParticles(std::vector<int> *ks) {
+    // Going from the back, the particle moved into each hole is never one still to be removed
+    std::sort(ks->begin(), ks->end(), std::greater<int>());
+    for (unsigned int r = 0; r < ks->size(); r++) {
+        removeParticle(ks->at(r));
+    }
 }
 
-void TotalFluidConstraint::project(QList<Particle *> *estimates, int *counts) {
-    // Find neighboring particles and estimate pi for each particle
-    lambdas.clear();
+void TotalFluidConstraint::project(ParticleStore *estimates, int *counts) {
+    // Make sure the shared neighbor lists still cover every particle within H
+    neighborList->refresh(estimates);
+
+    // Pack up the neighbors of each particle for the SPH kernels
+    packed.gather(estimates, neighborList, ps, S_SOLID, S_SOLID);
+
+    // Estimate pi and lambda for each particle
+    lambdas.assign(estimates->size(), 0.);
     for (int k = 0; k < ps.size(); k++) {
-        neighbors[k].clear();
-        int i = ps[k];
-        Particle *p_i = estimates->at(i);
-        double pi = 0., denom = 0.;
-
-        // Find neighbors
-        for (int j = 0; j < estimates->size(); j++) {
-
-            // Check if the next particle is actually this particle
-            if (j != i) {
-                Particle *p_j = estimates->at(j);
-
-                // Ignore fixed particles
-                if (p_j->imass == 0)
-                    continue;
-                glm::dvec2 r = p_i->ep - p_j->ep;
-                double rlen2 = glm::dot(r, r);
-                if (rlen2 < H2) {
-
-                    // Found a neighbor! Remember it and add to pi and the gamma denominator
-                    neighbors[k].append(j);
-                    double incr = poly6(rlen2) / p_j->imass;
-                    if (p_j->ph == SOLID) {
-                        incr *= S_SOLID;
-                    }
-                    pi += incr;
-
-                    glm::dvec2 gr = grad(estimates, k, j);
-                    denom += glm::dot(gr, gr);
-                }
-
-                // If it is, cut to the chase
-            } else {
-                neighbors[k].append(j);
-                pi += poly6(0) / p_i->imass;
-            }
-        }
+        int i = ps[k], start = packed.getOffset(k), n = packed.getCount(k);
+        SPHDensity dens = sphDensity(packed.rx.data() + start, packed.ry.data() + start,
+                                     packed.mass.data() + start, packed.solid.data() + start, n);
 
-        glm::dvec2 gr = grad(estimates, k, i);
-        denom += glm::dot(gr, gr);
+        // The particle itself adds to its density, but its own gradient terms vanish
+        double pi = dens.pi + poly6(0) / estimates->imass[i],
+               denom = (dens.gradSq + glm::dot(dens.gradSum, dens.gradSum)) / (p0 * p0);
 
         // Compute the gamma value
         // cout << i << " estimated " << pi << endl;
@@ -88,40 +68,29 @@ void TotalFluidConstraint::project(QList<Particle *> *estimates, int *counts) {
     }
 
     // Compute actual deltas
+    deltas.resize(ps.size());
     for (int k = 0; k < ps.size(); k++) {
-        glm::dvec2 delta = glm::dvec2();
-        int i = ps[k];
-        Particle *p_i = estimates->at(i);
-
-        for (int x = 0; x < neighbors[k].size(); x++) {
-            int j = neighbors[k][x];
-            if (i == j)
-                continue;
-            Particle *p_j = estimates->at(j);
-            glm::dvec2 r = p_i->ep - p_j->ep;
-            double rlen = glm::length(r);
-            glm::dvec2 sg = spikyGrad(r, rlen);
-            double lambdaCorr = -K_P * pow((poly6(rlen * rlen) / poly6(DQ_P * DQ_P * H * H)), E_P);
-            delta += (lambdas[i] + lambdas[j] + lambdaCorr) * sg;
+        int i = ps[k], start = packed.getOffset(k), n = packed.getCount(k);
+        for (int x = start; x < start + n; x++) {
+            packed.lambda[x] = lambdas[i] + lambdas[packed.js[x]];
         }
+        glm::dvec2 delta = sphDelta(packed.rx.data() + start, packed.ry.data() + start,
+                                    packed.lambda.data() + start, n, K_P, E_P, DQ_P * H);
         deltas[k] = (delta / p0);
     }
 
+    // Neighbor counts include the particle itself
     for (int k = 0; k < ps.size(); k++) {
         int i = ps[k];
-        Particle *p_i = estimates->at(i);
-        p_i->ep += deltas[k] / ((double)neighbors[k].size() + counts[i]);
+        estimates->ep[i] += deltas[k] / ((double)packed.getCount(k) + 1 + counts[i]);
     }
 }
 
-void TotalFluidConstraint::draw(QList<Particle *> *particles) {
+void TotalFluidConstraint::draw(ParticleStore *particles) {
 }
 
 double TotalFluidConstraint::poly6(double r2) {
-    if (r2 >= H2)
-        return 0;
-    double term2 = (H2 - r2);
-    return (315. / (64. * M_PI * H9)) * (term2 * term2 * term2);
+    return sphPoly6(r2);
     // return (H-r) / (H*H);
 }
 
@@ -134,35 +103,20 @@ glm::dvec2 TotalFluidConstraint::spikyGrad(const glm::dvec2 &r, double rlen2) {
     // return -r / (H*H*rlen);
 }
 
-glm::dvec2 TotalFluidConstraint::grad(QList<Particle *> *estimates, int k, int j) {
-    int i = ps[k];
-    Particle *p_i = estimates->at(i), *p_j = estimates->at(j);
-    glm::dvec2 r = p_i->ep - p_j->ep;
-    double rlen = glm::length(r);
-    if (p_i != p_j) {
-        return -spikyGrad(r, rlen) / (p0);
-    }
-
-    glm::dvec2 out = glm::dvec2();
-    for (int x = 0; x < neighbors[k].size(); x++) {
-        Particle *p_j = estimates->at(neighbors[k][x]);
-        r = p_i->ep - p_j->ep;
-        rlen = glm::length(r);
-        out += (p_j->ph == SOLID ? S_SOLID : 1.) * spikyGrad(r, rlen);
-    }
-
-    return out / (p0);
-}
-
-double TotalFluidConstraint::evaluate(QList<Particle *> *estimates) {
+double TotalFluidConstraint::evaluate(ParticleStore *estimates) {
     std::cout << "You shouldn't be calling evaluate on fluids" << std::endl;
     exit(1);
 }
 
-glm::dvec2 TotalFluidConstraint::gradient(QList<Particle *> *estimates, int respect) {
+glm::dvec2 TotalFluidConstraint::gradient(ParticleStore *estimates, int respect) {
     std::cout << "You shouldn't be calling gradient on fluids" << std::endl;
     exit(1);
 }
 
 void TotalFluidConstraint::updateCounts(int *counts) {
 }
+
+void TotalFluidConstraint::getStencil(std::vector<int> *out) {
+    // Fluids are always projected directly, never through the matrix solver
+    (void)out;
+}
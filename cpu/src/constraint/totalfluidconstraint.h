@@ -21,42 +21,53 @@
 // Epsilon in gamma correction denominator
 #define RELAXATION .01
 
-// Pressure terms
-#define K_P .1
-#define E_P 4
-#define DQ_P .2
-
-// Fluid-solid coupling constant
-#define S_SOLID 0.
-
-#include "particle.h"
+#include "neighborlist.h"
+#include "particlestore.h"
+#include "sphkernels.h"
 
 class TotalFluidConstraint : public Constraint {
 public:
-    TotalFluidConstraint(double density, QList<int> *particles);
+    // Pressure terms
+    static const double K_P;
+    static const int E_P = 4;
+    static const double DQ_P;
+
+    // Fluid-solid coupling constant
+    static const double S_SOLID;
+
+    TotalFluidConstraint(double density, QList<int> *particles, NeighborList *neighborList);
     virtual ~TotalFluidConstraint();
 
-    void project(QList<Particle *> *estimates, int *counts);
-    void draw(QList<Particle *> *particles);
+    void project(ParticleStore *estimates, int *counts);
+    void draw(ParticleStore *particles);
 
-    double evaluate(QList<Particle *> *estimates);
-    glm::dvec2 gradient(QList<Particle *> *estimates, int respect);
+    double evaluate(ParticleStore *estimates);
+    glm::dvec2 gradient(ParticleStore *estimates, int respect);
     void updateCounts(int *counts);
+    void getStencil(std::vector<int> *out);
 
     double poly6(double rlen);
     glm::dvec2 spikyGrad(const glm::dvec2 &r, double rlen);
-    glm::dvec2 grad(QList<Particle *> *estimates, int k, int j);
+
+    // Add particle index, or the count particles starting at first
     void addParticle(int index);
-    void removeParticle(int i);
+    void addParticles(int first, int count);
+
+    // Remove the k-th particle of ps. The last particle takes its place, so walk ps backwards
+    // when removing while iterating.
+    void removeParticle(int k);
+
+    // Remove several particles by their positions in ps at once
+    void removeParticles(std::vector<int> *ks);
 
-    QList<int> *neighbors;
     QList<int> ps;
     double p0;
-    QHash<int, double> lambdas;
+    std::vector<double> lambdas; // by global particle index, zero for particles outside this fluid
 
 private:
-    glm::dvec2 *deltas;
-    int numParticles;
+    std::vector<glm::dvec2> deltas;
+    NeighborList *neighborList;
+    SPHNeighbors packed;
 };
 
 #endif // TOTALFLUIDCONSTRAINT_H
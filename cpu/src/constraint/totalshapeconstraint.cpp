@@ -8,26 +8,40 @@ TotalShapeConstraint::TotalShapeConstraint(Body *bod, double stiff)
 TotalShapeConstraint::~TotalShapeConstraint() {
 }
 
-void TotalShapeConstraint::project(QList<Particle *> *estimates, int *counts) {
+void TotalShapeConstraint::project(ParticleStore *estimates, int *counts) {
     body->updateCOM(estimates);
 
     // implemented using http://labs.byhook.com/2010/06/29/particle-based-rigid-bodies-using-shape-matching/
-    for (int i = 0; i < body->particles.size(); i++) {
-        int idx = body->particles[i];
-        Particle *p = estimates->at(idx);
-        p->ep += (guess(idx) - p->ep) * stiffness;
+    // The rotated SDF data is refreshed here once per iteration for every contact of the body
+    for (unsigned int k = 0; k < body->particles.size(); k++) {
+        int idx = body->particles[k];
+        estimates->ep[idx] += (body->guess(k) - estimates->ep[idx]) * stiffness;
+        body->rotateSDF(k);
     }
 }
 
-void TotalShapeConstraint::draw(QList<Particle *> *particles) {
+void TotalShapeConstraint::match(ParticleStore *estimates) {
+    body->updateCOM(estimates);
+    body->rotateSDF();
+}
+
+void TotalShapeConstraint::project(ParticleStore *estimates, int *counts, glm::dvec2 *deltas) {
+    // Only reads the body, which match already fit to the same ep
+    for (unsigned int k = 0; k < body->particles.size(); k++) {
+        int idx = body->particles[k];
+        deltas[idx] += (body->guess(k) - estimates->ep[idx]) * stiffness;
+    }
+}
+
+void TotalShapeConstraint::draw(ParticleStore *particles) {
+#ifndef HEADLESS
     glColor3f(0, 1, 0);
     glBegin(GL_LINES);
 
-    for (int i = 0; i < body->particles.size(); i++) {
-        int idx = body->particles[i];
-        Particle *p = particles->at(idx);
+    for (unsigned int i = 0; i < body->particles.size(); i++) {
+        const glm::dvec2 &p = particles->p[body->particles[i]];
 
-        glVertex2f(p->p.x, p->p.y);
+        glVertex2f(p.x, p.y);
         glVertex2f(body->center.x, body->center.y);
     }
 
@@ -36,23 +50,22 @@ void TotalShapeConstraint::draw(QList<Particle *> *particles) {
     glPointSize(3);
     glBegin(GL_POINTS);
     glVertex2f(body->center.x, body->center.y);
-    for (int i = 0; i < body->particles.size(); i++) {
-        int idx = body->particles[i];
-        Particle *p = particles->at(idx);
-        glVertex2f(p->p.x, p->p.y);
+    for (unsigned int i = 0; i < body->particles.size(); i++) {
+        const glm::dvec2 &p = particles->p[body->particles[i]];
+        glVertex2f(p.x, p.y);
     }
     glEnd();
+#endif
 }
 
-double TotalShapeConstraint::evaluate(QList<Particle *> *estimates) {
+double TotalShapeConstraint::evaluate(ParticleStore *estimates) {
     (void)estimates;
     return 0;
 }
 
-glm::dvec2 TotalShapeConstraint::gradient(QList<Particle *> *estimates, int respect) {
+glm::dvec2 TotalShapeConstraint::gradient(ParticleStore *estimates, int respect) {
     //    if (body->rs.contains(respect)) {
-    //        Particle *p = estimates->at(respect);
-    //        glm::dvec2 out = guess(respect) - p->ep;
+    //        glm::dvec2 out = guess(respect) - estimates->ep[respect];
     //        if (out == glm::dvec2()) {
     //            return glm::dvec2(0,0);
     //        }
@@ -64,15 +77,12 @@ glm::dvec2 TotalShapeConstraint::gradient(QList<Particle *> *estimates, int resp
 }
 
 void TotalShapeConstraint::updateCounts(int *counts) {
-    for (int i = 0; i < body->particles.size(); i++) {
+    for (unsigned int i = 0; i < body->particles.size(); i++) {
         counts[body->particles[i]]++;
     }
 }
 
-glm::dvec2 TotalShapeConstraint::guess(int idx) {
-    double c = cos(body->angle), s = sin(body->angle);
-
-    glm::dvec2 q = body->rs[idx],
-               d = glm::dvec2(c * q.x - s * q.y, s * q.x + c * q.y);
-    return d + body->center;
+void TotalShapeConstraint::getStencil(std::vector<int> *out) {
+    // Shape matching is always projected directly, its gradient is zero everywhere
+    (void)out;
 }
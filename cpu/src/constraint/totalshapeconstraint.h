@@ -1,21 +1,28 @@
 #ifndef TOTALSHAPECONSTRAINT_H
 #define TOTALSHAPECONSTRAINT_H
 
-#include "particle.h"
+#include "particlestore.h"
 
 class TotalShapeConstraint : public Constraint {
 public:
     TotalShapeConstraint(Body *bod, double stiff = 1.0);
     virtual ~TotalShapeConstraint();
 
-    void project(QList<Particle *> *estimates, int *counts);
-    void draw(QList<Particle *> *particles);
+    void project(ParticleStore *estimates, int *counts);
 
-    double evaluate(QList<Particle *> *estimates);
-    glm::dvec2 gradient(QList<Particle *> *estimates, int respect);
-    void updateCounts(int *counts);
+    // Fit the body's center and rotation to ep and refresh its rotated SDF data
+    void match(ParticleStore *estimates);
+
+    // Project against the fit found by the last match, adding the corrections to ep into deltas
+    // instead of estimates->ep. Leaves the body alone, so rigid contacts on other threads can read
+    // it at the same time.
+    void project(ParticleStore *estimates, int *counts, glm::dvec2 *deltas);
+    void draw(ParticleStore *particles);
 
-    glm::dvec2 guess(int idx);
+    double evaluate(ParticleStore *estimates);
+    glm::dvec2 gradient(ParticleStore *estimates, int respect);
+    void updateCounts(int *counts);
+    void getStencil(std::vector<int> *out);
 
 private:
     Body *body;
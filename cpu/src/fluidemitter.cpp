@@ -8,19 +8,27 @@ FluidEmitter::FluidEmitter(glm::dvec2 posn, double particlesPerSec, TotalFluidCo
 FluidEmitter::~FluidEmitter() {
 }
 
-void FluidEmitter::tick(QList<Particle *> *estimates, double secs) {
+void FluidEmitter::restore(double secs, double totalSecs) {
+    timer = secs;
+    totalTimer = totalSecs;
+}
+
+void FluidEmitter::tick(ParticleStore *estimates, double secs) {
+    // Frozen particles leave the fluid together once the whole list has been checked
+    m_frozen.clear();
     for (int i = m_fs->ps.size() - 1; i >= 0; i--) {
-        Particle *p = estimates->at(m_fs->ps.at(i));
+        int idx = m_fs->ps.at(i);
         // std::cout << p << std::endl;
         // double lambda = m_fs->lambdas[i];
         // std::cout << lambda << std::endl;
         // if(lambda >= -.1 && glm::length(p->v) < .05 && glm::length(p->p - p->ep) < .05) {
         // if(p->p.y >= 10 || fabs(p->p.x) >= 10 ) {
-        if (glm::length(p->v) < .06 && p->p.y <= 5) {
-            if (m_fs->lambdas[i] <= 0) {
-                p->t -= 1;
-                if (p->t <= 0) {
-                    p->t = 0;
+        if (glm::length(estimates->v[idx]) < .06 && estimates->p[idx].y <= 5) {
+            // Lambdas are stored by global particle index, not by position in ps
+            if (m_fs->lambdas[idx] <= 0) {
+                estimates->t[idx] -= 1;
+                if (estimates->t[idx] <= 0) {
+                    estimates->t[idx] = 0;
 
                     // p->ph = SOLID;
                     // Particle *newP = new Particle(p->p, 0, SOLID);
@@ -28,30 +36,35 @@ void FluidEmitter::tick(QList<Particle *> *estimates, double secs) {
                     // p->imass -= secs;
                     // if(p->imass == 0)
 
-                    p->imass = 0;
-                    p->ph = SOLID;
-                    p->ep = p->p;
-                    p->v = glm::dvec2();
-                    p->f = glm::dvec2();
+                    estimates->imass[idx] = 0;
+                    estimates->ph[idx] = SOLID;
+
+                    // The fluid's body number isn't a rigid body, so don't let contacts look it up as one
+                    estimates->bod[idx] = -1;
+                    estimates->ep[idx] = estimates->p[idx];
+                    estimates->v[idx] = glm::dvec2();
+                    estimates->f[idx] = glm::dvec2();
                     // grains.append(newP);
                     // estimates->append(newP);
                     // estimates->removeAt(m_fs->ps.at(i));
                     // if(m_fs->ps.contains(i))
-                    m_fs->removeParticle(i);
+                    m_frozen.push_back(i);
                     // delete p;
                     // p->imass = 1;
                     // p->ph = SOLID;
                     // m_fs->ps.removeAt(i);
                 }
             } else {
-                p->t += secs;
-                if (p->t > 3)
-                    p->t = 3;
+                estimates->t[idx] += secs;
+                if (estimates->t[idx] > 3)
+                    estimates->t[idx] = 3;
             }
             // }
         }
     }
 
+    m_fs->removeParticles(&m_frozen);
+
     // for(int i=0; i<grains.size(); i++) {
     //     Particle *p = grains.at(i);
     //     if(glm::length(p->v) <= .02) {
@@ -65,13 +78,16 @@ void FluidEmitter::tick(QList<Particle *> *estimates, double secs) {
 
     timer += secs;
     totalTimer += secs;
+    int first = estimates->size();
     while (totalTimer < 5 && timer >= 1. / m_particlesPerSec) {
         timer -= 1. / m_particlesPerSec;
         if (m_fs != NULL) {
-            Particle *p = new Particle(m_posn, 1, FLUID);
-            p->v = glm::dvec2(frand(), 1);
-            m_fs->addParticle(estimates->size());
+            Particle p(m_posn, 1, FLUID);
+            p.v = glm::dvec2(frand(), 1);
             estimates->append(p);
         }
     }
+    if (m_fs != NULL) {
+        m_fs->addParticles(first, estimates->size() - first);
+    }
 }
@@ -2,7 +2,7 @@
 #define FLUIDEMITTER_H
 
 #include "includes.h"
-#include "particle.h"
+#include "particlestore.h"
 #include "totalfluidconstraint.h"
 
 #define H 2.
@@ -14,9 +14,16 @@ class FluidEmitter {
 public:
     FluidEmitter(glm::dvec2 posn, double particlesPerSec, TotalFluidConstraint *fs);
     virtual ~FluidEmitter();
-    void tick(QList<Particle *> *estimates, double secs);
+    void tick(ParticleStore *estimates, double secs);
     QList<Particle *> *getParticles();
     inline glm::dvec2 getPosn() { return m_posn; }
+    inline double getParticlesPerSec() { return m_particlesPerSec; }
+    inline double getTimer() { return timer; }
+    inline double getTotalTimer() { return totalTimer; }
+    inline TotalFluidConstraint *getFluid() { return m_fs; }
+
+    // Pick up where a saved emitter left off
+    void restore(double secs, double totalSecs);
 
 private:
     glm::dvec2 m_posn;
@@ -25,6 +32,7 @@ private:
     double totalTimer;
     TotalFluidConstraint *m_fs;
     QList<Particle *> grains;
+    std::vector<int> m_frozen; // positions in the fluid of particles frozen this tick
 };
 
 #endif // FLUIDEMITTER_H
@@ -0,0 +1,81 @@
+#include "framearena.h"
+
+FrameArena::FrameArena(size_t blockSize)
+    : m_blockSize(blockSize), m_current(-1), m_offset(0) {
+}
+
+FrameArena::~FrameArena() {
+    release();
+}
+
+void *FrameArena::allocate(size_t size, size_t align) {
+    size_t start = 0;
+    if (m_current >= 0) {
+        start = (m_offset + align - 1) & ~(align - 1);
+    }
+
+    // Move on to the next block if this one is out of room
+    if (m_current < 0 || start + size > m_blockSizes[m_current]) {
+        nextBlock(size + align);
+        start = (m_offset + align - 1) & ~(align - 1);
+    }
+
+    // Blocks come from new[], so offsets are aligned whenever the block is
+    void *out = m_blocks[m_current] + start;
+    m_stats.bytesUsed += start + size - m_offset;
+    m_offset = start + size;
+
+    m_stats.numAllocations++;
+    if (m_stats.bytesUsed > m_stats.peakBytesUsed) {
+        m_stats.peakBytesUsed = m_stats.bytesUsed;
+    }
+    return out;
+}
+
+void FrameArena::nextBlock(size_t size) {
+    m_current++;
+    m_offset = 0;
+
+    // Reuse a block left over from an earlier frame if it is big enough
+    while (m_current < (int)m_blocks.size() && m_blockSizes[m_current] < size) {
+        m_current++;
+    }
+    if (m_current < (int)m_blocks.size()) {
+        return;
+    }
+
+    size_t blockSize = size > m_blockSize ? size : m_blockSize;
+    m_blocks.push_back(new char[blockSize]);
+    m_blockSizes.push_back(blockSize);
+    m_current = m_blocks.size() - 1;
+
+    m_stats.bytesReserved += blockSize;
+    m_stats.numBlocks++;
+}
+
+void FrameArena::reset() {
+    m_current = m_blocks.empty() ? -1 : 0;
+    m_offset = 0;
+
+    // Keep the frame's totals around, reset is usually the last thing a tick does
+    m_stats.lastAllocations = m_stats.numAllocations;
+    m_stats.lastBytesUsed = m_stats.bytesUsed;
+    m_stats.numAllocations = 0;
+    m_stats.bytesUsed = 0;
+    m_stats.numResets++;
+}
+
+void FrameArena::release() {
+    for (unsigned int i = 0; i < m_blocks.size(); i++) {
+        delete[] m_blocks[i];
+    }
+    m_blocks.clear();
+    m_blockSizes.clear();
+    m_current = -1;
+    m_offset = 0;
+
+    m_stats.numAllocations = 0;
+    m_stats.bytesUsed = 0;
+    m_stats.bytesReserved = 0;
+    m_stats.numBlocks = 0;
+}
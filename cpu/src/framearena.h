@@ -0,0 +1,66 @@
+#ifndef FRAMEARENA_H
+#define FRAMEARENA_H
+
+#include <new>
+#include <stddef.h>
+#include <vector>
+
+// Size of each block of memory the arena grabs from the heap
+#define ARENA_BLOCK_SIZE (64 * 1024)
+
+// Running totals for a FrameArena, mostly for debugging and tuning
+struct ArenaStats {
+    ArenaStats()
+        : numAllocations(0), bytesUsed(0), lastAllocations(0), lastBytesUsed(0), peakBytesUsed(0), bytesReserved(0),
+          numBlocks(0), numResets(0) {}
+
+    int numAllocations;   // objects handed out since the last reset
+    size_t bytesUsed;     // bytes handed out since the last reset, including alignment padding
+    int lastAllocations;  // objects handed out in the frame ended by the last reset
+    size_t lastBytesUsed; // bytes handed out in the frame ended by the last reset
+    size_t peakBytesUsed; // most bytes ever in use at once
+    size_t bytesReserved; // bytes held from the heap across all blocks
+    int numBlocks;        // blocks held from the heap
+    int numResets;        // frames the arena has been through
+};
+
+// Bump allocator for objects that only live for a single tick, like the contact and
+// boundary constraints found every frame. Objects are carved out of large blocks that
+// are kept around between frames, so after the first few ticks no heap allocation
+// happens at all. reset() throws every object away at once; destructors are NOT run,
+// so only objects that own no other resources should be created here.
+class FrameArena {
+public:
+    FrameArena(size_t blockSize = ARENA_BLOCK_SIZE);
+    virtual ~FrameArena();
+
+    // Raw memory aligned to align bytes, valid until the next reset
+    void *allocate(size_t size, size_t align);
+
+    // Construct an object in the arena
+    template <typename T, typename... Args>
+    T *create(Args... args) {
+        return new (allocate(sizeof(T), alignof(T))) T(args...);
+    }
+
+    // Forget everything allocated this frame, keeping the blocks for reuse
+    void reset();
+
+    // Give all blocks back to the heap
+    void release();
+
+    inline const ArenaStats &getStats() const { return m_stats; }
+
+private:
+    void nextBlock(size_t size);
+
+    size_t m_blockSize;
+    std::vector<char *> m_blocks;
+    std::vector<size_t> m_blockSizes;
+    int m_current;
+    size_t m_offset;
+
+    ArenaStats m_stats;
+};
+
+#endif // FRAMEARENA_H
@@ -6,11 +6,14 @@
 // Standard includes
 #include <iostream>
 #include <stdlib.h>
+#include <vector>
 
-// GL includes
+// GL includes, left out of headless builds that never draw
+#ifndef HEADLESS
 #define GL_GLEXT_PROTOTYPES
 #include <GL/glu.h>
 #include <qgl.h>
+#endif
 
 // GLM includes
 #include <glm.hpp>
@@ -0,0 +1,213 @@
+#include "islands.h"
+
+#include <algorithm>
+
+Islands::Islands()
+    : m_numAsleep(0), m_numSleepingIslands(0), m_numAwakeIslands(0) {
+}
+
+Islands::~Islands() {
+}
+
+void Islands::clear() {
+    m_islands.clear();
+    m_rest.clear();
+    m_members.clear();
+    m_free.clear();
+    m_queued.clear();
+    m_numAsleep = 0;
+    m_numSleepingIslands = 0;
+    m_numAwakeIslands = 0;
+}
+
+void Islands::resize(int numParticles) {
+    m_islands.resize(numParticles, -1);
+    m_rest.resize(numParticles, 0.);
+}
+
+inline int Islands::find(int i) {
+    while (m_parent[i] != i) {
+        m_parent[i] = m_parent[m_parent[i]];
+        i = m_parent[i];
+    }
+    return i;
+}
+
+inline void Islands::unite(int i, int j) {
+    i = find(i);
+    j = find(j);
+    if (i != j) {
+        m_parent[std::max(i, j)] = std::min(i, j);
+    }
+}
+
+void Islands::update(ParticleStore *particles, const QList<Body *> &bodies, const std::vector<glm::ivec2> &touching,
+                     const ConstraintBatches &standard, double seconds) {
+    int n = particles->size();
+    resize(n);
+
+    // Only awake particles that can move take part, static ones don't join the islands they touch
+    m_parent.resize(n);
+    for (int i = 0; i < n; i++) {
+        m_parent[i] = i;
+    }
+    auto moving = [this, particles](int i) { return particles->imass[i] != 0 && m_islands[i] < 0; };
+
+    for (int b = 0; b < bodies.size(); b++) {
+        const std::vector<int> &ps = bodies[b]->particles;
+        if (ps.empty() || !moving(ps[0])) {
+            continue;
+        }
+        for (unsigned int k = 1; k < ps.size(); k++) {
+            unite(ps[0], ps[k]);
+        }
+    }
+    for (unsigned int c = 0; c < touching.size(); c++) {
+        if (moving(touching[c].x) && moving(touching[c].y)) {
+            unite(touching[c].x, touching[c].y);
+        }
+    }
+    for (int c = 0; c < standard.distances.size(); c++) {
+        int a = standard.distances.at(c)->getFirst(), b = standard.distances.at(c)->getSecond();
+        if (moving(a) && moving(b)) {
+            unite(a, b);
+        }
+    }
+
+    // Gather the mass, twice the kinetic energy and the mass weighted rest of each island at its root
+    m_mass.assign(n, 0.);
+    m_energy.assign(n, 0.);
+    m_rested.assign(n, 0.);
+    m_restless.assign(n, 0);
+    m_newIslands.assign(n, -1);
+    for (int c = 0; c < standard.distances.size(); c++) {
+        int a = standard.distances.at(c)->getFirst(), b = standard.distances.at(c)->getSecond();
+        if (moving(a)) {
+            m_restless[find(a)] = 1;
+        }
+        if (moving(b)) {
+            m_restless[find(b)] = 1;
+        }
+    }
+    for (int i = 0; i < n; i++) {
+        if (!moving(i)) {
+            continue;
+        }
+        int r = find(i);
+        if (particles->ph[i] != SOLID) {
+            m_restless[r] = 1;
+        }
+        m_mass[r] += 1. / particles->imass[i];
+        m_energy[r] += glm::dot(particles->v[i], particles->v[i]) / particles->imass[i];
+        m_rested[r] += m_rest[i] / particles->imass[i];
+    }
+
+    // Islands whose mean square speed stayed under the limit rest a little longer, the rest start
+    // over. Going by means lets a settled pile sleep while a few grains at its surface still
+    // rattle, and keeps one of them bouncing back into the pile from restarting its timer, while
+    // anything heavy landing on an island holds it back. Islands that have rested long enough go
+    // to sleep where they are.
+    m_numAwakeIslands = 0;
+    for (int i = 0; i < n; i++) {
+        if (!moving(i)) {
+            continue;
+        }
+        int r = find(i);
+        if (m_restless[r] || m_energy[r] >= SLEEP_SPEED * SLEEP_SPEED * m_mass[r]) {
+            m_rest[i] = 0;
+            m_numAwakeIslands += (r == i);
+            continue;
+        }
+        m_rest[i] = m_rested[r] / m_mass[r] + seconds;
+        if (m_rest[i] < SLEEP_SECONDS) {
+            m_numAwakeIslands += (r == i);
+            continue;
+        }
+
+        if (m_newIslands[r] < 0) {
+            m_newIslands[r] = newIsland();
+        }
+        m_islands[i] = m_newIslands[r];
+        m_members[m_islands[i]].push_back(i);
+        particles->v[i] = glm::dvec2();
+        m_numAsleep++;
+    }
+}
+
+void Islands::queueWake(int i) {
+    m_queued.push_back(m_islands[i]);
+}
+
+int Islands::wakeQueued(std::vector<int> *woken) {
+    int numWoken = 0;
+    for (unsigned int q = 0; q < m_queued.size(); q++) {
+        // An island touched by several particles is queued more than once
+        const std::vector<int> &members = m_members[m_queued[q]];
+        if (!members.empty()) {
+            numWoken += members.size();
+            if (woken != NULL) {
+                woken->insert(woken->end(), members.begin(), members.end());
+            }
+            wake(m_queued[q]);
+        }
+    }
+    m_queued.clear();
+    return numWoken;
+}
+
+void Islands::wakeAll() {
+    for (unsigned int s = 0; s < m_members.size(); s++) {
+        if (!m_members[s].empty()) {
+            wake(s);
+        }
+    }
+    m_queued.clear();
+}
+
+void Islands::wake(int island) {
+    std::vector<int> &members = m_members[island];
+    for (unsigned int k = 0; k < members.size(); k++) {
+        m_islands[members[k]] = -1;
+        m_rest[members[k]] = 0;
+    }
+    m_numAsleep -= members.size();
+    m_numSleepingIslands--;
+    members.clear();
+    m_free.push_back(island);
+}
+
+int Islands::newIsland() {
+    m_numSleepingIslands++;
+    if (!m_free.empty()) {
+        int island = m_free.back();
+        m_free.pop_back();
+        return island;
+    }
+    m_members.push_back(std::vector<int>());
+    return m_members.size() - 1;
+}
+
+void Islands::restore(const int32_t *islands, const double *rest, int numParticles) {
+    clear();
+    m_islands.assign(islands, islands + numParticles);
+    m_rest.assign(rest, rest + numParticles);
+
+    int numIslands = 0;
+    for (int i = 0; i < numParticles; i++) {
+        numIslands = std::max(numIslands, m_islands[i] + 1);
+    }
+    m_members.resize(numIslands);
+    for (int i = 0; i < numParticles; i++) {
+        if (m_islands[i] >= 0) {
+            m_members[m_islands[i]].push_back(i);
+            m_numAsleep++;
+        }
+    }
+    for (int s = numIslands - 1; s >= 0; s--) {
+        if (m_members[s].empty()) {
+            m_free.push_back(s);
+        } else {
+            m_numSleepingIslands++;
+        }
+    }
+}
@@ -0,0 +1,90 @@
+#ifndef ISLANDS_H
+#define ISLANDS_H
+
+#include "constraintbatches.h"
+#include "particle.h"
+
+#include <stdint.h>
+#include <vector>
+
+// Root mean square speed an island has to stay under to count as resting
+#define SLEEP_SPEED .1
+
+// Seconds an island has to rest before it is put to sleep
+#define SLEEP_SECONDS .5
+
+// Gap up to which candidate pairs of the contact search still count as touching for joining
+// islands. Resting neighbors drift in and out of actual contact, and would otherwise split a
+// settled pile up from tick to tick.
+#define ISLAND_MARGIN (.1 * PARTICLE_DIAM)
+
+// Groups movable particles into islands, the connected components of the graph joining
+// particles of one rigid body and particles touching or tied together, and puts islands that have rested
+// long enough to sleep. Sleeping particles keep their positions with zero velocity and are
+// left out of prediction, contact detection and projection until something wakes them.
+// Fluids, gases and particles on distance constraints never settle for long, so islands
+// holding any of them stay awake.
+class Islands {
+public:
+    Islands();
+    virtual ~Islands();
+
+    // Wake everything and forget all islands
+    void clear();
+
+    // Cover particles appended since the last call, which start out awake
+    void resize(int numParticles);
+
+    inline bool isAsleep(int i) const { return m_islands[i] >= 0; }
+
+    // Rebuild the awake islands from the bodies, the pairs of particles found touching this tick
+    // and the distance constraints, advance the rest timer of each, and put those that rested
+    // long enough to sleep. Runs after velocities have been updated.
+    void update(ParticleStore *particles, const QList<Body *> &bodies, const std::vector<glm::ivec2> &touching,
+                const ConstraintBatches &standard, double seconds);
+
+    // Wake the island particle i sleeps in at the next call to wakeQueued, so which particles
+    // sleep doesn't change while contacts are still being found
+    void queueWake(int i);
+
+    // Wake every queued island, returning how many particles woke and appending them to woken if given
+    int wakeQueued(std::vector<int> *woken = NULL);
+
+    // Wake every island, e.g. when the user pokes all particles at once
+    void wakeAll();
+
+    // Sleeping particles, sleeping islands, and awake islands found by the last update
+    inline int getNumAsleep() const { return m_numAsleep; }
+    inline int getNumSleepingIslands() const { return m_numSleepingIslands; }
+    inline int getNumAwakeIslands() const { return m_numAwakeIslands; }
+
+    // Per particle state for snapshots: the sleeping island of each particle or -1, and how
+    // long each has been resting
+    inline const std::vector<int32_t> &getIslands() const { return m_islands; }
+    inline const std::vector<double> &getRestTimers() const { return m_rest; }
+    void restore(const int32_t *islands, const double *rest, int numParticles);
+
+private:
+    inline int find(int i);
+    inline void unite(int i, int j);
+    void wake(int island);
+    int newIsland();
+
+    std::vector<int32_t> m_islands; // sleeping island of each particle, -1 while awake
+    std::vector<double> m_rest;      // seconds each particle's island has been resting
+
+    // Particles of each sleeping island, with emptied islands kept for reuse
+    std::vector<std::vector<int>> m_members;
+    std::vector<int> m_free;
+    std::vector<int> m_queued;
+
+    // Union-find over the awake particles, and the state of each root's island
+    std::vector<int> m_parent;
+    std::vector<double> m_mass, m_energy, m_rested;
+    std::vector<char> m_restless;
+    std::vector<int> m_newIslands;
+
+    int m_numAsleep, m_numSleepingIslands, m_numAwakeIslands;
+};
+
+#endif // ISLANDS_H
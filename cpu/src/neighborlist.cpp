@@ -0,0 +1,75 @@
+#include "neighborlist.h"
+
+#include <algorithm>
+
+NeighborList::NeighborList(double kernelRadius, double skin)
+    : m_radius(kernelRadius + skin), m_skin(skin), m_numParticles(0), m_numBuilds(0), m_numListed(0),
+      m_maxNeighbors(0), m_needed(false),
+      m_grid(kernelRadius + skin) {
+}
+
+NeighborList::~NeighborList() {
+}
+
+void NeighborList::build(ParticleStore *particles) {
+    m_numParticles = m_numListed = m_maxNeighbors = 0;
+    m_offsets.assign(1, 0);
+    m_indices.clear();
+    m_builtPositions.clear();
+
+    // Nothing to do for scenes without fluids or gases
+    m_needed = false;
+    for (int i = 0; i < particles->size() && !m_needed; i++) {
+        m_needed = particles->ph[i] == FLUID || particles->ph[i] == GAS;
+    }
+    if (!m_needed) {
+        return;
+    }
+
+    m_grid.build(particles->ep);
+    m_numParticles = particles->size();
+    m_numBuilds++;
+    m_offsets.resize(m_numParticles + 1);
+    m_builtPositions.resize(m_numParticles);
+
+    double r2 = m_radius * m_radius;
+    for (int i = 0; i < m_numParticles; i++) {
+        const glm::dvec2 &pos = particles->ep[i];
+        int start = m_indices.size();
+        m_builtPositions[i] = pos;
+
+        if (particles->ph[i] == FLUID || particles->ph[i] == GAS) {
+            m_grid.forEachCandidate(pos, m_radius, [&](int j) {
+                glm::dvec2 r = pos - particles->ep[j];
+
+                // Fixed particles never take part in density estimates
+                if (j == i || (particles->imass[j] != 0 && glm::dot(r, r) < r2)) {
+                    m_indices.push_back(j);
+                }
+            });
+            std::sort(m_indices.begin() + start, m_indices.end());
+            m_numListed++;
+            m_maxNeighbors = std::max(m_maxNeighbors, (int)m_indices.size() - start);
+        }
+
+        m_offsets[i + 1] = m_indices.size();
+    }
+}
+
+bool NeighborList::refresh(ParticleStore *particles) {
+    if (particles->size() != m_numParticles && m_needed) {
+        build(particles);
+        return true;
+    }
+
+    // Two particles that each moved less than half the skin are still within the gathered radius
+    double limit = .25 * m_skin * m_skin;
+    for (int i = 0; i < m_numParticles; i++) {
+        glm::dvec2 moved = particles->ep[i] - m_builtPositions[i];
+        if (glm::dot(moved, moved) > limit) {
+            build(particles);
+            return true;
+        }
+    }
+    return false;
+}
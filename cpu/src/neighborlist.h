@@ -0,0 +1,49 @@
+#ifndef NEIGHBORLIST_H
+#define NEIGHBORLIST_H
+
+#include "spatialgrid.h"
+
+// Per-particle lists of nearby movable particles for the fluid and gas constraints,
+// built with a single grid query per particle instead of an all-pairs scan in every
+// constraint on every solver iteration. Lists are gathered with a radius a skin wider
+// than the kernel support, so they stay valid until some particle has moved more than
+// half the skin; consumers still cut off at the kernel radius themselves.
+class NeighborList {
+public:
+    NeighborList(double kernelRadius, double skin);
+    virtual ~NeighborList();
+
+    // Rebuild the lists for all fluid and gas particles from their predicted positions
+    void build(ParticleStore *particles);
+
+    // Rebuild only if particles were added or moved far enough to invalidate the lists
+    bool refresh(ParticleStore *particles);
+
+    // Neighbors of particle i in ascending index order, including i itself
+    inline int getNumNeighbors(int i) const {
+        return i < m_numParticles ? m_offsets[i + 1] - m_offsets[i] : 0;
+    }
+    inline const int *getNeighbors(int i) const { return m_indices.data() + m_offsets[i]; }
+
+    inline double getRadius() const { return m_radius; }
+    inline int getNumParticles() const { return m_numParticles; }
+    inline int getNumBuilds() const { return m_numBuilds; }
+
+    // Fluid and gas particles given a list by the last build, the total length of their lists,
+    // and the longest one
+    inline int getNumListed() const { return m_numListed; }
+    inline int getNumPairs() const { return m_indices.size(); }
+    inline int getMaxNeighbors() const { return m_maxNeighbors; }
+
+private:
+    double m_radius, m_skin;
+    int m_numParticles, m_numBuilds, m_numListed, m_maxNeighbors;
+    bool m_needed;
+
+    SpatialGrid m_grid;
+    std::vector<int> m_offsets; // list of particle i is m_indices[m_offsets[i]] to m_indices[m_offsets[i + 1]]
+    std::vector<int> m_indices;
+    std::vector<glm::dvec2> m_builtPositions;
+};
+
+#endif // NEIGHBORLIST_H
@@ -12,27 +12,46 @@ OpenSmokeEmitter::~OpenSmokeEmitter() {
     // }
 }
 
-void OpenSmokeEmitter::tick(QList<Particle *> *estimates, double secs) {
+void OpenSmokeEmitter::tick(ParticleStore *estimates, const SpatialGrid &grid, double secs, ThreadPool *pool) {
     timer += secs;
+    int first = estimates->size();
     while (timer >= 1. / m_particlesPerSec) {
         timer -= 1. / m_particlesPerSec;
         Particle *p = new Particle(m_posn, .1, GAS);
         m_particles.append(p);
         if (m_gs != NULL) {
-            p = new Particle(m_posn, 1, GAS);
-            m_gs->addParticle(p, estimates->size());
-            estimates->append(p);
+            estimates->append(Particle(m_posn, 1, GAS));
         }
     }
-    for (Particle *p : m_particles) {
+    if (m_gs != NULL) {
+        m_gs->addParticles(first, estimates->size() - first);
+    }
+
+    // Tracers only read the particles, so they can be moved in any order
+    if (pool == NULL) {
+        advect(estimates, grid, secs, 0, m_particles.size());
+    } else {
+        pool->parallelFor(m_particles.size(), [this, estimates, &grid, secs](int begin, int end) {
+            advect(estimates, grid, secs, begin, end);
+        });
+    }
+}
+
+void OpenSmokeEmitter::advect(ParticleStore *estimates, const SpatialGrid &grid, double secs, int begin, int end) {
+    for (int i = begin; i < end; i++) {
+        Particle *p = m_particles.at(i);
         if (p->ph == FLUID || p->ph == GAS) {
             p->v = glm::dvec2();
             double sum = 0;
-            for (Particle *n : *estimates) {
-                glm::dvec2 r = p->p - n->p;
+            auto gather = [this, estimates, p, &sum](int n) {
+                glm::dvec2 r = p->p - estimates->p[n];
                 double p6 = poly6(glm::dot(r, r));
-                p->v += n->v * p6;
+                p->v += estimates->v[n] * p6;
                 sum += p6;
+            };
+            grid.forEachCandidate(p->p, H, gather);
+            for (int n = grid.getNumParticles(); n < estimates->size(); n++) {
+                gather(n);
             }
 
             if (sum > 0)
@@ -41,6 +60,15 @@ void OpenSmokeEmitter::tick(QList<Particle *> *estimates, double secs) {
     }
 }
 
+void OpenSmokeEmitter::restore(double secs, const Particle *particles, int numParticles) {
+    timer = secs;
+    m_particles.clear();
+    m_particles.reserve(numParticles);
+    for (int i = 0; i < numParticles; i++) {
+        m_particles.append(new Particle(particles[i]));
+    }
+}
+
 QList<Particle *> *OpenSmokeEmitter::getParticles() {
     return &m_particles;
 }
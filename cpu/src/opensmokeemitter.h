@@ -3,7 +3,9 @@
 
 #include "gasconstraint.h"
 #include "includes.h"
-#include "particle.h"
+#include "particlestore.h"
+#include "spatialgrid.h"
+#include "threadpool.h"
 
 #define H 2.
 #define H2 4.
@@ -14,11 +16,23 @@ class OpenSmokeEmitter {
 public:
     OpenSmokeEmitter(glm::dvec2 posn, double particlesPerSec, GasConstraint *gs);
     virtual ~OpenSmokeEmitter();
-    void tick(QList<Particle *> *estimates, double secs);
+
+    // Emit new tracers and carry every tracer along with the poly6 weighted velocity of the
+    // particles around it. grid has to hold the current positions of estimates with a cell size
+    // of at least H, particles appended since it was built are checked one by one. Tracers are
+    // split across pool's threads unless it is NULL.
+    void tick(ParticleStore *estimates, const SpatialGrid &grid, double secs, ThreadPool *pool = NULL);
     QList<Particle *> *getParticles();
     inline glm::dvec2 getPosn() { return m_posn; }
+    inline double getParticlesPerSec() { return m_particlesPerSec; }
+    inline double getTimer() { return timer; }
+    inline GasConstraint *getGas() { return m_gs; }
+
+    // Pick up where a saved emitter left off, with copies of its tracer particles
+    void restore(double secs, const Particle *particles, int numParticles);
 
 private:
+    void advect(ParticleStore *estimates, const SpatialGrid &grid, double secs, int begin, int end);
     double poly6(double r2);
     glm::dvec2 spikyGrad(const glm::dvec2 &r, double rlen2);
 
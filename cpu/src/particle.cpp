@@ -1,70 +1,56 @@
 #include "particle.h"
+#include "particlestore.h"
 
-SDFData Particle::getSDFData(QList<Body *> *bodies, int idx) {
-    if (ph != SOLID || bod < 0) {
-        return SDFData();
-    }
-
-    Body *body = bodies->at(bod);
-    SDFData out = body->sdf[idx];
-    out.rotate(body->angle);
-    return out;
+void Body::setAngle(double a) {
+    angle = a;
+    rotation = glm::dvec2(cos(a), sin(a));
+    rotateSDF();
 }
 
-void Body::updateCOM(QList<Particle *> *estimates, bool useEstimates) {
-    // Recompute center of mass
+void Body::updateCOM(ParticleStore *estimates, bool useEstimates) {
+    const std::vector<glm::dvec2> &positions = useEstimates ? estimates->ep : estimates->p;
+
+    // Recompute center of mass and the shape matching matrix Apq = sum m (x - c) q^T together.
+    // The r vectors sum to zero when weighted by mass, so sum m x q^T is the same matrix
+    // without needing c first. There are no r vectors yet while the body is being created.
     glm::dvec2 total;
-    for (int i = 0; i < particles.size(); i++) {
-        Particle *p = estimates->at(particles[i]);
-        total += (useEstimates ? p->ep : p->p) / p->imass;
+    double a00 = 0, a01 = 0, a10 = 0, a11 = 0;
+    bool shaped = rs.size() == particles.size();
+    for (unsigned int k = 0; k < particles.size(); k++) {
+        int index = particles[k];
+        double m = 1. / estimates->imass[index];
+        glm::dvec2 x = positions[index] * m;
+        total += x;
+        if (shaped) {
+            const glm::dvec2 &q = rs[k];
+            a00 += x.x * q.x;
+            a01 += x.x * q.y;
+            a10 += x.y * q.x;
+            a11 += x.y * q.y;
+        }
     }
     center = total * imass;
 
-    // Recompute angle delta guess
-    angle = 0.0;
-    double prev = 0.0;
-    for (int i = 0; i < particles.size(); i++) {
-        int index = particles[i];
-        glm::dvec2 q = rs[index];
-        if (glm::dot(q, q) == 0) {
-            continue;
-        }
-        Particle *p = estimates->at(index);
-        glm::dvec2 r = p->ep - center;
-
-        double cos = r.x * q.x + r.y * q.y,
-               sin = r.y * q.x - r.x * q.y,
-               next = atan2(sin, cos);
-
-        // Ensure all guesses are close to each other
-        if (i > 0) {
-            if (prev - next >= M_PI) {
-                next += 2 * M_PI;
-            }
-        } else {
-            if (next < 0) {
-                next += 2 * M_PI;
-            }
-        }
-
-        prev = next;
-        next /= p->imass;
-        angle += next;
+    // Rotation part of the polar decomposition of Apq. For a 2x2 matrix it's the rotation whose
+    // cosine and sine are proportional to the trace and to a10 - a01. A body squashed flat
+    // leaves both zero, in which case it keeps its last rotation.
+    double c = a00 + a11, s = a10 - a01, length = sqrt(c * c + s * s);
+    if (length > 0) {
+        rotation = glm::dvec2(c, s) / length;
+        angle = atan2(s, c);
     }
-    angle *= imass;
 }
 
-void Body::computeRs(QList<Particle *> *estimates) {
-    imass = 0.0;
-    for (int i = 0; i < particles.size(); i++) {
-        int idx = particles[i];
-        Particle *p = estimates->at(idx);
-        glm::dvec2 r = p->p - center;
-        rs[idx] = r;
+void Body::computeRs(ParticleStore *estimates) {
+    rs.resize(particles.size());
+    for (unsigned int k = 0; k < particles.size(); k++) {
+        rs[k] = estimates->p[particles[k]] - center;
+    }
+}
 
-        if (glm::dot(r, r) != 0) {
-            imass += (1.0 / p->imass);
-        }
+void Body::rotateSDF() {
+    frame.resize(sdf.size());
+    for (unsigned int k = 0; k < sdf.size(); k++) {
+        rotateSDF(k);
     }
-    imass = 1.0 / imass;
 }
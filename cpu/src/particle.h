@@ -16,8 +16,9 @@ enum Phase {
 
 struct Body;
 struct SDFData;
+class ParticleStore;
 
-// Individual particle representation
+// Individual particle description, copied into a ParticleStore when added to the simulation
 struct Particle {
     glm::dvec2 p, ep, v, f;                       // position, guess position, and velocity
     double imass, tmass, sFriction, kFriction, t; // inverse mass, temporary height-scaled mass, coeffs of friction
@@ -51,31 +52,6 @@ struct Particle {
     }
 
     inline void setStatic() { imass = 0.; }
-
-    inline glm::dvec2 guess(double seconds) {
-        return imass == 0. ? p : p + seconds * v;
-    }
-
-    inline void confirmGuess() {
-        if (glm::length(ep - p) < EPSILON) {
-            v = glm::dvec2(0, 0);
-            return;
-        }
-        p = ep;
-    }
-
-    void scaleMass() {
-        if (imass != 0.0) {
-            tmass = 1. / ((1. / imass) * exp(-p.y));
-        } else {
-            tmass = 0.0;
-        }
-    }
-
-    // Used for stabilization-related constraints
-    inline glm::dvec2 getP(bool stable) { return stable ? p : ep; }
-
-    SDFData getSDFData(QList<Body *> *bodies, int idx);
 };
 
 // Signed distance field data for rigid-body collisions
@@ -88,6 +64,11 @@ struct SDFData {
 
     inline void rotate(double angle) { gradient = glm::rotate(gradient, angle); }
 
+    // Rotate by the angle with the given cosine and sine
+    inline void rotate(const glm::dvec2 &cs) {
+        gradient = glm::dvec2(cs.x * gradient.x - cs.y * gradient.y, cs.y * gradient.x + cs.x * gradient.y);
+    }
+
     glm::dvec2 gradient;
     double distance;
 };
@@ -107,32 +88,63 @@ public:
     Constraint() : stiffness(1) {}
     virtual ~Constraint() {}
 
-    virtual void draw(QList<Particle *> *particles) = 0;
+    virtual void draw(ParticleStore *particles) = 0;
 
     // For iterative solving of constraints
-    virtual void project(QList<Particle *> *estimates, int *counts) = 0;
+    virtual void project(ParticleStore *estimates, int *counts) = 0;
 
     // For matrix-oriented solving of constraints
-    virtual double evaluate(QList<Particle *> *estimates) = 0;
-    virtual glm::dvec2 gradient(QList<Particle *> *estimates, int respect) = 0;
+    virtual double evaluate(ParticleStore *estimates) = 0;
+    virtual glm::dvec2 gradient(ParticleStore *estimates, int respect) = 0;
     virtual void updateCounts(int *counts) = 0;
 
+    // Append the particles gradient() can be nonzero for, so the Jacobian only visits those
+    virtual void getStencil(std::vector<int> *out) = 0;
+
 protected:
     double stiffness;
 };
 
-// A single rigid body
+// A single rigid body. Its particles sit at consecutive indices in the store, and the k-th
+// of them has its rest offset in rs[k] and its SDF data in sdf[k].
 struct Body {
+    Body()
+        : shape(NULL), rotation(1, 0), imass(0), angle(0) {}
     virtual ~Body() { delete shape; }
-    QList<int> particles;      // index into global particles list
-    QHash<int, glm::dvec2> rs; // map from global particles index to r vector
-    QHash<int, SDFData> sdf;   // map from global particles index to SDF data
+    std::vector<int> particles;  // index into global particles list
+    std::vector<glm::dvec2> rs;  // r vector of each particle, from the center of mass at rest
+    std::vector<SDFData> sdf;    // unrotated SDF data of each particle
+    std::vector<SDFData> frame;  // SDF data rotated by angle, shared by all of the body's contacts
     Constraint *shape;
     glm::dvec2 center;   // center of mass
+    glm::dvec2 rotation; // cosine and sine of angle
     double imass, angle; // total inverse mass
 
-    void updateCOM(QList<Particle *> *estimates, bool useEstimates = true);
-    void computeRs(QList<Particle *> *estimates);
+    // Where the k-th particle belongs with the body's current center and rotation
+    inline glm::dvec2 guess(int k) const {
+        const glm::dvec2 &q = rs[k];
+        return center + glm::dvec2(rotation.x * q.x - rotation.y * q.y, rotation.y * q.x + rotation.x * q.y);
+    }
+
+    // Position of global particle idx among the body's particles
+    inline int getLocalIndex(int idx) const { return idx - particles[0]; }
+
+    // Set the rotation, along with the rotated SDF data
+    void setAngle(double a);
+
+    // Find the center and rotation that best fit the current positions. The rotated SDF data is
+    // left to the shape constraint, which refreshes it as it visits each particle anyway.
+    void updateCOM(ParticleStore *estimates, bool useEstimates = true);
+
+    void computeRs(ParticleStore *estimates);
+    void rotateSDF();
+
+    // Refresh the k-th particle's rotated SDF data alone
+    inline void rotateSDF(int k) {
+        const glm::dvec2 &g = sdf[k].gradient;
+        frame[k].gradient = glm::dvec2(rotation.x * g.x - rotation.y * g.y, rotation.y * g.x + rotation.x * g.y);
+        frame[k].distance = sdf[k].distance;
+    }
 };
 
 #endif // PARTICLE_H
@@ -0,0 +1,66 @@
+#include "particlestore.h"
+
+ParticleStore::ParticleStore() {
+}
+
+ParticleStore::~ParticleStore() {
+}
+
+int ParticleStore::append(const Particle &part) {
+    p.push_back(part.p);
+    ep.push_back(part.ep);
+    v.push_back(part.v);
+    f.push_back(part.f);
+    imass.push_back(part.imass);
+    tmass.push_back(part.tmass);
+    sFriction.push_back(part.sFriction);
+    kFriction.push_back(part.kFriction);
+    t.push_back(part.t);
+    bod.push_back(part.bod);
+    ph.push_back(part.ph);
+    return p.size() - 1;
+}
+
+void ParticleStore::reserve(int n) {
+    p.reserve(n);
+    ep.reserve(n);
+    v.reserve(n);
+    f.reserve(n);
+    imass.reserve(n);
+    tmass.reserve(n);
+    sFriction.reserve(n);
+    kFriction.reserve(n);
+    t.reserve(n);
+    bod.reserve(n);
+    ph.reserve(n);
+}
+
+void ParticleStore::clear() {
+    p.clear();
+    ep.clear();
+    v.clear();
+    f.clear();
+    imass.clear();
+    tmass.clear();
+    sFriction.clear();
+    kFriction.clear();
+    t.clear();
+    bod.clear();
+    ph.clear();
+}
+
+Particle ParticleStore::get(int i) const {
+    Particle part;
+    part.p = p[i];
+    part.ep = ep[i];
+    part.v = v[i];
+    part.f = f[i];
+    part.imass = imass[i];
+    part.tmass = tmass[i];
+    part.sFriction = sFriction[i];
+    part.kFriction = kFriction[i];
+    part.t = t[i];
+    part.bod = bod[i];
+    part.ph = ph[i];
+    return part;
+}
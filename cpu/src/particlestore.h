@@ -0,0 +1,69 @@
+#ifndef PARTICLESTORE_H
+#define PARTICLESTORE_H
+
+#include "particle.h"
+
+#include <vector>
+
+// Structure-of-arrays storage for every simulated particle. Each attribute of the
+// Particle struct lives in its own contiguous array, so loops touching only
+// positions or masses stream linearly through memory. Particles are referred to
+// by index everywhere; Particle itself is only used to describe new particles.
+class ParticleStore {
+public:
+    ParticleStore();
+    virtual ~ParticleStore();
+
+    std::vector<glm::dvec2> p, ep, v, f;        // position, guess position, velocity, and force
+    std::vector<double> imass, tmass;           // inverse mass, temporary height-scaled mass
+    std::vector<double> sFriction, kFriction, t; // coeffs of friction, and emitter timers
+    std::vector<int> bod;                       // body (if any) each particle belongs to
+    std::vector<Phase> ph;                      // phase of each particle
+
+    inline int size() const { return p.size(); }
+
+    // Add a particle to the end of the store, returning its index
+    int append(const Particle &part);
+    void reserve(int n);
+    void clear();
+
+    // Copy a particle back out of the store
+    Particle get(int i) const;
+
+    inline void setStatic(int i) { imass[i] = 0.; }
+
+    inline glm::dvec2 guess(int i, double seconds) const {
+        return imass[i] == 0. ? p[i] : p[i] + seconds * v[i];
+    }
+
+    inline void confirmGuess(int i) {
+        if (glm::length(ep[i] - p[i]) < EPSILON) {
+            v[i] = glm::dvec2(0, 0);
+            return;
+        }
+        p[i] = ep[i];
+    }
+
+    inline void scaleMass(int i) {
+        if (imass[i] != 0.0) {
+            tmass[i] = 1. / ((1. / imass[i]) * exp(-p[i].y));
+        } else {
+            tmass[i] = 0.0;
+        }
+    }
+
+    // Used for stabilization-related constraints
+    inline glm::dvec2 getP(int i, bool stable) const { return stable ? p[i] : ep[i]; }
+
+    // SDF data of particle i in its body's current frame, straight from the body's table. Anything
+    // not part of a rigid body gets a negative distance.
+    inline SDFData getSDFData(QList<Body *> *bodies, int i) const {
+        if (ph[i] != SOLID || bod[i] < 0) {
+            return SDFData();
+        }
+        const Body *body = bodies->at(bod[i]);
+        return body->frame[body->getLocalIndex(i)];
+    }
+};
+
+#endif // PARTICLESTORE_H
@@ -0,0 +1,321 @@
+#include "scenefile.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+SceneFile::SceneFile()
+    : xBoundaries(-20, 20), yBoundaries(0, 1000000), gravity(0, -9.8), m_numParticles(0) {
+}
+
+SceneFile::~SceneFile() {
+}
+
+// Fresh item with every optional field at its default
+static SceneItem makeItem(SceneItemType type) {
+    SceneItem item;
+    item.type = type;
+    item.start = item.end = item.velocity = glm::dvec2();
+    item.spacing = item.mass = item.jitter = item.density = item.friction = item.rate = 0;
+    item.shape = item.first = item.second = -1;
+    item.open = item.pinEnd = false;
+    return item;
+}
+
+// Box shaped rigid body, with the SDF of each particle pointing out of the nearest side
+static SceneShape makeBox(const std::string &name, int cols, int rows) {
+    SceneShape shape;
+    shape.name = name;
+    for (int x = 0; x < cols; x++) {
+        for (int y = 0; y < rows; y++) {
+            shape.offsets.push_back(glm::dvec2(x - (cols - 1) / 2., y - (rows - 1) / 2.) * PARTICLE_DIAM);
+
+            glm::dvec2 side((x == 0) ? -1 : (x == cols - 1) ? 1 : 0, (y == 0) ? -1 : (y == rows - 1) ? 1 : 0);
+            if (side != glm::dvec2()) {
+                shape.sdf.push_back(SDFData(glm::normalize(side), PARTICLE_RAD * glm::length(side)));
+                continue;
+            }
+
+            // Interior particles are pushed out through the closest side
+            int dx = std::min(x, cols - 1 - x), dy = std::min(y, rows - 1 - y);
+            if (dx <= dy) {
+                side = glm::dvec2(x < cols - 1 - x ? -1 : 1, 0);
+            } else {
+                side = glm::dvec2(0, y < rows - 1 - y ? -1 : 1);
+            }
+            shape.sdf.push_back(SDFData(side, PARTICLE_RAD + std::min(dx, dy) * PARTICLE_DIAM));
+        }
+    }
+    return shape;
+}
+
+bool SceneFile::load(const char *path) {
+    std::ifstream in(path);
+    if (!in) {
+        cout << "Could not open scene " << path << "." << endl;
+        return false;
+    }
+
+    shapes.clear();
+    items.clear();
+    m_numParticles = 0;
+
+    std::string line, error;
+    int lineNumber = 0;
+    while (std::getline(in, line)) {
+        lineNumber++;
+        if (!parseLine(line, in, &lineNumber, &error)) {
+            cout << path << ":" << lineNumber << ": " << error << endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool SceneFile::parseLine(const std::string &line, std::istream &in, int *lineNumber, std::string *error) {
+    std::istringstream words(line.substr(0, line.find('#')));
+    std::string command;
+    if (!(words >> command)) {
+        return true;
+    }
+
+    SceneItem item;
+
+    if (command == "boundaries") {
+        if (!(words >> xBoundaries.x >> xBoundaries.y >> yBoundaries.x >> yBoundaries.y)) {
+            *error = "expected boundaries XMIN XMAX YMIN YMAX";
+            return false;
+        }
+        return true;
+    } else if (command == "gravity") {
+        if (!(words >> gravity.x >> gravity.y)) {
+            *error = "expected gravity X Y";
+            return false;
+        }
+        return true;
+    } else if (command == "particle") {
+        item = makeItem(SCENE_PARTICLE);
+        if (!(words >> item.start.x >> item.start.y >> item.mass)) {
+            *error = "expected particle X Y MASS [VX VY]";
+            return false;
+        }
+        words >> item.velocity.x >> item.velocity.y;
+    } else if (command == "block" || command == "fluid" || command == "gas") {
+        item = makeItem(command == "block" ? SCENE_BLOCK : command == "fluid" ? SCENE_FLUID : SCENE_GAS);
+        if (item.type != SCENE_BLOCK && !(words >> item.density)) {
+            *error = "expected a density";
+            return false;
+        }
+        if (item.type != SCENE_BLOCK && item.density <= 0) {
+            *error = "density must be positive";
+            return false;
+        }
+        if (item.type == SCENE_GAS) {
+            std::string open;
+            words >> open;
+            if (open != "open" && open != "closed") {
+                *error = "expected gas to be open or closed";
+                return false;
+            }
+            item.open = open == "open";
+        }
+        if (!(words >> item.start.x >> item.start.y >> item.end.x >> item.end.y >> item.spacing >> item.mass)) {
+            *error = "expected " + command + " corners X0 Y0 X1 Y1, SPACING and MASS";
+            return false;
+        }
+        words >> item.jitter;
+        if (item.spacing <= 0) {
+            *error = "spacing must be positive";
+            return false;
+        }
+        if (item.type != SCENE_BLOCK && item.mass <= 0) {
+            *error = "fluids and gases cannot have particles of infinite mass";
+            return false;
+        }
+    } else if (command == "shape") {
+        SceneShape shape;
+        if (!(words >> shape.name)) {
+            *error = "expected shape NAME [COLS ROWS]";
+            return false;
+        }
+        if (findShape(shape.name) >= 0) {
+            *error = "shape " + shape.name + " is already defined";
+            return false;
+        }
+
+        int cols, rows;
+        if (words >> cols >> rows) {
+            if (cols < 2 || rows < 2) {
+                *error = "box shapes need at least 2 columns and 2 rows";
+                return false;
+            }
+            shapes.push_back(makeBox(shape.name, cols, rows));
+            return true;
+        }
+
+        // Explicit vertices up to the closing end
+        std::string vertexLine;
+        while (std::getline(in, vertexLine)) {
+            (*lineNumber)++;
+            std::istringstream vertex(vertexLine.substr(0, vertexLine.find('#')));
+            std::string word;
+            if (!(vertex >> word)) {
+                continue;
+            }
+            if (word == "end") {
+                if (shape.offsets.size() <= 1) {
+                    *error = "rigid bodies must be at least 2 points";
+                    return false;
+                }
+                shapes.push_back(shape);
+                return true;
+            }
+
+            glm::dvec2 offset, gradient;
+            double distance;
+            if (word != "vertex" || !(vertex >> offset.x >> offset.y >> gradient.x >> gradient.y >> distance)) {
+                *error = "expected vertex DX DY GX GY DISTANCE or end";
+                return false;
+            }
+            shape.offsets.push_back(offset);
+            shape.sdf.push_back(SDFData(glm::length(gradient) > 0 ? glm::normalize(gradient) : gradient, distance));
+        }
+        *error = "shape " + shape.name + " has no end";
+        return false;
+    } else if (command == "body") {
+        item = makeItem(SCENE_BODY);
+        std::string name;
+        if (!(words >> name >> item.start.x >> item.start.y >> item.mass)) {
+            *error = "expected body SHAPE X Y MASS [FRICTION [VX VY]]";
+            return false;
+        }
+        words >> item.friction >> item.velocity.x >> item.velocity.y;
+        item.shape = findShape(name);
+        if (item.shape < 0) {
+            *error = "unknown shape " + name;
+            return false;
+        }
+        if (item.mass <= 0) {
+            *error = "a rigid body cannot have a point of infinite mass";
+            return false;
+        }
+    } else if (command == "rope") {
+        item = makeItem(SCENE_ROPE);
+        if (!(words >> item.start.x >> item.start.y >> item.end.x >> item.end.y >> item.spacing >> item.mass)) {
+            *error = "expected rope X0 Y0 X1 Y1 SPACING MASS [pinned|free|start|end]";
+            return false;
+        }
+        std::string pins = "pinned";
+        words >> pins;
+        if (pins != "pinned" && pins != "free" && pins != "start" && pins != "end") {
+            *error = "expected rope ends to be pinned, free, start or end";
+            return false;
+        }
+        item.open = pins == "pinned" || pins == "start";
+        item.pinEnd = pins == "pinned" || pins == "end";
+        if (item.spacing <= 0 || item.start == item.end) {
+            *error = "ropes need a positive spacing and two different ends";
+            return false;
+        }
+    } else if (command == "link") {
+        item = makeItem(SCENE_LINK);
+        if (!(words >> item.first >> item.second)) {
+            *error = "expected link I J";
+            return false;
+        }
+        if (item.first < 0) {
+            item.first += m_numParticles;
+        }
+        if (item.second < 0) {
+            item.second += m_numParticles;
+        }
+        if (item.first < 0 || item.first >= m_numParticles || item.second < 0 || item.second >= m_numParticles ||
+            item.first == item.second) {
+            *error = "link must join two different existing particles";
+            return false;
+        }
+    } else if (command == "smoke" || command == "emitter") {
+        bool smoke = command == "smoke";
+        item = makeItem(smoke ? SCENE_SMOKE_EMITTER : SCENE_FLUID_EMITTER);
+        if (!(words >> item.start.x >> item.start.y >> item.rate)) {
+            *error = "expected " + command + " X Y RATE";
+            return false;
+        }
+
+        // Feed the most recent group of the right kind
+        for (int i = items.size() - 1; i >= 0 && item.first < 0; i--) {
+            if (items[i].type == (smoke ? SCENE_GAS : SCENE_FLUID)) {
+                item.first = i;
+            }
+        }
+        std::string none;
+        if (smoke && words >> none) {
+            if (none != "none") {
+                *error = "expected smoke X Y RATE [none]";
+                return false;
+            }
+            item.first = -1;
+        } else if (!smoke && item.first < 0) {
+            *error = "emitters need a fluid to feed";
+            return false;
+        }
+    } else {
+        *error = "unknown command " + command;
+        return false;
+    }
+
+    items.push_back(item);
+    m_numParticles += countParticles(item);
+    return true;
+}
+
+int SceneFile::findShape(const std::string &name) const {
+    for (unsigned int i = 0; i < shapes.size(); i++) {
+        if (shapes[i].name == name) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+glm::ivec2 SceneFile::getBlockSize(const SceneItem &item) {
+    // Counted up front so the particles can be placed at start + i * spacing without drift
+    glm::dvec2 extent = (item.end - item.start) / item.spacing;
+    return glm::ivec2(std::max(0., ceil(extent.x - EPSILON)), std::max(0., ceil(extent.y - EPSILON)));
+}
+
+int SceneFile::getRopeSegments(const SceneItem &item) {
+    return std::max(1, (int)round(glm::length(item.end - item.start) / item.spacing));
+}
+
+int SceneFile::countParticles(const SceneItem &item) const {
+    switch (item.type) {
+    case SCENE_PARTICLE:
+        return 1;
+    case SCENE_BLOCK:
+    case SCENE_FLUID:
+    case SCENE_GAS: {
+        glm::ivec2 size = getBlockSize(item);
+        return size.x * size.y;
+    }
+    case SCENE_BODY:
+        return shapes[item.shape].offsets.size();
+    case SCENE_ROPE:
+        return getRopeSegments(item) + 1;
+    default:
+        return 0;
+    }
+}
+
+int SceneFile::getNumConstraints() const {
+    int total = 0;
+    for (unsigned int i = 0; i < items.size(); i++) {
+        const SceneItem &item = items[i];
+        if (item.type == SCENE_FLUID || item.type == SCENE_GAS || item.type == SCENE_LINK) {
+            total++;
+        } else if (item.type == SCENE_ROPE) {
+            total += getRopeSegments(item);
+        }
+    }
+    return total;
+}
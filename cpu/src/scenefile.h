@@ -0,0 +1,97 @@
+#ifndef SCENEFILE_H
+#define SCENEFILE_H
+
+#include "includes.h"
+#include "particle.h"
+
+#include <string>
+#include <vector>
+
+// Kinds of line in a scene file, each building one item of the scene
+enum SceneItemType {
+    SCENE_PARTICLE,
+    SCENE_BLOCK,
+    SCENE_FLUID,
+    SCENE_GAS,
+    SCENE_BODY,
+    SCENE_ROPE,
+    SCENE_LINK,
+    SCENE_SMOKE_EMITTER,
+    SCENE_FLUID_EMITTER
+};
+
+// A rigid body shape, as offsets from the body's position and the SDF data of each particle
+struct SceneShape {
+    std::string name;
+    std::vector<glm::dvec2> offsets;
+    std::vector<SDFData> sdf;
+};
+
+// One item of a scene, only the fields its type uses are set
+struct SceneItem {
+    SceneItemType type;
+    glm::dvec2 start, end;  // position, or the corners of a block, or the ends of a rope
+    glm::dvec2 velocity;    // initial velocity of particles and bodies
+    double spacing;         // distance between neighboring particles of blocks and ropes
+    double mass;            // mass of each particle, 0 pins it in place
+    double jitter;          // random offset added to block particles
+    double density;         // rest density of fluids and gases
+    double friction;        // static and kinetic friction of rigid body particles
+    double rate;            // particles emitted per second
+    int shape;              // index of the body's shape
+    int first, second;      // linked particles, or the group an emitter feeds, -1 for none
+    bool open;              // whether a gas is open, or the pinned ends of a rope
+    bool pinEnd;
+};
+
+// A scene loaded from a text file, one item per line, built in the order it is written:
+//
+//   boundaries XMIN XMAX YMIN YMAX
+//   gravity X Y
+//   particle X Y MASS [VX VY]
+//   block X0 Y0 X1 Y1 SPACING MASS [JITTER]                 loose solid particles
+//   fluid DENSITY X0 Y0 X1 Y1 SPACING MASS [JITTER]
+//   gas DENSITY open|closed X0 Y0 X1 Y1 SPACING MASS [JITTER]
+//   shape NAME COLS ROWS                                    box of COLS x ROWS particles
+//   shape NAME                                              followed by "vertex DX DY GX GY DISTANCE"
+//                                                           lines up to "end"
+//   body SHAPE X Y MASS [FRICTION [VX VY]]
+//   rope X0 Y0 X1 Y1 SPACING MASS [pinned|free|start|end]   defaults to both ends pinned
+//   link I J                                                distance constraint at the current
+//                                                           distance, negative indices count back
+//                                                           from the last particle added
+//   smoke X Y RATE [none]                                   feeds the last gas unless none
+//   emitter X Y RATE                                        feeds the last fluid
+//
+// Blocks fill [X0, X1) x [Y0, Y1) row by row from the lower left corner. Everything after a
+// # is a comment.
+class SceneFile {
+public:
+    SceneFile();
+    virtual ~SceneFile();
+
+    // Read a scene, printing the first problem found and returning false if it isn't valid
+    bool load(const char *path);
+
+    // Number of particles and permanent constraints the scene will create
+    inline int getNumParticles() const { return m_numParticles; }
+    int getNumConstraints() const;
+
+    // Particle counts along each axis of a block, and the number of segments of a rope
+    static glm::ivec2 getBlockSize(const SceneItem &item);
+    static int getRopeSegments(const SceneItem &item);
+
+    glm::dvec2 xBoundaries, yBoundaries;
+    glm::dvec2 gravity;
+    std::vector<SceneShape> shapes;
+    std::vector<SceneItem> items;
+
+private:
+    bool parseLine(const std::string &line, std::istream &in, int *lineNumber, std::string *error);
+    int findShape(const std::string &name) const;
+    int countParticles(const SceneItem &item) const;
+
+    int m_numParticles;
+};
+
+#endif // SCENEFILE_H
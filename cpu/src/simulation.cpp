@@ -1,6 +1,7 @@
 #include "simulation.h"
 
 #include "boundaryconstraint.h"
+#include "constraintbatches.h"
 #include "contactconstraint.h"
 #include "distanceconstraint.h"
 #include "gasconstraint.h"
@@ -8,22 +9,32 @@
 #include "totalfluidconstraint.h"
 #include "totalshapeconstraint.h"
 
-Simulation::Simulation() {
+#include <algorithm>
+#include <string.h>
+
+Simulation::Simulation()
+    : m_smokeGrid(H), m_neighbors(H, NEIGHBOR_SKIN) {
     m_counts = NULL;
+    m_threadPool = NULL;
+    m_recorder = NULL;
+    m_numTicks = 0;
+    m_solverIterations = SOLVER_ITERATIONS;
+#if defined(PARALLEL_PROJECTION) || defined(JACOBI_PROJECTION)
+    m_threadPool = new ThreadPool(PROJECTION_THREADS);
+#endif
     init(SMOKE_OPEN_TEST);
     debug = true;
 }
 
 Simulation::~Simulation() {
     clear();
+    delete m_threadPool;
 }
 
 void Simulation::clear() {
-    for (int i = m_particles.size() - 1; i >= 0; i--) {
-        Particle *p = m_particles.at(i);
-        m_particles.removeAt(i);
-        delete (p);
-    }
+    m_numTicks = 0;
+    m_particles.clear();
+    m_islands.clear();
     for (int i = m_smokeEmitters.size() - 1; i >= 0; i--) {
         OpenSmokeEmitter *p = m_smokeEmitters.at(i);
         m_smokeEmitters.removeAt(i);
@@ -39,20 +50,20 @@ void Simulation::clear() {
         m_bodies.removeAt(i);
         delete (b);
     }
+    // A constraint may sit in more than one group, so collect them all and delete each once
+    std::vector<Constraint *> constraints;
     for (int i = 0; i < NUM_CONSTRAINT_GROUPS; i++) {
         if (m_globalConstraints.contains((ConstraintGroup)i)) {
-            QList<Constraint *> group = m_globalConstraints[(ConstraintGroup)i];
-            for (int j = group.size() - 1; j >= 0; j--) {
-                Constraint *c = group.at(j);
-                for (int k = 0; k < NUM_CONSTRAINT_GROUPS; k++) {
-                    if (m_globalConstraints.contains((ConstraintGroup)k)) {
-                        m_globalConstraints[(ConstraintGroup)k].removeAll(c);
-                    }
-                }
-                delete (c);
-            }
+            QList<Constraint *> &group = m_globalConstraints[(ConstraintGroup)i];
+            constraints.insert(constraints.end(), group.begin(), group.end());
+            group.clear();
         }
     }
+    std::sort(constraints.begin(), constraints.end());
+    constraints.erase(std::unique(constraints.begin(), constraints.end()), constraints.end());
+    for (unsigned int i = 0; i < constraints.size(); i++) {
+        delete constraints[i];
+    }
 
     if (m_counts) {
         delete[] m_counts;
@@ -126,17 +137,471 @@ void Simulation::init(SimulationType type) {
     m_standardSolver.setupM(&m_particles);
 
     m_counts = new int[m_particles.size()];
+    m_islands.resize(m_particles.size());
+    publish();
+}
+
+bool Simulation::load(const char *path) {
+    SceneFile scene;
+    if (!scene.load(path)) {
+        return false;
+    }
+    this->clear();
+
+    m_gravity = scene.gravity;
+    m_xBoundaries = scene.xBoundaries;
+    m_yBoundaries = scene.yBoundaries;
+
+    // Everything is sized up front, so building the scene never grows the particle store
+    m_particles.reserve(scene.getNumParticles());
+    m_globalConstraints[STANDARD].reserve(scene.getNumConstraints());
+
+    // Fluid and gas constraint built by each item, for the emitters feeding them
+    std::vector<Constraint *> groups(scene.items.size(), NULL);
+    int ropeBody = -2;
+
+    for (unsigned int i = 0; i < scene.items.size(); i++) {
+        const SceneItem &item = scene.items[i];
+        int offset = m_particles.size();
+
+        switch (item.type) {
+        case SCENE_PARTICLE:
+            m_particles.append(Particle(item.start, item.velocity, item.mass, SOLID));
+            break;
+        case SCENE_BLOCK:
+        case SCENE_FLUID:
+        case SCENE_GAS: {
+            glm::ivec2 size = SceneFile::getBlockSize(item);
+            for (int y = 0; y < size.y; y++) {
+                for (int x = 0; x < size.x; x++) {
+                    glm::dvec2 pos = item.start + glm::dvec2(x, y) * item.spacing;
+                    if (item.jitter != 0) {
+                        pos += item.jitter * glm::dvec2(frand() - .5, frand() - .5);
+                    }
+                    m_particles.append(Particle(pos, item.mass));
+                }
+            }
+            if (item.type == SCENE_FLUID) {
+                groups[i] = createFluid(offset, size.x * size.y, item.density);
+            } else if (item.type == SCENE_GAS) {
+                groups[i] = createGas(offset, size.x * size.y, item.density, item.open);
+            }
+            break;
+        }
+        case SCENE_BODY: {
+            const SceneShape &shape = scene.shapes[item.shape];
+            for (unsigned int v = 0; v < shape.offsets.size(); v++) {
+                Particle part(item.start + shape.offsets[v], item.velocity, item.mass, SOLID);
+                part.sFriction = item.friction;
+                part.kFriction = item.friction;
+                m_particles.append(part);
+            }
+            createRigidBody(offset, shape.offsets.size(), shape.sdf);
+            break;
+        }
+        case SCENE_ROPE: {
+            // Each rope is its own body, so its links don't collide with each other
+            int segments = SceneFile::getRopeSegments(item);
+            glm::dvec2 step = (item.end - item.start) / (double)segments;
+            for (int s = 0; s <= segments; s++) {
+                bool pinned = (s == 0 && item.open) || (s == segments && item.pinEnd);
+                Particle part(item.start + (double)s * step, pinned ? 0. : item.mass, SOLID);
+                part.bod = ropeBody;
+                m_particles.append(part);
+                if (s > 0) {
+                    m_globalConstraints[STANDARD].append(
+                        new DistanceConstraint(glm::length(step), offset + s - 1, offset + s));
+                }
+            }
+            ropeBody--;
+            break;
+        }
+        case SCENE_LINK:
+            m_globalConstraints[STANDARD].append(new DistanceConstraint(item.first, item.second, &m_particles));
+            break;
+        case SCENE_SMOKE_EMITTER:
+            createSmokeEmitter(item.start, item.rate, item.first >= 0 ? (GasConstraint *)groups[item.first] : NULL);
+            break;
+        case SCENE_FLUID_EMITTER:
+            createFluidEmitter(item.start, item.rate, (TotalFluidConstraint *)groups[item.first]);
+            break;
+        }
+    }
+
+    // Set up the M^-1 matrix
+    m_standardSolver.setupM(&m_particles);
+
+    m_counts = new int[m_particles.size()];
+    m_islands.resize(m_particles.size());
+    publish();
+    return true;
+}
+
+bool Simulation::saveSnapshot(const char *path) {
+    // Flatten the bodies, listing each body's particles with their r vectors and SDF data
+    std::vector<SnapshotBody> bodies(m_bodies.size());
+    std::vector<int32_t> bodyParticles;
+    std::vector<glm::dvec2> rs;
+    std::vector<SDFData> sdf;
+    for (int b = 0; b < m_bodies.size(); b++) {
+        Body *body = m_bodies[b];
+        bodies[b].numParticles = body->particles.size();
+        bodies[b].padding = 0;
+        bodies[b].center = body->center;
+        bodies[b].angle = body->angle;
+        bodies[b].imass = body->imass;
+        bodies[b].rotation = body->rotation;
+        bodyParticles.insert(bodyParticles.end(), body->particles.begin(), body->particles.end());
+        rs.insert(rs.end(), body->rs.begin(), body->rs.end());
+        sdf.insert(sdf.end(), body->sdf.begin(), body->sdf.end());
+    }
+
+    // Permanent constraints in solve order, remembering where each one went for the emitters
+    std::vector<SnapshotConstraint> constraints;
+    std::vector<int32_t> constraintParticles;
+    QHash<Constraint *, int> constraintIndices;
+    for (int g = 0; g < NUM_CONSTRAINT_GROUPS; g++) {
+        if (!m_globalConstraints.contains((ConstraintGroup)g)) {
+            continue;
+        }
+        const QList<Constraint *> &group = m_globalConstraints[(ConstraintGroup)g];
+        for (int i = 0; i < group.size(); i++) {
+            Constraint *c = group.at(i);
+            SnapshotConstraint sc;
+            memset(&sc, 0, sizeof(sc));
+            sc.group = g;
+
+            if (DistanceConstraint *dc = dynamic_cast<DistanceConstraint *>(c)) {
+                sc.type = SNAPSHOT_DISTANCE;
+                sc.first = dc->getFirst();
+                sc.second = dc->getSecond();
+                sc.flag = dc->isStable();
+                sc.value = dc->getDistance();
+            } else if (TotalFluidConstraint *fc = dynamic_cast<TotalFluidConstraint *>(c)) {
+                sc.type = SNAPSHOT_FLUID;
+                sc.first = constraintParticles.size();
+                sc.second = fc->ps.size();
+                sc.value = fc->p0;
+                constraintParticles.insert(constraintParticles.end(), fc->ps.begin(), fc->ps.end());
+            } else if (GasConstraint *gc = dynamic_cast<GasConstraint *>(c)) {
+                sc.type = SNAPSHOT_GAS;
+                sc.first = constraintParticles.size();
+                sc.second = gc->getParticles().size();
+                sc.flag = gc->isOpen();
+                sc.value = gc->getDensity();
+                constraintParticles.insert(constraintParticles.end(), gc->getParticles().begin(), gc->getParticles().end());
+            } else {
+                cout << "Constraint of unknown type cannot be saved." << endl;
+                return false;
+            }
+
+            constraintIndices[c] = constraints.size();
+            constraints.push_back(sc);
+        }
+    }
+
+    std::vector<SnapshotSmokeEmitter> smokeEmitters(m_smokeEmitters.size());
+    std::vector<Particle> smokeParticles;
+    for (int i = 0; i < m_smokeEmitters.size(); i++) {
+        OpenSmokeEmitter *e = m_smokeEmitters[i];
+        smokeEmitters[i].posn = e->getPosn();
+        smokeEmitters[i].particlesPerSec = e->getParticlesPerSec();
+        smokeEmitters[i].timer = e->getTimer();
+        smokeEmitters[i].gas = e->getGas() != NULL ? constraintIndices.value(e->getGas(), -1) : -1;
+        smokeEmitters[i].numParticles = e->getParticles()->size();
+        for (Particle *p : *(e->getParticles())) {
+            smokeParticles.push_back(*p);
+        }
+    }
+
+    std::vector<SnapshotFluidEmitter> fluidEmitters(m_fluidEmitters.size());
+    for (int i = 0; i < m_fluidEmitters.size(); i++) {
+        FluidEmitter *e = m_fluidEmitters[i];
+        fluidEmitters[i].posn = e->getPosn();
+        fluidEmitters[i].particlesPerSec = e->getParticlesPerSec();
+        fluidEmitters[i].timer = e->getTimer();
+        fluidEmitters[i].totalTimer = e->getTotalTimer();
+        fluidEmitters[i].fluid = e->getFluid() != NULL ? constraintIndices.value(e->getFluid(), -1) : -1;
+        fluidEmitters[i].padding = 0;
+    }
+
+    SnapshotHeader header = SnapshotHeader();
+    strncpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.byteOrder = SNAPSHOT_BYTE_ORDER;
+    header.numParticles = m_particles.size();
+    header.numBodies = bodies.size();
+    header.numBodyParticles = bodyParticles.size();
+    header.numConstraints = constraints.size();
+    header.numConstraintParticles = constraintParticles.size();
+    header.numSmokeEmitters = smokeEmitters.size();
+    header.numSmokeParticles = smokeParticles.size();
+    header.numFluidEmitters = fluidEmitters.size();
+    header.gravity = m_gravity;
+    header.xBoundaries = m_xBoundaries;
+    header.yBoundaries = m_yBoundaries;
+
+    SnapshotWriter out;
+    if (!out.open(path)) {
+        cout << "Could not write snapshot " << path << "." << endl;
+        return false;
+    }
+    out.write(&header, sizeof(header), 1);
+    out.write(m_particles.p);
+    out.write(m_particles.ep);
+    out.write(m_particles.v);
+    out.write(m_particles.f);
+    out.write(m_particles.imass);
+    out.write(m_particles.tmass);
+    out.write(m_particles.sFriction);
+    out.write(m_particles.kFriction);
+    out.write(m_particles.t);
+    out.write(m_particles.bod);
+    out.write(m_particles.ph);
+    out.write(m_islands.getIslands());
+    out.write(m_islands.getRestTimers());
+    out.write(bodies);
+    out.write(bodyParticles);
+    out.write(rs);
+    out.write(sdf);
+    out.write(constraints);
+    out.write(constraintParticles);
+    out.write(smokeEmitters);
+    out.write(smokeParticles);
+    out.write(fluidEmitters);
+    if (!out.close()) {
+        cout << "Could not write snapshot " << path << "." << endl;
+        return false;
+    }
+    return true;
+}
+
+bool Simulation::loadSnapshot(const char *path) {
+    SnapshotReader in;
+    if (!in.open(path)) {
+        return false;
+    }
+    const SnapshotHeader &header = in.getHeader();
+    int n = header.numParticles;
+
+    // Find every section before touching the running simulation, so a bad file leaves it as it was
+    const glm::dvec2 *p = in.read<glm::dvec2>(n), *ep = in.read<glm::dvec2>(n),
+                     *v = in.read<glm::dvec2>(n), *f = in.read<glm::dvec2>(n);
+    const double *imass = in.read<double>(n), *tmass = in.read<double>(n), *sFriction = in.read<double>(n),
+                 *kFriction = in.read<double>(n), *t = in.read<double>(n);
+    const int32_t *bod = in.read<int32_t>(n);
+    const Phase *ph = in.read<Phase>(n);
+    const int32_t *islands = in.read<int32_t>(n);
+    const double *rest = in.read<double>(n);
+    const SnapshotBody *bodies = in.read<SnapshotBody>(header.numBodies);
+    const int32_t *bodyParticles = in.read<int32_t>(header.numBodyParticles);
+    const glm::dvec2 *rs = in.read<glm::dvec2>(header.numBodyParticles);
+    const SDFData *sdf = in.read<SDFData>(header.numBodyParticles);
+    const SnapshotConstraint *constraints = in.read<SnapshotConstraint>(header.numConstraints);
+    const int32_t *constraintParticles = in.read<int32_t>(header.numConstraintParticles);
+    const SnapshotSmokeEmitter *smokeEmitters = in.read<SnapshotSmokeEmitter>(header.numSmokeEmitters);
+    const Particle *smokeParticles = in.read<Particle>(header.numSmokeParticles);
+    const SnapshotFluidEmitter *fluidEmitters = in.read<SnapshotFluidEmitter>(header.numFluidEmitters);
+
+    if (p == NULL || ep == NULL || v == NULL || f == NULL || imass == NULL || tmass == NULL || sFriction == NULL ||
+        kFriction == NULL || t == NULL || bod == NULL || ph == NULL || islands == NULL || rest == NULL ||
+        bodies == NULL || bodyParticles == NULL || rs == NULL || sdf == NULL || constraints == NULL ||
+        constraintParticles == NULL || smokeEmitters == NULL || smokeParticles == NULL || fluidEmitters == NULL ||
+        !validSnapshot(header, bod, ph, islands, bodies, bodyParticles, constraints, constraintParticles,
+                       smokeEmitters, fluidEmitters)) {
+        cout << "Snapshot " << path << " is truncated or corrupt." << endl;
+        return false;
+    }
+
+    this->clear();
+    m_gravity = header.gravity;
+    m_xBoundaries = header.xBoundaries;
+    m_yBoundaries = header.yBoundaries;
+
+    // Particle attributes copy straight out of the mapping
+    m_particles.p.assign(p, p + n);
+    m_particles.ep.assign(ep, ep + n);
+    m_particles.v.assign(v, v + n);
+    m_particles.f.assign(f, f + n);
+    m_particles.imass.assign(imass, imass + n);
+    m_particles.tmass.assign(tmass, tmass + n);
+    m_particles.sFriction.assign(sFriction, sFriction + n);
+    m_particles.kFriction.assign(kFriction, kFriction + n);
+    m_particles.t.assign(t, t + n);
+    m_particles.bod.assign(bod, bod + n);
+    m_particles.ph.assign(ph, ph + n);
+
+    for (int b = 0, k = 0; b < header.numBodies; b++) {
+        Body *body = new Body();
+        int count = bodies[b].numParticles;
+        body->particles.assign(bodyParticles + k, bodyParticles + k + count);
+        body->rs.assign(rs + k, rs + k + count);
+        body->sdf.assign(sdf + k, sdf + k + count);
+        k += count;
+        body->center = bodies[b].center;
+        body->angle = bodies[b].angle;
+        body->rotation = bodies[b].rotation;
+        body->rotateSDF();
+        body->imass = bodies[b].imass;
+        body->shape = new TotalShapeConstraint(body);
+        m_bodies.append(body);
+    }
+
+    std::vector<Constraint *> restored(header.numConstraints);
+    for (int i = 0; i < header.numConstraints; i++) {
+        const SnapshotConstraint &sc = constraints[i];
+        if (sc.type == SNAPSHOT_DISTANCE) {
+            restored[i] = new DistanceConstraint(sc.value, sc.first, sc.second, sc.flag);
+        } else {
+            QList<int> indices;
+            indices.reserve(sc.second);
+            for (int j = 0; j < sc.second; j++) {
+                indices.append(constraintParticles[sc.first + j]);
+            }
+            if (sc.type == SNAPSHOT_FLUID) {
+                restored[i] = new TotalFluidConstraint(sc.value, &indices, &m_neighbors);
+            } else {
+                restored[i] = new GasConstraint(sc.value, &indices, &m_neighbors, sc.flag);
+            }
+        }
+        m_globalConstraints[(ConstraintGroup)sc.group].append(restored[i]);
+    }
+
+    for (int i = 0, k = 0; i < header.numSmokeEmitters; i++) {
+        const SnapshotSmokeEmitter &e = smokeEmitters[i];
+        createSmokeEmitter(e.posn, e.particlesPerSec, e.gas >= 0 ? (GasConstraint *)restored[e.gas] : NULL);
+        m_smokeEmitters.last()->restore(e.timer, smokeParticles + k, e.numParticles);
+        k += e.numParticles;
+    }
+    for (int i = 0; i < header.numFluidEmitters; i++) {
+        const SnapshotFluidEmitter &e = fluidEmitters[i];
+        createFluidEmitter(e.posn, e.particlesPerSec, e.fluid >= 0 ? (TotalFluidConstraint *)restored[e.fluid] : NULL);
+        m_fluidEmitters.last()->restore(e.timer, e.totalTimer);
+    }
+
+    // Set up the M^-1 matrix
+    m_standardSolver.setupM(&m_particles);
+
+    m_counts = new int[m_particles.size()];
+    m_islands.restore(islands, rest, n);
+    publish();
+    return true;
+}
+
+bool Simulation::validSnapshot(const SnapshotHeader &header, const int32_t *bod, const Phase *ph, const int32_t *islands,
+                               const SnapshotBody *bodies,
+                               const int32_t *bodyParticles, const SnapshotConstraint *constraints,
+                               const int32_t *constraintParticles, const SnapshotSmokeEmitter *smokeEmitters,
+                               const SnapshotFluidEmitter *fluidEmitters) {
+    int n = header.numParticles;
+
+    // Every index the rebuilt structures will follow has to land inside the arrays it points into
+    for (int i = 0; i < n; i++) {
+        if ((int)ph[i] < 0 || (int)ph[i] >= NUM_PHASES || islands[i] < -1 || islands[i] >= n) {
+            return false;
+        }
+    }
+    long long total = 0;
+    for (int b = 0; b < header.numBodies; b++) {
+        if (bodies[b].numParticles < 0) {
+            return false;
+        }
+        total += bodies[b].numParticles;
+    }
+    if (total != header.numBodyParticles) {
+        return false;
+    }
+    for (int i = 0; i < header.numBodyParticles; i++) {
+        if (bodyParticles[i] < 0 || bodyParticles[i] >= n) {
+            return false;
+        }
+    }
+
+    // A body's particles have to be consecutive, as its r vectors and SDF data are looked up by
+    // the distance from its first particle, and have to name the body they're in
+    std::vector<int> firsts(header.numBodies);
+    for (int b = 0, k = 0; b < header.numBodies; k += bodies[b].numParticles, b++) {
+        firsts[b] = bodies[b].numParticles > 0 ? bodyParticles[k] : -1;
+        for (int i = 0; i < bodies[b].numParticles; i++) {
+            if (bodyParticles[k + i] != bodyParticles[k] + i || bod[bodyParticles[k + i]] != b) {
+                return false;
+            }
+        }
+    }
+
+    // Negative body numbers only group particles that don't collide with each other, and fluids and
+    // gases use any number for the same purpose. A solid with a body number is looked up in that
+    // body's SDF table, so it has to be one of the body's particles.
+    for (int i = 0; i < n; i++) {
+        if (ph[i] != SOLID || bod[i] < 0) {
+            continue;
+        }
+        if (bod[i] >= header.numBodies || firsts[bod[i]] < 0 || i < firsts[bod[i]] ||
+            i >= firsts[bod[i]] + bodies[bod[i]].numParticles) {
+            return false;
+        }
+    }
+
+    for (int i = 0; i < header.numConstraints; i++) {
+        const SnapshotConstraint &sc = constraints[i];
+        if (sc.group < 0 || sc.group >= NUM_CONSTRAINT_GROUPS) {
+            return false;
+        }
+        if (sc.type == SNAPSHOT_DISTANCE) {
+            if (sc.first < 0 || sc.first >= n || sc.second < 0 || sc.second >= n) {
+                return false;
+            }
+        } else if (sc.type == SNAPSHOT_FLUID || sc.type == SNAPSHOT_GAS) {
+            if (sc.first < 0 || sc.second < 0 || (long long)sc.first + sc.second > header.numConstraintParticles) {
+                return false;
+            }
+            for (int j = 0; j < sc.second; j++) {
+                if (constraintParticles[sc.first + j] < 0 || constraintParticles[sc.first + j] >= n) {
+                    return false;
+                }
+            }
+        } else {
+            return false;
+        }
+    }
+
+    total = 0;
+    for (int i = 0; i < header.numSmokeEmitters; i++) {
+        const SnapshotSmokeEmitter &e = smokeEmitters[i];
+        if (e.numParticles < 0 || e.gas >= header.numConstraints ||
+            (e.gas >= 0 && constraints[e.gas].type != SNAPSHOT_GAS)) {
+            return false;
+        }
+        total += e.numParticles;
+    }
+    if (total != header.numSmokeParticles) {
+        return false;
+    }
+    for (int i = 0; i < header.numFluidEmitters; i++) {
+        const SnapshotFluidEmitter &e = fluidEmitters[i];
+        if (e.fluid < 0 || e.fluid >= header.numConstraints || constraints[e.fluid].type != SNAPSHOT_FLUID) {
+            return false;
+        }
+    }
+    return true;
 }
 
 // (#) in the main simulation loop refer to lines from the main loop in the paper
 void Simulation::tick(double seconds) {
-    QHash<ConstraintGroup, QList<Constraint *>> constraints;
+    m_profiler.begin();
+
+    for (int i = 0; i < NUM_CONSTRAINT_GROUPS; i++) {
+        m_batches[i].clear();
+    }
 
-    // Add all rigid body shape constraints
+    // Add all rigid body shape constraints, except for sleeping bodies
+    m_sleepingBodies.clear();
     for (int i = 0; i < m_bodies.size(); i++) {
         Body *b = m_bodies[i];
-        if (TotalShapeConstraint *c = dynamic_cast<TotalShapeConstraint *>(b->shape)) {
-            constraints[SHAPE].append(c);
+        if (!b->particles.empty() && m_islands.isAsleep(b->particles[0])) {
+            m_sleepingBodies.push_back(i);
+        } else if (TotalShapeConstraint *c = dynamic_cast<TotalShapeConstraint *>(b->shape)) {
+            m_batches[SHAPE].add(c);
         } else {
             cout << "Rigid body's attached constraint was not a shape constraint." << endl;
             exit(1);
@@ -144,20 +609,32 @@ void Simulation::tick(double seconds) {
     }
 
     // Add all other global constraints
-    for (int i = 0; i < m_globalConstraints.size(); i++) {
-        QList<Constraint *> group = m_globalConstraints[(ConstraintGroup)i];
+    for (int i = 0; i < NUM_CONSTRAINT_GROUPS; i++) {
+        if (!m_globalConstraints.contains((ConstraintGroup)i)) {
+            continue;
+        }
+        const QList<Constraint *> &group = m_globalConstraints[(ConstraintGroup)i];
         for (int j = 0; j < group.size(); j++) {
-            constraints[(ConstraintGroup)i].append(group.at(j));
+            m_batches[i].add(group.at(j));
         }
     }
+    m_profiler.lap(STAGE_SETUP);
 
     // (1) For all particles
     for (int i = 0; i < m_particles.size(); i++) {
-        Particle *p = m_particles[i];
+
+        // Sleeping particles stay exactly where they are
+        if (m_islands.isAsleep(i)) {
+            m_particles.f[i] = glm::dvec2();
+            m_particles.ep[i] = m_particles.p[i];
+            m_counts[i] = 0;
+            m_particles.scaleMass(i);
+            continue;
+        }
 
         // (2) Apply forces
         glm::dvec2 myGravity = m_gravity;
-        if (p->ph == GAS)
+        if (m_particles.ph[i] == GAS)
             myGravity *= ALPHA;
         //        for(OpenSmokeEmitter *e: m_emitters) {
         //            for(Particle *p: m_particles) {
@@ -166,83 +643,84 @@ void Simulation::tick(double seconds) {
         //                }
         //            }
         //        }
-        p->v = p->v + seconds * myGravity + seconds * p->f;
-        p->f = glm::dvec2();
+        m_particles.v[i] = m_particles.v[i] + seconds * myGravity + seconds * m_particles.f[i];
+        m_particles.f[i] = glm::dvec2();
 
         // (3) Predict positions, reset n
-        p->ep = p->guess(seconds);
+        m_particles.ep[i] = m_particles.guess(i, seconds);
         m_counts[i] = 0;
 
         // (4) Apply mass scaling (used by certain constraints)
-        p->scaleMass();
+        m_particles.scaleMass(i);
     }
     // (5) End for
 
     m_contactSolver.setupM(&m_particles, true);
+    m_profiler.lap(STAGE_FORCES);
+
+    // Bin the predicted positions so contact candidates come from neighboring cells only
+    m_grid.build(m_particles.ep);
+    m_touching.clear();
 
     // (6) For all particles
     for (int i = 0; i < m_particles.size(); i++) {
-        Particle *p = m_particles[i];
 
-        // (7) Find neighboring particles and solid contacts, naive solution
-        for (int j = i + 1; j < m_particles.size(); j++) {
-            Particle *p2 = m_particles[j];
+        // Sleeping particles only touch awake ones, which look for them instead
+        if (!m_islands.isAsleep(i)) {
+            findContacts(i, 0);
+        }
+    }
+    // (9) End for
 
-            // Skip collision between two immovable particles
-            if (p->imass == 0 && p2->imass == 0) {
-                continue;
+    // Islands touched above wake now, in time for their particles to find their own contacts and
+    // boundaries this tick. Waking can spread to further islands, which are woken the same way
+    // round by round until nothing else is touched.
+    m_woken.clear();
+    m_wokenRound.resize(m_particles.size(), 0);
+    for (int round = 1, done = 0; m_islands.wakeQueued(&m_woken) > 0; round++) {
+        int end = m_woken.size();
+        for (int k = done; k < end; k++) {
+            m_wokenRound[m_woken[k]] = round;
+        }
+        for (int k = done; k < end; k++) {
+            findContacts(m_woken[k], round);
+        }
+        done = end;
+    }
+    for (unsigned int k = 0; k < m_woken.size(); k++) {
+        m_wokenRound[m_woken[k]] = 0;
+    }
 
-                // Skip collisions between particles in the same rigid body
-            } else if (p->ph == SOLID && p2->ph == SOLID && p->bod == p2->bod && p->bod != -1) {
+    // Woken bodies missed the shape constraints added above
+    if (!m_woken.empty()) {
+        for (unsigned int i = 0; i < m_sleepingBodies.size(); i++) {
+            Body *b = m_bodies[m_sleepingBodies[i]];
+            if (m_islands.isAsleep(b->particles[0])) {
                 continue;
+            } else if (TotalShapeConstraint *c = dynamic_cast<TotalShapeConstraint *>(b->shape)) {
+                m_batches[SHAPE].add(c);
             } else {
-
-                // Collision happens when circles overlap
-                double dist = glm::distance(p->ep, p2->ep);
-                if (dist < PARTICLE_DIAM - EPSILON) {
-
-                    // Rigid contact constraints (which include friction) apply to solid-solid contact
-                    if (p->ph == SOLID && p2->ph == SOLID) {
-                        constraints[CONTACT].append(new RigidContactConstraint(i, j, &m_bodies));
-#ifdef USE_STABILIZATION
-                        constraints[STABILIZATION].append(new RigidContactConstraint(i, j, &m_bodies, true));
-#endif
-                        // Regular contact constraints (which have no friction) apply to other solid-other contact
-                    } else if (p->ph == SOLID || p2->ph == SOLID) {
-                        constraints[CONTACT].append(new ContactConstraint(i, j));
-                    }
-                }
+                cout << "Rigid body's attached constraint was not a shape constraint." << endl;
+                exit(1);
             }
         }
+    }
+    m_profiler.lap(STAGE_CONTACTS);
 
-        // (8) Find solid boundary contacts
-        if (p->ep.x < m_xBoundaries.x + PARTICLE_RAD) {
-            constraints[CONTACT].append(new BoundaryConstraint(i, m_xBoundaries.x, true, true));
-#ifdef USE_STABILIZATION
-            constraints[STABILIZATION].append(new BoundaryConstraint(i, m_xBoundaries.x, true, true, true));
-#endif
-        } else if (p->ep.x > m_xBoundaries.y - PARTICLE_RAD) {
-            constraints[CONTACT].append(new BoundaryConstraint(i, m_xBoundaries.y, true, false));
-#ifdef USE_STABILIZATION
-            constraints[STABILIZATION].append(new BoundaryConstraint(i, m_xBoundaries.y, true, false, true));
-#endif
-        }
+    // Gather fluid and gas neighbors once for every constraint that needs them
+    m_neighbors.build(&m_particles);
+    m_profiler.lap(STAGE_NEIGHBORS);
 
-        if (p->ep.y < m_yBoundaries.x + PARTICLE_RAD) {
-            constraints[CONTACT].append(new BoundaryConstraint(i, m_yBoundaries.x, false, true));
-#ifdef USE_STABILIZATION
-            constraints[STABILIZATION].append(new BoundaryConstraint(i, m_yBoundaries.x, false, true, true));
-#endif
-        } else if (p->ep.y > m_yBoundaries.y - PARTICLE_RAD) {
-            constraints[CONTACT].append(new BoundaryConstraint(i, m_yBoundaries.y, false, false));
-#ifdef USE_STABILIZATION
-            constraints[STABILIZATION].append(new BoundaryConstraint(i, m_yBoundaries.y, false, false, true));
-#endif
-        }
+#if defined(PARALLEL_PROJECTION) && !defined(JACOBI_PROJECTION)
+    // Sort each group's distance and contact constraints into colors that can be solved concurrently
+    for (int i = 0; i < NUM_CONSTRAINT_GROUPS; i++) {
+        m_batches[i].color(m_particles.size());
     }
-    // (9) End for
+#endif
 
-    m_contactSolver.setupSizes(m_particles.size(), &constraints[STABILIZATION]);
+    QList<Constraint *> stabilization;
+    m_batches[STABILIZATION].gather(&stabilization);
+    m_contactSolver.setupSizes(m_particles.size(), &stabilization);
 
 #ifdef ITERATIVE
 
@@ -256,13 +734,21 @@ void Simulation::tick(double seconds) {
         }
 
         //  (18, 19, 20) Update n based on constraints in g
-        for (int k = 0; k < constraints[g].size(); k++) {
-            constraints[g].at(k)->updateCounts(m_counts);
-        }
+        m_batches[g].updateCounts(m_counts);
     }
 
 #endif
 
+    TickProfile &profile = m_profiler.current();
+    for (int i = 0; i < NUM_CONSTRAINT_GROUPS; i++) {
+        profile.numConstraints[i] = m_batches[i].size();
+    }
+    profile.numParticles = m_particles.size();
+    profile.numListed = m_neighbors.getNumListed();
+    profile.numNeighbors = m_neighbors.getNumPairs();
+    profile.maxNeighbors = m_neighbors.getMaxNeighbors();
+    m_profiler.lap(STAGE_SETUP);
+
 #ifdef USE_STABILIZATION
 
     // (10) For stabilization iterations
@@ -270,25 +756,31 @@ void Simulation::tick(double seconds) {
 
 #ifdef ITERATIVE
         // (11, 12, 13, 14) Solve contact constraints and update p, ep, and n
-        for (int k = 0; k < constraints[STABILIZATION].size(); k++) {
-            constraints[STABILIZATION].at(k)->project(&m_particles, m_counts);
-        }
+        m_batches[STABILIZATION].project(&m_particles, m_counts, m_threadPool);
 #else
         // (11, 12, 13, 14) Solve contact constraints and update p, ep, and n
-        if (constraints[STABILIZATION].size() > 0) {
-            m_contactSolver.solveAndUpdate(&m_particles, &constraints[STABILIZATION], true);
+        if (stabilization.size() > 0) {
+            m_contactSolver.solveAndUpdate(&m_particles, &stabilization, true);
         } else {
             break;
         }
 #endif
     }
     // (15) End for
+    m_profiler.lap(STAGE_STABILIZATION, STABILIZATION);
 
 #endif
 
 #ifdef ITERATIVE
     // (16) For solver iterations
-    for (int i = 0; i < SOLVER_ITERATIONS; i++) {
+    for (int i = 0; i < m_solverIterations; i++) {
+
+#ifdef NEIGHBORS_PER_ITERATION
+        if (i > 0) {
+            m_neighbors.build(&m_particles);
+            m_profiler.lap(STAGE_NEIGHBORS);
+        }
+#endif
 
         // (17) For constraint group
         for (int j = 0; j < (int)NUM_CONSTRAINT_GROUPS; j++) {
@@ -299,35 +791,46 @@ void Simulation::tick(double seconds) {
                 continue;
             }
 
-            //  (18, 19, 20) Solve constraints in g and update ep
-            for (int k = 0; k < constraints[g].size(); k++) {
-                constraints[g].at(k)->project(&m_particles, m_counts);
-            }
+            //  (18, 19, 20) Solve constraints in g and update ep, one batch of each type at a time
+#ifdef JACOBI_PROJECTION
+            m_batches[g].projectJacobi(&m_particles, m_counts, &m_deltas, m_threadPool);
+#else
+            m_batches[g].project(&m_particles, m_counts, m_threadPool);
+#endif
+            m_profiler.lap(STAGE_SOLVE, g);
         }
     }
 
 #else
 
-    m_standardSolver.setupSizes(m_particles.size(), &constraints[STANDARD]);
-    m_contactSolver.setupSizes(m_particles.size(), &constraints[CONTACT]);
+    QList<Constraint *> contact, standard;
+    m_batches[CONTACT].gather(&contact, true);
+    m_batches[STANDARD].gather(&standard, true);
+
+    m_standardSolver.setupSizes(m_particles.size(), &standard);
+    m_contactSolver.setupSizes(m_particles.size(), &contact);
+    m_profiler.lap(STAGE_SETUP);
 
     // (16) For solver iterations
-    for (int i = 0; i < SOLVER_ITERATIONS; i++) {
+    for (int i = 0; i < m_solverIterations; i++) {
 
         // (17, 18, 19, 20) for constraint group, solve constraints and update ep
-        if (constraints[CONTACT].size() > 0) {
-            m_contactSolver.solveAndUpdate(&m_particles, &constraints[CONTACT]);
+        if (contact.size() > 0) {
+            m_contactSolver.solveAndUpdate(&m_particles, &contact);
         }
+        m_profiler.lap(STAGE_SOLVE, CONTACT);
 
-        if (constraints[STANDARD].size() > 0) {
-            m_standardSolver.solveAndUpdate(&m_particles, &constraints[STANDARD]);
+        if (standard.size() > 0) {
+            m_standardSolver.solveAndUpdate(&m_particles, &standard);
         }
 
-        if (constraints[SHAPE].size() > 0) {
-            for (int j = 0; j < constraints[SHAPE].size(); j++) {
-                constraints[SHAPE][j]->project(&m_particles, m_counts);
-            }
-        }
+        // Gases and fluids can't be linearized, so they are projected directly
+        m_batches[STANDARD].gases.project(&m_particles, m_counts);
+        m_batches[STANDARD].fluids.project(&m_particles, m_counts);
+        m_profiler.lap(STAGE_SOLVE, STANDARD);
+
+        m_batches[SHAPE].project(&m_particles, m_counts);
+        m_profiler.lap(STAGE_SOLVE, SHAPE);
         // (21) End for
     }
     // (22) End for
@@ -335,33 +838,42 @@ void Simulation::tick(double seconds) {
 
     // (23) For all particles
     for (int i = 0; i < m_particles.size(); i++) {
-        Particle *p = m_particles[i];
+        if (m_islands.isAsleep(i)) {
+            continue;
+        }
 
         // (24) Update velocities
-        p->v = (p->ep - p->p) / seconds;
+        m_particles.v[i] = (m_particles.ep[i] - m_particles.p[i]) / seconds;
 
         // (25, 26) Advect diffuse particles, apply internal forces
         /// TODO
 
         // (27) Update positions or apply sleeping
-        p->confirmGuess();
+        m_particles.confirmGuess(i);
     }
     // (28) End for
+    m_profiler.lap(STAGE_VELOCITIES);
 
-    // Delete temporary contact constraints
-    for (int i = constraints[CONTACT].size() - 1; i >= 0; i--) {
-        Constraint *c = constraints[CONTACT].at(i);
-        constraints[CONTACT].removeAt(i);
-        delete (c);
-    }
-    for (int i = constraints[STABILIZATION].size() - 1; i >= 0; i--) {
-        Constraint *c = constraints[STABILIZATION].at(i);
-        constraints[STABILIZATION].removeAt(i);
-        delete (c);
-    }
+#ifdef ISLAND_SLEEPING
+    m_islands.update(&m_particles, m_bodies, m_touching, m_batches[STANDARD], seconds);
+    profile.numAsleep = m_islands.getNumAsleep();
+    profile.numIslands = m_islands.getNumAwakeIslands();
+    m_profiler.lap(STAGE_ISLANDS);
+#endif
 
+    // Throw away the temporary contact constraints all at once
+    m_batches[CONTACT].clear();
+    m_batches[STABILIZATION].clear();
+    m_frameArena.reset();
+    m_profiler.lap(STAGE_CLEANUP);
+
+    // Tracers only need the particles within H of them, so they share one grid of the final positions
+    if (!m_smokeEmitters.isEmpty()) {
+        m_smokeGrid.build(m_particles.p);
+    }
     for (OpenSmokeEmitter *e : m_smokeEmitters) {
-        e->tick(&m_particles, seconds);
+        TraceScope trace("smoke emitter", "emitter");
+        e->tick(&m_particles, m_smokeGrid, seconds, m_threadPool);
         // (8) Find solid boundary contacts
         for (Particle *p : *(e->getParticles())) {
             if (p->p.x < m_xBoundaries.x) {
@@ -377,89 +889,219 @@ void Simulation::tick(double seconds) {
         }
     }
     for (FluidEmitter *e : m_fluidEmitters) {
+        TraceScope trace("fluid emitter", "emitter");
         e->tick(&m_particles, seconds);
     }
+    m_profiler.lap(STAGE_EMITTERS);
+
     delete[] m_counts;
     m_counts = new int[m_particles.size()];
+    m_islands.resize(m_particles.size());
+    m_profiler.lap(STAGE_CLEANUP);
+
+    if (m_recorder != NULL) {
+        m_recorder->push(&m_particles);
+        m_profiler.lap(STAGE_RECORDING);
+    }
+
+    m_numTicks++;
+    publish();
+    m_profiler.lap(STAGE_PUBLISH);
+    m_profiler.end();
 }
 
-Body *Simulation::createRigidBody(QList<Particle *> *verts, QList<SDFData> *sdfData) {
-    if (verts->size() <= 1) {
+void Simulation::findContacts(int i, int round) {
+    const glm::dvec2 &ep = m_particles.ep[i];
+    double imass = m_particles.imass[i];
+    Phase ph = m_particles.ph[i];
+    int bod = m_particles.bod[i];
+
+    // (7) Find neighboring particles and solid contacts, visiting candidates in index
+    // order so the constraints come out exactly as a pairwise scan would produce them
+    m_candidates.clear();
+    m_grid.forEachCandidate(ep, PARTICLE_DIAM, [this, i, round](int j) {
+        if (round == 0 ? (j > i || m_islands.isAsleep(j)) : wokenCandidate(i, j, round)) {
+            m_candidates.push_back(j);
+        }
+    });
+    std::sort(m_candidates.begin(), m_candidates.end());
+    m_profiler.current().numCandidates += m_candidates.size();
+
+    for (unsigned int c = 0; c < m_candidates.size(); c++) {
+        int j = m_candidates[c];
+
+        // Skip collision between two immovable particles, where sleeping ones count as immovable
+        if (imass == 0 && (m_particles.imass[j] == 0 || m_islands.isAsleep(j))) {
+            continue;
+
+            // Skip collisions between particles in the same rigid body
+        } else if (ph == SOLID && m_particles.ph[j] == SOLID && bod == m_particles.bod[j] && bod != -1) {
+            continue;
+        } else {
+
+            // Collision happens when circles overlap
+            double dist = glm::distance(ep, m_particles.ep[j]);
+#ifdef ISLAND_SLEEPING
+            if (dist < PARTICLE_DIAM + ISLAND_MARGIN && imass != 0 && m_particles.imass[j] != 0) {
+                m_touching.push_back(glm::ivec2(i, j));
+            }
+#endif
+            if (dist < PARTICLE_DIAM - EPSILON) {
+
+                // Anything moving that touches a sleeping particle wakes its whole island
+                if (m_islands.isAsleep(j)) {
+                    m_islands.queueWake(j);
+                }
+
+                // Rigid contact constraints (which include friction) apply to solid-solid contact
+                if (ph == SOLID && m_particles.ph[j] == SOLID) {
+                    m_batches[CONTACT].add(m_frameArena.create<RigidContactConstraint>(i, j, &m_bodies));
+#ifdef USE_STABILIZATION
+                    m_batches[STABILIZATION].add(m_frameArena.create<RigidContactConstraint>(i, j, &m_bodies, true));
+#endif
+                    // Regular contact constraints (which have no friction) apply to other solid-other contact
+                } else if (ph == SOLID || m_particles.ph[j] == SOLID) {
+                    m_batches[CONTACT].add(m_frameArena.create<ContactConstraint>(i, j));
+                }
+            }
+        }
+    }
+
+    // (8) Find solid boundary contacts
+    if (ep.x < m_xBoundaries.x + PARTICLE_RAD) {
+        m_batches[CONTACT].add(m_frameArena.create<BoundaryConstraint>(i, m_xBoundaries.x, true, true));
+#ifdef USE_STABILIZATION
+        m_batches[STABILIZATION].add(m_frameArena.create<BoundaryConstraint>(i, m_xBoundaries.x, true, true, true));
+#endif
+    } else if (ep.x > m_xBoundaries.y - PARTICLE_RAD) {
+        m_batches[CONTACT].add(m_frameArena.create<BoundaryConstraint>(i, m_xBoundaries.y, true, false));
+#ifdef USE_STABILIZATION
+        m_batches[STABILIZATION].add(m_frameArena.create<BoundaryConstraint>(i, m_xBoundaries.y, true, false, true));
+#endif
+    }
+
+    if (ep.y < m_yBoundaries.x + PARTICLE_RAD) {
+        m_batches[CONTACT].add(m_frameArena.create<BoundaryConstraint>(i, m_yBoundaries.x, false, true));
+#ifdef USE_STABILIZATION
+        m_batches[STABILIZATION].add(m_frameArena.create<BoundaryConstraint>(i, m_yBoundaries.x, false, true, true));
+#endif
+    } else if (ep.y > m_yBoundaries.y - PARTICLE_RAD) {
+        m_batches[CONTACT].add(m_frameArena.create<BoundaryConstraint>(i, m_yBoundaries.y, false, false));
+#ifdef USE_STABILIZATION
+        m_batches[STABILIZATION].add(m_frameArena.create<BoundaryConstraint>(i, m_yBoundaries.y, false, false, true));
+#endif
+    }
+}
+
+bool Simulation::wokenCandidate(int i, int j, int round) const {
+    // Particles awake all along already found their contacts with i while it slept, except for
+    // static ones, which skip sleeping particles. Particles woken in an earlier round found theirs
+    // the same way, and particles woken in the same round split pairs by index as usual.
+    if (m_islands.isAsleep(j)) {
+        return true;
+    } else if (m_wokenRound[j] == 0) {
+        return m_particles.imass[j] == 0;
+    }
+    return m_wokenRound[j] == round && j > i;
+}
+
+Body *Simulation::createRigidBody(QList<Particle> *verts, QList<SDFData> *sdfData) {
+    int offset = m_particles.size();
+    for (int i = 0; i < verts->size(); i++) {
+        m_particles.append(verts->at(i));
+    }
+    return createRigidBody(offset, verts->size(), std::vector<SDFData>(sdfData->begin(), sdfData->end()));
+}
+
+Body *Simulation::createRigidBody(int offset, int count, const std::vector<SDFData> &sdfData) {
+    if (count <= 1) {
         cout << "Rigid bodies must be at least 2 points." << endl;
         exit(1);
     }
 
-    // Compute the total mass, add all the particles to the system and the body
+    // Compute the total mass, add all the particles to the body
     Body *body = new Body();
-    int offset = m_particles.size(), bodyIdx = m_bodies.size();
+    int bodyIdx = m_bodies.size();
     double totalMass = 0.0;
-    for (int i = 0; i < verts->size(); i++) {
-        Particle *p = verts->at(i);
-        p->bod = bodyIdx;
-        p->ph = SOLID;
+    for (int i = 0; i < count; i++) {
+        int idx = offset + i;
+        m_particles.bod[idx] = bodyIdx;
+        m_particles.ph[idx] = SOLID;
 
-        if (p->imass == 0.0) {
+        if (m_particles.imass[idx] == 0.0) {
             cout << "A rigid body cannot have a point of infinite mass." << endl;
             exit(1);
         }
 
-        totalMass += (1.0 / p->imass);
+        totalMass += (1.0 / m_particles.imass[idx]);
 
-        m_particles.append(p);
-        body->particles.append(i + offset);
-        body->sdf[i + offset] = sdfData->at(i);
+        body->particles.push_back(idx);
+        body->sdf.push_back(sdfData[i]);
     }
 
     // Update the body's global properties, including initial r_i vectors
     body->imass = 1.0 / totalMass;
     body->updateCOM(&m_particles, false);
     body->computeRs(&m_particles);
+    body->rotateSDF();
     body->shape = new TotalShapeConstraint(body);
 
     m_bodies.append(body);
     return body;
 }
 
-GasConstraint *Simulation::createGas(QList<Particle *> *verts, double density, bool open = false) {
+GasConstraint *Simulation::createGas(QList<Particle> *verts, double density, bool open = false) {
     int offset = m_particles.size();
+    for (int i = 0; i < verts->size(); i++) {
+        m_particles.append(verts->at(i));
+    }
+    return createGas(offset, verts->size(), density, open);
+}
+
+GasConstraint *Simulation::createGas(int offset, int count, double density, bool open) {
     int bod = 100 * frand();
     QList<int> indices;
-    for (int i = 0; i < verts->size(); i++) {
-        Particle *p = verts->at(i);
-        p->ph = GAS;
-        p->bod = bod;
+    for (int i = 0; i < count; i++) {
+        int idx = offset + i;
+        m_particles.ph[idx] = GAS;
+        m_particles.bod[idx] = bod;
 
-        if (p->imass == 0.0) {
+        if (m_particles.imass[idx] == 0.0) {
             cout << "A fluid cannot have a point of infinite mass." << endl;
             exit(1);
         }
 
-        m_particles.append(p);
-        indices.append(offset + i);
+        indices.append(idx);
     }
-    GasConstraint *gs = new GasConstraint(density, &indices, open);
+    GasConstraint *gs = new GasConstraint(density, &indices, &m_neighbors, open);
     m_globalConstraints[STANDARD].append(gs);
     return gs;
 }
 
-TotalFluidConstraint *Simulation::createFluid(QList<Particle *> *verts, double density) {
+TotalFluidConstraint *Simulation::createFluid(QList<Particle> *verts, double density) {
     int offset = m_particles.size();
+    for (int i = 0; i < verts->size(); i++) {
+        m_particles.append(verts->at(i));
+    }
+    return createFluid(offset, verts->size(), density);
+}
+
+TotalFluidConstraint *Simulation::createFluid(int offset, int count, double density) {
     int bod = 100 * frand();
     QList<int> indices;
-    for (int i = 0; i < verts->size(); i++) {
-        Particle *p = verts->at(i);
-        p->ph = FLUID;
-        p->bod = bod;
+    for (int i = 0; i < count; i++) {
+        int idx = offset + i;
+        m_particles.ph[idx] = FLUID;
+        m_particles.bod[idx] = bod;
 
-        if (p->imass == 0.0) {
+        if (m_particles.imass[idx] == 0.0) {
             cout << "A fluid cannot have a point of infinite mass." << endl;
             exit(1);
         }
 
-        m_particles.append(p);
-        indices.append(offset + i);
+        indices.append(idx);
     }
-    TotalFluidConstraint *fs = new TotalFluidConstraint(density, &indices);
+    TotalFluidConstraint *fs = new TotalFluidConstraint(density, &indices, &m_neighbors);
     m_globalConstraints[STANDARD].append(fs);
     return fs;
 }
@@ -472,27 +1114,87 @@ void Simulation::createFluidEmitter(glm::dvec2 posn, double particlesPerSec, Tot
     m_fluidEmitters.append(new FluidEmitter(posn, particlesPerSec, fs));
 }
 
+#ifdef HEADLESS
+void Simulation::publish() {
+}
+
 void Simulation::draw() {
-    drawGrid();
+}
+#else
+void Simulation::publish() {
+    RenderSnapshot &out = m_snapshots.back();
+
+    // assign() keeps the capacity from earlier snapshots, so this stops allocating once warm
+    out.p.assign(m_particles.p.begin(), m_particles.p.end());
+    out.imass.assign(m_particles.imass.begin(), m_particles.imass.end());
+    out.bod.assign(m_particles.bod.begin(), m_particles.bod.end());
+    out.ph.assign(m_particles.ph.begin(), m_particles.ph.end());
+
+    out.bodyStarts.assign(1, 0);
+    out.bodyParticles.clear();
+    out.bodyAngles.clear();
+    for (int b = 0; b < m_bodies.size(); b++) {
+        const Body *body = m_bodies[b];
+        out.bodyParticles.insert(out.bodyParticles.end(), body->particles.begin(), body->particles.end());
+        out.bodyStarts.push_back(out.bodyParticles.size());
+        out.bodyAngles.push_back(body->angle);
+    }
+
+    // Distance constraints are the only permanent constraints that draw anything
+    out.links.clear();
+    for (int g = 0; g < NUM_CONSTRAINT_GROUPS; g++) {
+        if (!m_globalConstraints.contains((ConstraintGroup)g)) {
+            continue;
+        }
+        const QList<Constraint *> &group = m_globalConstraints[(ConstraintGroup)g];
+        for (int i = 0; i < group.size(); i++) {
+            if (DistanceConstraint *dc = dynamic_cast<DistanceConstraint *>(group.at(i))) {
+                out.links.push_back(glm::ivec2(dc->getFirst(), dc->getSecond()));
+            }
+        }
+    }
+
+    out.smoke.clear();
+    for (int i = 0; i < m_smokeEmitters.size(); i++) {
+        QList<Particle *> *particles = m_smokeEmitters.at(i)->getParticles();
+        for (int j = 0; j < particles->size(); j++) {
+            out.smoke.push_back(particles->at(j)->p);
+        }
+    }
+
+    out.xBoundaries = m_xBoundaries;
+    out.yBoundaries = m_yBoundaries;
+    out.point = m_point;
+    out.numTicks = m_numTicks;
+    out.kineticEnergy = getKineticEnergy();
+    m_snapshots.publish();
+}
+
+void Simulation::draw() {
+    const RenderSnapshot &snapshot = m_snapshots.read();
+
+    drawGrid(snapshot);
     if (debug) {
-        drawParticles();
+        drawParticles(snapshot);
     }
-    drawBodies();
-    drawGlobals();
-    drawSmoke();
+    drawBodies(snapshot);
+    drawGlobals(snapshot);
+    drawSmoke(snapshot);
 
     glColor3f(1, 1, 1);
     glPointSize(5);
     glBegin(GL_POINTS);
-    glVertex2f(m_point.x, m_point.y);
+    glVertex2f(snapshot.point.x, snapshot.point.y);
     glEnd();
 }
+#endif
 
 void Simulation::resize(const glm::ivec2 &dim) {
     m_dimensions = dim;
 }
 
-void Simulation::drawGrid() {
+#ifndef HEADLESS
+void Simulation::drawGrid(const RenderSnapshot &snapshot) {
     glColor3f(.2, .2, .2);
     glBegin(GL_LINES);
 
@@ -514,41 +1216,43 @@ void Simulation::drawGrid() {
 
     glEnd();
 
+    const glm::dvec2 &xBoundaries = snapshot.xBoundaries, &yBoundaries = snapshot.yBoundaries;
     glLineWidth(3);
     glBegin(GL_LINES);
-    glVertex2f(m_xBoundaries.x, m_yBoundaries.x);
-    glVertex2f(m_xBoundaries.x, m_yBoundaries.y);
+    glVertex2f(xBoundaries.x, yBoundaries.x);
+    glVertex2f(xBoundaries.x, yBoundaries.y);
 
-    glVertex2f(m_xBoundaries.y, m_yBoundaries.x);
-    glVertex2f(m_xBoundaries.y, m_yBoundaries.y);
+    glVertex2f(xBoundaries.y, yBoundaries.x);
+    glVertex2f(xBoundaries.y, yBoundaries.y);
 
-    glVertex2f(m_xBoundaries.x, m_yBoundaries.x);
-    glVertex2f(m_xBoundaries.y, m_yBoundaries.x);
+    glVertex2f(xBoundaries.x, yBoundaries.x);
+    glVertex2f(xBoundaries.y, yBoundaries.x);
 
-    glVertex2f(m_xBoundaries.x, m_yBoundaries.y);
-    glVertex2f(m_xBoundaries.y, m_yBoundaries.y);
+    glVertex2f(xBoundaries.x, yBoundaries.y);
+    glVertex2f(xBoundaries.y, yBoundaries.y);
     glEnd();
     glLineWidth(1);
 }
 
-void Simulation::drawParticles() {
+void Simulation::drawParticles(const RenderSnapshot &snapshot) {
     // cout << "========================================" << endl;
-    for (int i = 0; i < m_particles.size(); i++) {
-        const Particle *p = m_particles[i];
+    for (unsigned int i = 0; i < snapshot.p.size(); i++) {
+        Phase ph = snapshot.ph[i];
+        int bod = snapshot.bod[i];
 
-        if (p->imass == 0.f) {
+        if (snapshot.imass[i] == 0.f) {
             glColor3f(1, 0, 0);
-        } else if (p->ph == FLUID || p->ph == GAS) {
-            glColor3f(0, p->bod / 100., 1 - p->bod / 100.);
-        } else if (p->ph == SOLID) {
-            setColor(p->bod, 1);
+        } else if (ph == FLUID || ph == GAS) {
+            glColor3f(0, bod / 100., 1 - bod / 100.);
+        } else if (ph == SOLID) {
+            setColor(bod, 1);
         } else {
             glColor3f(0, 0, 1);
         }
         // cout << "Particle " << i << " at " << p->p.x << ", " << p->p.y << endl;
 
         glPushMatrix();
-        glTranslatef(p->p.x, p->p.y, 0);
+        glTranslatef(snapshot.p[i].x, snapshot.p[i].y, 0);
         glScalef(PARTICLE_RAD, PARTICLE_RAD, 0);
         drawCircle();
         glPopMatrix();
@@ -558,22 +1262,21 @@ void Simulation::drawParticles() {
     // cout << "--------------------------------------" << endl;
 }
 
-void Simulation::drawBodies() {
-    for (int i = 0; i < m_bodies.size(); i++) {
-        Body *b = m_bodies[i];
+void Simulation::drawBodies(const RenderSnapshot &snapshot) {
+    for (unsigned int b = 0; b < snapshot.bodyAngles.size(); b++) {
         if (debug) {
             // b->shape->draw(&m_particles);
         } else {
-            for (int i = 0; i < b->particles.size(); i++) {
-                Particle *p = m_particles[(b->particles[i])];
+            for (int i = snapshot.bodyStarts[b]; i < snapshot.bodyStarts[b + 1]; i++) {
+                int idx = snapshot.bodyParticles[i];
 
                 glPushMatrix();
-                glTranslatef(p->p.x, p->p.y, 0);
+                glTranslatef(snapshot.p[idx].x, snapshot.p[idx].y, 0);
                 glPushMatrix();
-                glRotatef(R2D(b->angle), 0, 0, 1);
+                glRotatef(R2D(snapshot.bodyAngles[b]), 0, 0, 1);
 
                 glEnable(GL_BLEND);
-                setColor(p->bod, .6);
+                setColor(snapshot.bod[idx], .6);
                 glBegin(GL_QUADS);
                 glVertex2f(-PARTICLE_RAD, -PARTICLE_RAD);
                 glVertex2f(-PARTICLE_RAD, PARTICLE_RAD);
@@ -606,33 +1309,44 @@ void Simulation::drawBodies() {
     }
 }
 
-void Simulation::drawGlobals() {
-    for (int i = 0; i < m_globalConstraints.size(); i++) {
-        for (int j = 0; j < m_globalConstraints[(ConstraintGroup)i].size(); j++) {
-            m_globalConstraints[(ConstraintGroup)i][j]->draw(&m_particles);
-        }
+void Simulation::drawGlobals(const RenderSnapshot &snapshot) {
+    // Same as DistanceConstraint::draw, from the snapshot instead of the live particles
+    glColor3f(1, 1, 0);
+    glBegin(GL_LINES);
+    for (unsigned int i = 0; i < snapshot.links.size(); i++) {
+        const glm::dvec2 &p1 = snapshot.p[snapshot.links[i].x], &p2 = snapshot.p[snapshot.links[i].y];
+        glVertex2f(p1.x, p1.y);
+        glVertex2f(p2.x, p2.y);
+    }
+    glEnd();
+
+    glPointSize(3);
+    glBegin(GL_POINTS);
+    for (unsigned int i = 0; i < snapshot.links.size(); i++) {
+        const glm::dvec2 &p1 = snapshot.p[snapshot.links[i].x], &p2 = snapshot.p[snapshot.links[i].y];
+        glVertex2f(p1.x, p1.y);
+        glVertex2f(p2.x, p2.y);
     }
+    glEnd();
 }
 
-void Simulation::drawSmoke() {
+void Simulation::drawSmoke(const RenderSnapshot &snapshot) {
     glColor3f(1, 1, 1);
     glBegin(GL_QUADS);
     double rad = PARTICLE_RAD / 7.;
-    for (int i = 0; i < m_smokeEmitters.size(); i++) {
-        QList<Particle *> *particles = m_smokeEmitters.at(i)->getParticles();
-        for (int j = 0; j < particles->size(); j++) {
-            Particle *p = particles->at(j);
-            glVertex2d(p->p.x - rad, p->p.y - rad);
-            glVertex2d(p->p.x + rad, p->p.y - rad);
-            glVertex2d(p->p.x + rad, p->p.y + rad);
-            glVertex2d(p->p.x - rad, p->p.y + rad);
-            // glPushMatrix();
-            // glTranslatef(p->p.x, p->p.y, 0);
-            // glScalef(PARTICLE_RAD/7., PARTICLE_RAD/7., 0);
-            // drawCircle();
-            // glPopMatrix();
-        }
+    for (unsigned int i = 0; i < snapshot.smoke.size(); i++) {
+        const glm::dvec2 &p = snapshot.smoke[i];
+        glVertex2d(p.x - rad, p.y - rad);
+        glVertex2d(p.x + rad, p.y - rad);
+        glVertex2d(p.x + rad, p.y + rad);
+        glVertex2d(p.x - rad, p.y + rad);
+        // glPushMatrix();
+        // glTranslatef(p.x, p.y, 0);
+        // glScalef(PARTICLE_RAD/7., PARTICLE_RAD/7., 0);
+        // drawCircle();
+        // glPopMatrix();
     }
+    glEnd();
 }
 
 void Simulation::setColor(int body, float alpha) {
@@ -661,13 +1375,14 @@ void Simulation::drawCircle() {
 
     glEnd();
 }
+#endif
 
 void Simulation::initFriction() {
     m_xBoundaries = glm::dvec2(-20, 20);
     m_yBoundaries = glm::dvec2(0, 1000000);
 
     double root2 = sqrt(2);
-    QList<Particle *> vertices;
+    QList<Particle> vertices;
     QList<SDFData> data;
     data.append(SDFData(glm::normalize(glm::dvec2(-1, -1)), PARTICLE_RAD * root2));
     data.append(SDFData(glm::normalize(glm::dvec2(-1, 1)), PARTICLE_RAD * root2));
@@ -681,10 +1396,10 @@ void Simulation::initFriction() {
         double xVal = PARTICLE_DIAM * ((x % dim.x) - dim.x / 2);
         for (int y = 0; y < dim.y; y++) {
             double yVal = (dim.y + (y % dim.y) + 1) * PARTICLE_DIAM;
-            Particle *part = new Particle(glm::dvec2(xVal, yVal), (x == 0 && y == 0 ? 1 : 1.));
-            part->v.x = 5;
-            part->kFriction = .01;
-            part->sFriction = .1;
+            Particle part(glm::dvec2(xVal, yVal), (x == 0 && y == 0 ? 1 : 1.));
+            part.v.x = 5;
+            part.kFriction = .01;
+            part.sFriction = .1;
             vertices.append(part);
         }
     }
@@ -699,15 +1414,15 @@ void Simulation::initGranular() {
     for (int i = -15; i <= 15; i++) {
         for (int j = 0; j < 30; j++) {
             glm::dvec2 pos = glm::dvec2(i * (PARTICLE_DIAM + EPSILON), pow(j, 1.2) * (PARTICLE_DIAM) + PARTICLE_RAD + m_yBoundaries.x);
-            Particle *part = new Particle(pos, 1, SOLID);
-            part->sFriction = .35;
-            part->kFriction = .3;
+            Particle part(pos, 1, SOLID);
+            part.sFriction = .35;
+            part.kFriction = .3;
             m_particles.append(part);
         }
     }
 
-    Particle *jerk = new Particle(glm::dvec2(-25.55, 40), 100.f, SOLID);
-    jerk->v.x = 8.5;
+    Particle jerk(glm::dvec2(-25.55, 40), 100.f, SOLID);
+    jerk.v.x = 8.5;
     m_particles.append(jerk);
 }
 
@@ -717,7 +1432,7 @@ void Simulation::initSdf() {
 
     int numBoxes = 2;
     double root2 = sqrt(2);
-    QList<Particle *> vertices;
+    QList<Particle> vertices;
     QList<SDFData> data;
     data.append(SDFData(glm::normalize(glm::dvec2(-1, -1)), PARTICLE_RAD * root2));
     data.append(SDFData(glm::normalize(glm::dvec2(-1, 0)), PARTICLE_RAD));
@@ -732,9 +1447,9 @@ void Simulation::initSdf() {
             double xVal = PARTICLE_DIAM * ((x % dim.x) - dim.x / 2) + i * PARTICLE_RAD;
             for (int y = 0; y < dim.y; y++) {
                 double yVal = ((40 * i) * dim.y + (y % dim.y) + 1) * PARTICLE_DIAM;
-                Particle *part = new Particle(glm::dvec2(xVal, yVal), 4.);
+                Particle part(glm::dvec2(xVal, yVal), 4.);
                 if (i > 0)
-                    part->v.y = -120;
+                    part.v.y = -120;
                 vertices.append(part);
             }
         }
@@ -749,7 +1464,7 @@ void Simulation::initBoxes() {
 
     int numBoxes = 10, numColumns = 2;
     double root2 = sqrt(2);
-    QList<Particle *> vertices;
+    QList<Particle> vertices;
     QList<SDFData> data;
     data.append(SDFData(glm::normalize(glm::dvec2(-1, -1)), PARTICLE_RAD * root2));
     data.append(SDFData(glm::normalize(glm::dvec2(-1, 1)), PARTICLE_RAD * root2));
@@ -766,9 +1481,9 @@ void Simulation::initBoxes() {
                 double xVal = j * 4 + PARTICLE_DIAM * ((x % dim.x) - dim.x / 2);
                 for (int y = 0; y < dim.y; y++) {
                     double yVal = ((2 * i + 1) * dim.y + (y % dim.y) + 1) * PARTICLE_DIAM;
-                    Particle *part = new Particle(glm::dvec2(xVal, yVal), 4.);
-                    part->sFriction = 1.;
-                    part->kFriction = 1.;
+                    Particle part(glm::dvec2(xVal, yVal), 4.);
+                    part.sFriction = 1.;
+                    part.kFriction = 1.;
                     vertices.append(part);
                 }
             }
@@ -785,7 +1500,7 @@ void Simulation::initWall() {
     glm::dvec2 dim = glm::dvec2(6, 2);
     int height = 11, width = 5;
     double root2 = sqrt(2);
-    QList<Particle *> vertices;
+    QList<Particle> vertices;
     QList<SDFData> data;
     data.append(SDFData(glm::normalize(glm::dvec2(-1, -1)), PARTICLE_RAD * root2));
     data.append(SDFData(glm::normalize(glm::dvec2(-1, 1)), PARTICLE_RAD * root2));
@@ -805,9 +1520,9 @@ void Simulation::initWall() {
                 double xVal = j * (EPSILON + dim.x / 2.) + PARTICLE_DIAM * (x % (int)dim.x) - num * PARTICLE_RAD;
                 for (int y = 0; y < dim.y; y++) {
                     double yVal = (i * dim.y + (y % (int)dim.y) + EPSILON) * PARTICLE_DIAM + PARTICLE_RAD;
-                    Particle *part = new Particle(glm::dvec2(xVal, yVal), 1.);
-                    part->sFriction = 1;
-                    part->kFriction = 0;
+                    Particle part(glm::dvec2(xVal, yVal), 1.);
+                    part.sFriction = 1;
+                    part.kFriction = 0;
                     vertices.append(part);
                 }
             }
@@ -822,7 +1537,7 @@ void Simulation::initPendulum() {
     m_yBoundaries = glm::dvec2(0, 1000000);
 
     int chainLength = 3;
-    m_particles.append(new Particle(glm::dvec2(0, chainLength * 3 + 6) * PARTICLE_DIAM + glm::dvec2(0, 2), 0, SOLID));
+    m_particles.append(Particle(glm::dvec2(0, chainLength * 3 + 6) * PARTICLE_DIAM + glm::dvec2(0, 2), 0, SOLID));
 
     QList<SDFData> data;
     data.append(SDFData(glm::normalize(glm::dvec2(-1, -1)), PARTICLE_RAD));
@@ -832,14 +1547,14 @@ void Simulation::initPendulum() {
     data.append(SDFData(glm::normalize(glm::dvec2(1, -1)), PARTICLE_RAD));
     data.append(SDFData(glm::normalize(glm::dvec2(1, 1)), PARTICLE_RAD));
 
-    QList<Particle *> vertices;
+    QList<Particle> vertices;
     double xs[6] = {-1, -1, 0, 0, 1, 1};
 
     for (int i = chainLength; i >= 0; i--) {
         for (int j = 0; j < 6; j++) {
             double y = ((i + 1) * 3 + (j % 2)) * PARTICLE_DIAM + 2;
-            Particle *part = new Particle(glm::dvec2(xs[j] * PARTICLE_DIAM, y), 1.);
-            part->v.x = 3;
+            Particle part(glm::dvec2(xs[j] * PARTICLE_DIAM, y), 1.);
+            part.v.x = 3;
             vertices.append(part);
         }
         Body *body = createRigidBody(&vertices, &data);
@@ -862,31 +1577,31 @@ void Simulation::initRope() {
 
     double top = 6, dist = PARTICLE_RAD;
 
-    Particle *e1 = new Particle(glm::dvec2(m_xBoundaries.x, top), 0, SOLID);
-    e1->bod = -2;
+    Particle e1(glm::dvec2(m_xBoundaries.x, top), 0, SOLID);
+    e1.bod = -2;
     m_particles.append(e1);
 
     for (double i = m_xBoundaries.x + dist; i < m_xBoundaries.y - dist; i += dist) {
-        Particle *part = new Particle(glm::dvec2(i, top), 1., SOLID);
-        part->bod = -2;
+        Particle part(glm::dvec2(i, top), 1., SOLID);
+        part.bod = -2;
         m_particles.append(part);
         m_globalConstraints[STANDARD].append(
             new DistanceConstraint(dist, m_particles.size() - 2, m_particles.size() - 1));
     }
 
-    Particle *e2 = new Particle(glm::dvec2(m_xBoundaries.y, top), 0, SOLID);
-    e2->bod = -2;
+    Particle e2(glm::dvec2(m_xBoundaries.y, top), 0, SOLID);
+    e2.bod = -2;
     m_particles.append(e2);
 
     m_globalConstraints[STANDARD].append(
         new DistanceConstraint(dist, m_particles.size() - 2, m_particles.size() - 1));
 
     double delta = .7;
-    QList<Particle *> particles;
+    QList<Particle> particles;
 
     for (double x = -scale; x < scale; x += delta) {
         for (double y = 10; y < 10 + scale; y += delta) {
-            particles.append(new Particle(glm::dvec2(x, y) + .2 * glm::dvec2(frand() - .5, frand() - .5), 1));
+            particles.append(Particle(glm::dvec2(x, y) + .2 * glm::dvec2(frand() - .5, frand() - .5), 1));
         }
     }
     createFluid(&particles, 1.75);
@@ -897,14 +1612,14 @@ void Simulation::initFluid() {
     m_gravity = glm::dvec2(0, -9.8);
     m_xBoundaries = glm::dvec2(-2 * scale, 2 * scale);
     m_yBoundaries = glm::dvec2(-2 * scale, 10 * scale);
-    QList<Particle *> particles;
+    QList<Particle> particles;
 
     double num = 2.;
     for (int d = 0; d < num; d++) {
         double start = -2 * scale + 4 * scale * (d / num);
         for (double x = start; x < start + (4 * scale / num); x += delta) {
             for (double y = -2 * scale; y < scale; y += delta) {
-                particles.append(new Particle(glm::dvec2(x, y) + .2 * glm::dvec2(frand() - .5, frand() - .5), 1));
+                particles.append(Particle(glm::dvec2(x, y) + .2 * glm::dvec2(frand() - .5, frand() - .5), 1));
             }
         }
         createFluid(&particles, 1 + .75 * d);
@@ -917,14 +1632,14 @@ void Simulation::initFluidSolid() {
     m_gravity = glm::dvec2(0, -9.8);
     m_xBoundaries = glm::dvec2(-2 * scale, 2 * scale);
     m_yBoundaries = glm::dvec2(-2 * scale, 100 * scale);
-    QList<Particle *> particles;
+    QList<Particle> particles;
 
     double num = 1.;
     for (int d = 0; d < num; d++) {
         double start = -2 * scale + 4 * scale * (d / num);
         for (double x = start; x < start + (4 * scale / num); x += delta) {
             for (double y = -2 * scale; y < 2 * scale; y += delta) {
-                particles.append(new Particle(glm::dvec2(x, y + 3) + .2 * glm::dvec2(frand() - .5, frand() - .5), 1));
+                particles.append(Particle(glm::dvec2(x, y + 3) + .2 * glm::dvec2(frand() - .5, frand() - .5), 1));
             }
         }
         createFluid(&particles, 1. + 1.25 * (d + 1));
@@ -949,7 +1664,7 @@ void Simulation::initFluidSolid() {
             double xVal = PARTICLE_DIAM * ((x % dim.x) - dim.x / 2);
             for (int y = 0; y < dim.y; y++) {
                 double yVal = (dim.y + (y % dim.y) + 1) * PARTICLE_DIAM;
-                particles.append(new Particle(glm::dvec2(xVal - 3, yVal + 10), 2));
+                particles.append(Particle(glm::dvec2(xVal - 3, yVal + 10), 2));
             }
         }
         Body *body = createRigidBody(&particles, &data);
@@ -973,7 +1688,7 @@ void Simulation::initFluidSolid() {
             double xVal = PARTICLE_DIAM * ((x % dim.x) - dim.x / 2);
             for (int y = 0; y < dim.y; y++) {
                 double yVal = (dim.y + (y % dim.y) + 1) * PARTICLE_DIAM;
-                particles.append(new Particle(glm::dvec2(xVal + 3, yVal + 10), .2));
+                particles.append(Particle(glm::dvec2(xVal + 3, yVal + 10), .2));
             }
         }
         Body *body = createRigidBody(&particles, &data);
@@ -985,14 +1700,14 @@ void Simulation::initGas() {
     m_gravity = glm::dvec2(0, -9.8);
     m_xBoundaries = glm::dvec2(-2 * scale, 2 * scale);
     m_yBoundaries = glm::dvec2(-2 * scale, 10 * scale);
-    QList<Particle *> particles;
+    QList<Particle> particles;
 
     double num = 2.;
     for (int d = 0; d < num; d++) {
         double start = -2 * scale + 4 * scale * (d / num);
         for (double x = start; x < start + (4 * scale / num); x += delta) {
             for (double y = -2 * scale; y < 2 * scale; y += delta) {
-                particles.append(new Particle(glm::dvec2(x, y) + .2 * glm::dvec2(frand() - .5, frand() - .5), 1));
+                particles.append(Particle(glm::dvec2(x, y) + .2 * glm::dvec2(frand() - .5, frand() - .5), 1));
             }
         }
         createGas(&particles, .75 + 3 * (d));
@@ -1004,7 +1719,7 @@ void Simulation::initGas() {
         double start = -2 * scale + 4 * scale * (d / num);
         for (double x = start; x < start + (4 * scale / num); x += delta) {
             for (double y = -2 * scale; y < 2 * scale; y += delta) {
-                particles.append(new Particle(glm::dvec2(x, y + 10) + .2 * glm::dvec2(frand() - .5, frand() - .5), 1));
+                particles.append(Particle(glm::dvec2(x, y + 10) + .2 * glm::dvec2(frand() - .5, frand() - .5), 1));
             }
         }
         createFluid(&particles, 4. + .75 * (d + 1));
@@ -1021,8 +1736,8 @@ void Simulation::initWaterBalloon() {
 
     for (int i = 0; i < samples; i++) {
         double angle = D2R(i * da);
-        Particle *part = new Particle(glm::dvec2(sin(angle), cos(angle)) * 3., 1);
-        part->bod = -2;
+        Particle part(glm::dvec2(sin(angle), cos(angle)) * 3., 1);
+        part.bod = -2;
         int idx = m_particles.size();
         m_particles.append(part);
 
@@ -1037,8 +1752,8 @@ void Simulation::initWaterBalloon() {
 
     for (int i = 0; i < samples; i++) {
         double angle = D2R(i * da);
-        Particle *part = new Particle(glm::dvec2(sin(angle), cos(angle) + 3) * 3., 1);
-        part->bod = -3;
+        Particle part(glm::dvec2(sin(angle), cos(angle) + 3) * 3., 1);
+        part.bod = -3;
         int idx = m_particles.size();
         m_particles.append(part);
 
@@ -1051,11 +1766,11 @@ void Simulation::initWaterBalloon() {
         new DistanceConstraint(idk, m_particles.size() - 1, &m_particles));
 
     double delta = 1.5 * PARTICLE_RAD;
-    QList<Particle *> particles;
+    QList<Particle> particles;
 
     for (double x = -2; x <= 2; x += delta) {
         for (double y = -2; y <= 2; y += delta) {
-            particles.append(new Particle(glm::dvec2(x, y) + .2 * glm::dvec2(frand() - .5, frand() - .5), 1));
+            particles.append(Particle(glm::dvec2(x, y) + .2 * glm::dvec2(frand() - .5, frand() - .5), 1));
         }
     }
     createFluid(&particles, 1.75);
@@ -1063,7 +1778,7 @@ void Simulation::initWaterBalloon() {
     particles.clear();
     for (double x = -2; x <= 2; x += delta) {
         for (double y = -2; y <= 2; y += delta) {
-            particles.append(new Particle(glm::dvec2(x, y + 9) + .2 * glm::dvec2(frand() - .5, frand() - .5), 1));
+            particles.append(Particle(glm::dvec2(x, y + 9) + .2 * glm::dvec2(frand() - .5, frand() - .5), 1));
         }
     }
     createFluid(&particles, 1.75);
@@ -1077,11 +1792,11 @@ void Simulation::initNewtonsCradle() {
 
     for (int i = -n; i <= n; i++) {
         int idx = m_particles.size();
-        m_particles.append(new Particle(glm::dvec2(i * PARTICLE_DIAM, 0), 0.f));
+        m_particles.append(Particle(glm::dvec2(i * PARTICLE_DIAM, 0), 0.f));
         if (i != -n) {
-            m_particles.append(new Particle(glm::dvec2(i * PARTICLE_DIAM, -3), 1.f));
+            m_particles.append(Particle(glm::dvec2(i * PARTICLE_DIAM, -3), 1.f));
         } else {
-            Particle *part = new Particle(glm::dvec2(i * PARTICLE_DIAM - 3, 0), 1.f);
+            Particle part(glm::dvec2(i * PARTICLE_DIAM - 3, 0), 1.f);
             m_particles.append(part);
         }
         m_globalConstraints[STANDARD].append(new DistanceConstraint(idx, idx + 1, &m_particles));
@@ -1093,11 +1808,11 @@ void Simulation::initSmokeOpen() {
     m_gravity = glm::dvec2(0, -9.8);
     m_xBoundaries = glm::dvec2(-3 * scale, 3 * scale);
     m_yBoundaries = glm::dvec2(-2 * scale, 100 * scale);
-    QList<Particle *> particles;
+    QList<Particle> particles;
 
     for (double x = -2 * scale; x < 2 * scale; x += delta) {
         for (double y = -1.5 * scale; y < 2 * scale; y += delta) {
-            particles.append(new Particle(glm::dvec2(x, y) + .2 * glm::dvec2(frand() - .5, frand() - .5), 1));
+            particles.append(Particle(glm::dvec2(x, y) + .2 * glm::dvec2(frand() - .5, frand() - .5), 1));
         }
     }
     GasConstraint *gs = createGas(&particles, 1.5, true);
@@ -1111,12 +1826,12 @@ void Simulation::initSmokeClosed() {
     m_gravity = glm::dvec2(0, -9.8);
     m_xBoundaries = glm::dvec2(-2 * scale, 2 * scale);
     m_yBoundaries = glm::dvec2(-2 * scale, 2 * scale);
-    QList<Particle *> particles;
+    QList<Particle> particles;
 
     double start = -2 * scale;
     for (double x = start; x < start + (4 * scale); x += delta) {
         for (double y = -2 * scale; y < 2 * scale; y += delta) {
-            particles.append(new Particle(glm::dvec2(x, y) + .2 * glm::dvec2(frand() - .5, frand() - .5), 1));
+            particles.append(Particle(glm::dvec2(x, y) + .2 * glm::dvec2(frand() - .5, frand() - .5), 1));
         }
     }
     GasConstraint *gs = createGas(&particles, 1.5, false);
@@ -1133,13 +1848,13 @@ void Simulation::initRopeGas() {
 
     double top = 12, dist = PARTICLE_RAD;
 
-    Particle *e1 = new Particle(glm::dvec2(0, top), 0, SOLID);
-    e1->bod = -2;
+    Particle e1(glm::dvec2(0, top), 0, SOLID);
+    e1.bod = -2;
     m_particles.append(e1);
 
     for (double i = 0 + dist; i < 4 * scale - dist; i += dist) {
-        Particle *part = new Particle(glm::dvec2(i, top), 2, SOLID);
-        part->bod = -2;
+        Particle part(glm::dvec2(i, top), 2, SOLID);
+        part.bod = -2;
         m_particles.append(part);
         m_globalConstraints[STANDARD].append(
             new DistanceConstraint(dist, m_particles.size() - 2, m_particles.size() - 1));
@@ -1152,12 +1867,12 @@ void Simulation::initRopeGas() {
     m_globalConstraints[STANDARD].append(
         new DistanceConstraint(dist, m_particles.size() - 2, m_particles.size() - 1));
 
-    QList<Particle *> particles;
+    QList<Particle> particles;
 
     double start = -.5 * scale;
     for (double x = start; x < start + (1 * scale); x += delta) {
         for (double y = -.5 * scale; y < .5 * scale; y += delta) {
-            particles.append(new Particle(glm::dvec2(x, y) + .2 * glm::dvec2(frand() - .5, frand() - .5), 1));
+            particles.append(Particle(glm::dvec2(x, y) + .2 * glm::dvec2(frand() - .5, frand() - .5), 1));
         }
     }
     GasConstraint *gs = createGas(&particles, 1.5, true);
@@ -1170,20 +1885,20 @@ void Simulation::initVolcano() {
     double scale = 10., delta = .2;
 
     for (double x = 1.; x <= scale; x += delta) {
-        m_particles.append(new Particle(glm::dvec2(-x, scale - x), 0));
-        m_particles.append(new Particle(glm::dvec2(x, scale - x), 0));
+        m_particles.append(Particle(glm::dvec2(-x, scale - x), 0));
+        m_particles.append(Particle(glm::dvec2(x, scale - x), 0));
     }
 
     m_gravity = glm::dvec2(0, -9.8);
     m_xBoundaries = glm::dvec2(-2 * scale, 2 * scale);
     m_yBoundaries = glm::dvec2(0, 10 * scale);
-    QList<Particle *> particles;
+    QList<Particle> particles;
 
     delta = .8;
     for (double y = 0.; y < scale - 1.; y += delta) {
         for (double x = 0.; x < scale - y - 1; x += delta) {
-            particles.append(new Particle(glm::dvec2(x, y) + .2 * glm::dvec2(frand() - .5, frand() - .5), 1.1));
-            particles.append(new Particle(glm::dvec2(-x, y) + .2 * glm::dvec2(frand() - .5, frand() - .5), 1.1));
+            particles.append(Particle(glm::dvec2(x, y) + .2 * glm::dvec2(frand() - .5, frand() - .5), 1.1));
+            particles.append(Particle(glm::dvec2(-x, y) + .2 * glm::dvec2(frand() - .5, frand() - .5), 1.1));
         }
     }
     TotalFluidConstraint *fs = createFluid(&particles, 1);
@@ -1213,7 +1928,7 @@ void Simulation::initWreckingBall() {
     glm::dvec2 dim = glm::dvec2(6, 2);
     int height = 8, width = 2;
     double root2 = sqrt(2);
-    QList<Particle *> vertices;
+    QList<Particle> vertices;
     QList<SDFData> data;
     data.append(SDFData(glm::normalize(glm::dvec2(-1, -1)), PARTICLE_RAD * root2));
     data.append(SDFData(glm::normalize(glm::dvec2(-1, 1)), PARTICLE_RAD * root2));
@@ -1233,9 +1948,9 @@ void Simulation::initWreckingBall() {
                 double xVal = j * (EPSILON + dim.x / 2.) + PARTICLE_DIAM * (x % (int)dim.x) - num * PARTICLE_RAD;
                 for (int y = 0; y < dim.y; y++) {
                     double yVal = (i * dim.y + (y % (int)dim.y) + EPSILON) * PARTICLE_DIAM + PARTICLE_RAD;
-                    Particle *part = new Particle(glm::dvec2(xVal, yVal), 30.);
-                    part->sFriction = 1;
-                    part->kFriction = 1;
+                    Particle part(glm::dvec2(xVal, yVal), 30.);
+                    part.sFriction = 1;
+                    part.kFriction = 1;
                     vertices.append(part);
                 }
             }
@@ -1245,27 +1960,27 @@ void Simulation::initWreckingBall() {
     }
 
     double scale = 6., delta = .4;
-    QList<Particle *> particles;
+    QList<Particle> particles;
 
     double num = 1.;
     double start = m_xBoundaries.x + 1;
     for (double x = start; x < start + (scale / num); x += delta) {
         for (double y = 0; y < 1.2 * scale; y += delta) {
-            particles.append(new Particle(glm::dvec2(x, y) + .2 * glm::dvec2(frand() - .5, frand() - .5), 1));
+            particles.append(Particle(glm::dvec2(x, y) + .2 * glm::dvec2(frand() - .5, frand() - .5), 1));
         }
     }
     createFluid(&particles, 2.5);
     particles.clear();
 
     int idx = m_particles.size();
-    m_particles.append(new Particle(glm::dvec2(10, 50), 0));
+    m_particles.append(Particle(glm::dvec2(10, 50), 0));
     data.clear();
 
     glm::dvec2 base = glm::dvec2(57, 50);
-    particles.append(new Particle(base, 1000));
+    particles.append(Particle(base, 1000));
     for (double a = 0; a <= 360; a += 30) {
         glm::dvec2 vec = glm::dvec2(cos(D2R(a)), sin(D2R(a)));
-        particles.append(new Particle(vec * PARTICLE_RAD + base, 1000));
+        particles.append(Particle(vec * PARTICLE_RAD + base, 1000));
         data.append(SDFData(vec, PARTICLE_RAD * 1.5));
     }
     data.append(SDFData());
@@ -1278,23 +1993,59 @@ int Simulation::getNumParticles() {
     return m_particles.size();
 }
 
+int Simulation::getNumConstraints(ConstraintGroup group) {
+    return (int)m_profiler.getLast().numConstraints[group];
+}
+
+const TickProfiler &Simulation::getProfiler() {
+    return m_profiler;
+}
+
+void Simulation::resetProfiler() {
+    m_profiler.reset();
+}
+
+void Simulation::setTrace(TraceWriter *trace) {
+    m_profiler.setTrace(trace);
+    TraceWriter::setActive(trace);
+    if (trace != NULL) {
+        trace->nameThread("simulation");
+    }
+}
+
+void Simulation::setSolverIterations(int iterations) {
+    m_solverIterations = std::max(1, iterations);
+}
+
+void Simulation::setSolverBackend(SolverBackend backend) {
+    m_standardSolver.setBackend(backend);
+    m_contactSolver.setBackend(backend);
+}
+
+void Simulation::setRecorder(TrajectoryWriter *recorder) {
+    m_recorder = recorder;
+}
+
+const ArenaStats &Simulation::getArenaStats() {
+    return m_frameArena.getStats();
+}
+
 double Simulation::getKineticEnergy() {
     double energy = 0;
     for (int i = 0; i < m_particles.size(); i++) {
-        Particle *p = m_particles[i];
-        if (p->imass != 0.) {
-            energy += .5 * glm::dot(p->v, p->v) / p->imass;
+        if (m_particles.imass[i] != 0.) {
+            energy += .5 * glm::dot(m_particles.v[i], m_particles.v[i]) / m_particles.imass[i];
         }
     }
     return energy;
 }
 
 void Simulation::mousePressed(const glm::dvec2 &p) {
+    m_islands.wakeAll();
     for (int i = 0; i < m_particles.size(); i++) {
-        Particle *part = m_particles.at(i);
-
-        glm::dvec2 to = glm::normalize(p - part->p);
-        part->v += 7. * to;
+        glm::dvec2 to = glm::normalize(p - m_particles.p[i]);
+        m_particles.v[i] += 7. * to;
     }
     m_point = p;
+    publish();
 }
@@ -1,22 +1,58 @@
 #ifndef SIMULATION_H
 #define SIMULATION_H
 
+#include "constraintbatches.h"
 #include "fluidemitter.h"
+#include "framearena.h"
 #include "includes.h"
+#include "islands.h"
+#include "neighborlist.h"
 #include "opensmokeemitter.h"
 #include "particle.h"
+#include "particlestore.h"
+#include "scenefile.h"
+#include "snapshot.h"
 #include "solver.h"
+#include "spatialgrid.h"
+#include "threadpool.h"
+#include "tickprofiler.h"
+#include "trajectory.h"
+#include "triplebuffer.h"
 
-// Number of solver iterations per timestep
+// Default number of solver iterations per timestep
 #define SOLVER_ITERATIONS 3
 
-// Iterative or matrix solve
+// Iterative or matrix solve, building with MATRIX_SOLVE defined switches to the matrix solver
+#ifndef MATRIX_SOLVE
 #define ITERATIVE
+#endif
 
 // Use stabilization pass or not, and if so how many iterations
 // #define USE_STABILIZATION
 #define STABILIZATION_ITERATIONS 2
 
+// Extra distance beyond the kernel radius H gathered into fluid and gas neighbor lists,
+// lists are rebuilt during the solve only once some particle has moved half of it
+#define NEIGHBOR_SKIN 1.
+
+// Rebuild fluid and gas neighbor lists before every solver iteration instead of once per tick
+// #define NEIGHBORS_PER_ITERATION
+
+// Project distance and contact constraints on several threads, one independent graph color at a time
+// #define PARALLEL_PROJECTION
+
+// Project the solver iterations Jacobi style instead, with every pairwise and shape constraint in a
+// group working from the same positions on several threads. Takes precedence over PARALLEL_PROJECTION.
+// #define JACOBI_PROJECTION
+
+// Threads used by parallel or Jacobi projection, 0 for one per hardware thread
+#define PROJECTION_THREADS 0
+
+// Put islands of rigid bodies and grains that have come to rest to sleep until something
+// touches them, see Islands. Off by default, as sleeping changes how the built-in scenes play
+// out; without it every particle is simulated every tick.
+// #define ISLAND_SLEEPING
+
 // Gravity scaling factor for gases
 #define ALPHA -.2
 
@@ -42,13 +78,50 @@ enum SimulationType {
     WRECKING_BALL
 };
 
+// Everything drawing needs from the end of one tick, copied out of the simulation so it can be
+// drawn on another thread while the next tick runs
+struct RenderSnapshot {
+    RenderSnapshot() : numTicks(0), kineticEnergy(0) {}
+
+    std::vector<glm::dvec2> p;
+    std::vector<double> imass;
+    std::vector<int> bod;
+    std::vector<Phase> ph;
+
+    // Particles of body b are bodyParticles[bodyStarts[b]] up to bodyParticles[bodyStarts[b + 1]]
+    std::vector<int> bodyStarts, bodyParticles;
+    std::vector<double> bodyAngles;
+
+    std::vector<glm::ivec2> links; // particles joined by distance constraints
+    std::vector<glm::dvec2> smoke; // smoke emitter tracers
+    glm::dvec2 xBoundaries, yBoundaries, point;
+    int numTicks;
+    double kineticEnergy;
+};
+
 // The basic simulation, implementing the "main solve loop" from the paper.
+//
+// Drawing only reads the snapshot published at the end of each tick, init, load and mouse
+// press, so draw(), resize(), getRenderSnapshot() and the debug flag may be used from a GUI
+// thread while another thread runs everything else.
 class Simulation {
 public:
     Simulation();
     virtual ~Simulation();
     void init(SimulationType type);
 
+    // Build the scene described by a scene file instead, returning false if it can't be read
+    bool load(const char *path);
+
+    // Write the whole running simulation to a snapshot file, or replace it with one read back,
+    // returning false on failure. The C library's rand() state isn't part of the snapshot.
+    bool saveSnapshot(const char *path);
+    bool loadSnapshot(const char *path);
+
+    // Push every tick's particles to a trajectory writer from now on, NULL to stop. The writer
+    // is owned by the caller and must stay open while set.
+    void setRecorder(TrajectoryWriter *recorder);
+
     // Initializers for test scenes
     void initFriction();
     void initSdf();
@@ -70,12 +143,39 @@ public:
 
     // Basic interaction events
     void tick(double seconds);
+
+    // Draw the latest published snapshot
     void draw();
     void resize(const glm::ivec2 &dim);
     void mousePressed(const glm::dvec2 &p);
 
+    // The snapshot drawn last
+    inline const RenderSnapshot &getRenderSnapshot() const { return m_snapshots.front(); }
+
     // Debug information and flags
     int getNumParticles();
+
+    // Constraints solved in a group during the last tick
+    int getNumConstraints(ConstraintGroup group);
+
+    // Stage timings and problem sizes of the last tick and of every tick since the last reset
+    const TickProfiler &getProfiler();
+    void resetProfiler();
+
+    // Write every tick, stage, constraint group pass, linear solve and emitter tick to a trace
+    // from now on, NULL to stop. The trace is owned by the caller and must stay open while set.
+    void setTrace(TraceWriter *trace);
+
+    // Memory used by the per-tick contact constraints, see lastAllocations and lastBytesUsed for
+    // the last tick as the arena is already reset when a tick returns
+    const ArenaStats &getArenaStats();
+
+    // Solver iterations run by each tick from now on
+    void setSolverIterations(int iterations);
+    inline int getSolverIterations() const { return m_solverIterations; }
+
+    // Linear solver used by the matrix solve when ITERATIVE is off
+    void setSolverBackend(SolverBackend backend);
     double getKineticEnergy();
     bool debug;
 
@@ -83,37 +183,101 @@ private:
     // Reset the simulation
     void clear();
 
+    // Copy the current state into the next render snapshot and hand it to drawing
+    void publish();
+
+    // Add the contact and boundary constraints of particle i. Round 0 is the pass over awake
+    // particles, later rounds cover the particles woken by the round before.
+    void findContacts(int i, int round);
+    bool wokenCandidate(int i, int j, int round) const;
+
+    // Check every index in a mapped snapshot before anything is rebuilt from it
+    bool validSnapshot(const SnapshotHeader &header, const int32_t *bod, const Phase *ph, const int32_t *islands,
+                       const SnapshotBody *bodies,
+                       const int32_t *bodyParticles, const SnapshotConstraint *constraints,
+                       const int32_t *constraintParticles, const SnapshotSmokeEmitter *smokeEmitters,
+                       const SnapshotFluidEmitter *fluidEmitters);
+
     // Creation functions for different types of matter
-    Body *createRigidBody(QList<Particle *> *verts, QList<SDFData> *sdfData);
-    TotalFluidConstraint *createFluid(QList<Particle *> *particles, double density);
-    GasConstraint *createGas(QList<Particle *> *particles, double density, bool open);
+    Body *createRigidBody(QList<Particle> *verts, QList<SDFData> *sdfData);
+    TotalFluidConstraint *createFluid(QList<Particle> *particles, double density);
+    GasConstraint *createGas(QList<Particle> *particles, double density, bool open);
     void createSmokeEmitter(glm::dvec2 posn, double particlesPerSec, GasConstraint *gs);
     void createFluidEmitter(glm::dvec2 posn, double particlesPerSec, TotalFluidConstraint *fs);
 
+    // The same for count particles already in the store from offset on, so loaders can add
+    // particles in bulk without building temporary lists
+    Body *createRigidBody(int offset, int count, const std::vector<SDFData> &sdfData);
+    TotalFluidConstraint *createFluid(int offset, int count, double density);
+    GasConstraint *createGas(int offset, int count, double density, bool open);
+
     // Simple drawing routines
-    void drawGrid();
-    void drawParticles();
-    void drawBodies();
-    void drawGlobals();
+    void drawGrid(const RenderSnapshot &snapshot);
+    void drawParticles(const RenderSnapshot &snapshot);
+    void drawBodies(const RenderSnapshot &snapshot);
+    void drawGlobals(const RenderSnapshot &snapshot);
     void drawCircle();
-    void drawSmoke();
+    void drawSmoke(const RenderSnapshot &snapshot);
 
     void setColor(int body, float alpha);
 
     // Counts for iterative particle solver
     int *m_counts;
+    int m_solverIterations;
 
     // Storage of global particles, rigid bodies, and general constraints
-    QList<Particle *> m_particles;
+    ParticleStore m_particles;
     QList<Body *> m_bodies;
     QList<OpenSmokeEmitter *> m_smokeEmitters;
     QList<FluidEmitter *> m_fluidEmitters;
     QHash<ConstraintGroup, QList<Constraint *>> m_globalConstraints;
 
+    // This tick's constraints for each group, sorted into per-type batches
+    ConstraintBatches m_batches[NUM_CONSTRAINT_GROUPS];
+
+    // Workers for parallel projection, NULL when solving on a single thread
+    ThreadPool *m_threadPool;
+
+    // Where each tick's particles are recorded, NULL when not recording
+    TrajectoryWriter *m_recorder;
+
+    // Per-slice corrections for Jacobi projection
+    DeltaBuffers m_deltas;
+
+    // Which particles are asleep, bodies left out of this tick's shape constraints for sleeping,
+    // and pairs of particles close enough to join an island
+    Islands m_islands;
+    std::vector<int> m_sleepingBodies;
+    std::vector<glm::ivec2> m_touching;
+
+    // Particles woken during this tick's contact search, and the round each woke in, 0 for none
+    std::vector<int> m_woken;
+    std::vector<int> m_wokenRound;
+
+    // Broad phase for contact detection, rebuilt from the predicted positions every tick
+    SpatialGrid m_grid;
+    std::vector<int> m_candidates;
+
+    // Cells of size H over the positions at the end of each tick, for advecting smoke tracers
+    SpatialGrid m_smokeGrid;
+
+    // Where each tick's time goes
+    TickProfiler m_profiler;
+
+    // Backing memory for the contact and boundary constraints found each tick
+    FrameArena m_frameArena;
+
+    // Neighbors within the kernel radius, shared by all fluid and gas constraints
+    NeighborList m_neighbors;
+
     // Solvers for regular and contact constraints
     Solver m_standardSolver;
     Solver m_contactSolver;
 
+    // Latest state for drawing, filled by the simulating thread and drawn by the GUI thread
+    TripleBuffer<RenderSnapshot> m_snapshots;
+    int m_numTicks;
+
     // Drawing and boundary information
     glm::ivec2 m_dimensions;
     glm::dvec2 m_xBoundaries, m_yBoundaries;
@@ -0,0 +1,90 @@
+#include "simulationthread.h"
+
+#include <algorithm>
+#include <chrono>
+
+SimulationThread::SimulationThread(Simulation *sim)
+    : m_sim(sim), m_quit(false), m_paused(false), m_substeps(STEP_SUBSTEPS) {
+}
+
+SimulationThread::~SimulationThread() {
+    stop();
+}
+
+void SimulationThread::start() {
+    if (m_thread.joinable()) {
+        return;
+    }
+    m_quit = false;
+    m_thread = std::thread(&SimulationThread::run, this);
+}
+
+void SimulationThread::stop() {
+    if (!m_thread.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+    }
+    m_wake.notify_one();
+    m_thread.join();
+    m_commands.clear();
+}
+
+void SimulationThread::post(const std::function<void(Simulation *)> &f) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_commands.push_back(f);
+    }
+    m_wake.notify_one();
+}
+
+void SimulationThread::setPaused(bool paused) {
+    m_paused = paused;
+    m_wake.notify_one();
+}
+
+void SimulationThread::setSubsteps(int substeps) {
+    m_substeps = std::max(1, substeps);
+    post([this](Simulation *) { m_stepper.setSubsteps(m_substeps); });
+}
+
+void SimulationThread::run() {
+    typedef std::chrono::steady_clock Clock;
+
+    std::vector<std::function<void(Simulation *)>> commands;
+    Clock::time_point last = Clock::now();
+    Clock::duration sleep = Clock::duration::zero();
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait_for(lock, sleep, [this] { return m_quit || !m_commands.empty(); });
+            if (m_quit) {
+                return;
+            }
+            commands.swap(m_commands);
+        }
+
+        for (unsigned int i = 0; i < commands.size(); i++) {
+            commands[i](m_sim);
+        }
+        commands.clear();
+
+        Clock::time_point now = Clock::now();
+        double elapsed = std::chrono::duration<double>(now - last).count();
+        last = now;
+
+        if (m_paused) {
+            // Don't make up for time spent paused
+            m_stepper.reset();
+            sleep = std::chrono::milliseconds(SIMULATION_IDLE_MS);
+            continue;
+        }
+
+        // Sleep until the accumulator holds the next whole step
+        m_stepper.advance(m_sim, elapsed);
+        double wait = (1. - m_stepper.getAlpha()) * m_stepper.getTimestep();
+        sleep = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(wait));
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef SIMULATIONTHREAD_H
+#define SIMULATIONTHREAD_H
+
+#include "simulation.h"
+#include "timestepper.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Longest the thread sleeps while paused before checking for commands again, in milliseconds
+#define SIMULATION_IDLE_MS 50
+
+// Runs a simulation on a thread of its own at wall clock speed, so the GUI thread only draws the
+// snapshots it publishes and never waits for a tick. Anything else that touches the simulation,
+// like switching scenes or poking particles, is posted as a command and run between steps.
+class SimulationThread {
+public:
+    SimulationThread(Simulation *sim);
+    virtual ~SimulationThread();
+
+    void start();
+
+    // Finish the current step and join the thread, dropping commands not yet run
+    void stop();
+
+    // Run f on the simulation thread before the next step
+    void post(const std::function<void(Simulation *)> &f);
+
+    // Stop or resume stepping in real time, commands still run while paused
+    void setPaused(bool paused);
+    inline bool isPaused() const { return m_paused; }
+
+    // Substeps each fixed step is split into, see TimeStepper::setSubsteps
+    void setSubsteps(int substeps);
+    inline int getSubsteps() const { return m_substeps; }
+
+private:
+    void run();
+
+    Simulation *m_sim;
+    TimeStepper m_stepper; // only touched by the simulation thread
+
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::vector<std::function<void(Simulation *)>> m_commands;
+    bool m_quit;
+    std::atomic<bool> m_paused;
+    std::atomic<int> m_substeps;
+};
+
+#endif // SIMULATIONTHREAD_H
@@ -0,0 +1,124 @@
+#include "snapshot.h"
+
+#include <algorithm>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define SNAPSHOT_ALIGN 8
+
+static inline size_t padded(size_t size) {
+    return (size + SNAPSHOT_ALIGN - 1) / SNAPSHOT_ALIGN * SNAPSHOT_ALIGN;
+}
+
+SnapshotWriter::SnapshotWriter()
+    : m_file(NULL), m_failed(false) {
+}
+
+SnapshotWriter::~SnapshotWriter() {
+    close();
+}
+
+bool SnapshotWriter::open(const char *path) {
+    close();
+    m_file = fopen(path, "wb");
+    m_failed = m_file == NULL;
+    return !m_failed;
+}
+
+bool SnapshotWriter::close() {
+    if (m_file != NULL) {
+        m_failed |= fclose(m_file) != 0;
+        m_file = NULL;
+    }
+    return !m_failed;
+}
+
+void SnapshotWriter::write(const void *data, size_t size, size_t n) {
+    static const char zeros[SNAPSHOT_ALIGN] = {0};
+    if (m_file == NULL || m_failed) {
+        return;
+    }
+
+    size_t bytes = size * n;
+    if (bytes > 0 && fwrite(data, 1, bytes, m_file) != bytes) {
+        m_failed = true;
+    }
+    if (padded(bytes) > bytes && fwrite(zeros, 1, padded(bytes) - bytes, m_file) != padded(bytes) - bytes) {
+        m_failed = true;
+    }
+}
+
+SnapshotReader::SnapshotReader()
+    : m_data(NULL), m_size(0), m_offset(0), m_header(NULL) {
+}
+
+SnapshotReader::~SnapshotReader() {
+    close();
+}
+
+bool SnapshotReader::open(const char *path) {
+    close();
+
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+        cout << "Could not open snapshot " << path << "." << endl;
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(SnapshotHeader)) {
+        cout << "Snapshot " << path << " is too short." << endl;
+        ::close(fd);
+        return false;
+    }
+
+    // The mapping stays valid after the descriptor is closed
+    void *data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        cout << "Could not map snapshot " << path << "." << endl;
+        return false;
+    }
+    m_data = (const char *)data;
+    m_size = info.st_size;
+
+    // Everything is read front to back exactly once
+    madvise(data, m_size, MADV_SEQUENTIAL);
+
+    m_header = read<SnapshotHeader>(1);
+    if (strncmp(m_header->magic, SNAPSHOT_MAGIC, sizeof(m_header->magic)) != 0) {
+        cout << path << " is not a snapshot." << endl;
+    } else if (m_header->byteOrder != SNAPSHOT_BYTE_ORDER) {
+        cout << "Snapshot " << path << " was written on a machine of the other byte order." << endl;
+    } else if (m_header->version != SNAPSHOT_VERSION) {
+        cout << "Snapshot " << path << " is version " << m_header->version << ", expected "
+             << SNAPSHOT_VERSION << "." << endl;
+    } else {
+        return true;
+    }
+    close();
+    return false;
+}
+
+void SnapshotReader::close() {
+    if (m_data != NULL) {
+        munmap((void *)m_data, m_size);
+    }
+    m_data = NULL;
+    m_size = m_offset = 0;
+    m_header = NULL;
+}
+
+const void *SnapshotReader::read(size_t size, size_t n) {
+    size_t bytes = size * n;
+    if (m_data == NULL || (n > 0 && bytes / n != size) || m_offset + bytes > m_size) {
+        return NULL;
+    }
+
+    const void *out = m_data + m_offset;
+    m_offset = std::min(m_size, m_offset + padded(bytes));
+    return out;
+}
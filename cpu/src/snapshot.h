@@ -0,0 +1,122 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "particle.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+// Snapshot files start with this magic string and version. Bump the version whenever the
+// layout below changes; older snapshots are refused rather than misread.
+#define SNAPSHOT_MAGIC "PBDSNAP"
+#define SNAPSHOT_VERSION 3
+
+// Written as a native integer, so snapshots from a machine of the other byte order are refused
+#define SNAPSHOT_BYTE_ORDER 0x01020304
+
+// Kinds of permanent constraint a snapshot can hold
+enum SnapshotConstraintType {
+    SNAPSHOT_DISTANCE,
+    SNAPSHOT_FLUID,
+    SNAPSHOT_GAS
+};
+
+// A snapshot is the header followed by these sections in order, each padded to 8 bytes:
+//
+//   particle p, ep, v, f            glm::dvec2 x numParticles each
+//   particle imass, tmass, sFriction, kFriction, t
+//                                   double x numParticles each
+//   particle bod, ph                int32_t, Phase x numParticles each
+//   particle sleeping island, rest  int32_t, double x numParticles each
+//   bodies                          SnapshotBody x numBodies
+//   body particles, rs, sdf         int32_t, glm::dvec2, SDFData x numBodyParticles
+//   constraints                     SnapshotConstraint x numConstraints
+//   fluid and gas particles         int32_t x numConstraintParticles
+//   smoke emitters                  SnapshotSmokeEmitter x numSmokeEmitters
+//   smoke emitter particles         Particle x numSmokeParticles
+//   fluid emitters                  SnapshotFluidEmitter x numFluidEmitters
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    int32_t numParticles;
+    int32_t numBodies, numBodyParticles;
+    int32_t numConstraints, numConstraintParticles;
+    int32_t numSmokeEmitters, numSmokeParticles;
+    int32_t numFluidEmitters;
+    glm::dvec2 gravity, xBoundaries, yBoundaries;
+};
+
+struct SnapshotBody {
+    int32_t numParticles, padding;
+    glm::dvec2 center;
+    double angle, imass;
+    glm::dvec2 rotation; // exactly as the last shape match left it, cos and sin of angle can differ
+};
+
+// Constraints are stored in solve order, group by group
+struct SnapshotConstraint {
+    int32_t group, type;
+    int32_t first, second; // particles of a distance, or the start and count of a fluid or gas's particles
+    int32_t flag, padding; // whether a distance is stable or a gas is open
+    double value;          // rest distance or density
+};
+
+struct SnapshotSmokeEmitter {
+    glm::dvec2 posn;
+    double particlesPerSec, timer;
+    int32_t gas; // index of the gas constraint fed, -1 for none
+    int32_t numParticles;
+};
+
+struct SnapshotFluidEmitter {
+    glm::dvec2 posn;
+    double particlesPerSec, timer, totalTimer;
+    int32_t fluid, padding;
+};
+
+// Writes the sections of a snapshot one after another
+class SnapshotWriter {
+public:
+    SnapshotWriter();
+    virtual ~SnapshotWriter();
+
+    bool open(const char *path);
+    bool close();
+
+    // Write n items followed by padding up to the next 8 byte boundary
+    void write(const void *data, size_t size, size_t n);
+    template <typename T>
+    inline void write(const std::vector<T> &v) { write(v.data(), sizeof(T), v.size()); }
+
+private:
+    FILE *m_file;
+    bool m_failed;
+};
+
+// A snapshot mapped read only into memory. Sections are handed out in order as pointers
+// straight into the mapping, so they can be copied into place with no parsing in between.
+class SnapshotReader {
+public:
+    SnapshotReader();
+    virtual ~SnapshotReader();
+
+    // Map a snapshot and check its header, printing why and returning false if it can't be used
+    bool open(const char *path);
+    void close();
+
+    inline const SnapshotHeader &getHeader() const { return *m_header; }
+
+    // The next section of n items, or NULL if the file is too short to hold it
+    const void *read(size_t size, size_t n);
+    template <typename T>
+    inline const T *read(int n) { return (const T *)read(sizeof(T), n); }
+
+private:
+    const char *m_data;
+    size_t m_size, m_offset;
+    const SnapshotHeader *m_header;
+};
+
+#endif // SNAPSHOT_H
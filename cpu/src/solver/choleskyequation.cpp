@@ -0,0 +1,119 @@
+#include "choleskyequation.h"
+
+#include <algorithm>
+
+CholeskyEquation::CholeskyEquation(double regularization)
+    : LinearEquation(), m_factor(NULL), m_regularization(regularization), m_numSymbolic(0), m_numNumeric(0) {
+    cholmod_start(&m_common);
+    m_common.supernodal = CHOLMOD_SUPERNODAL;
+
+    // Semi-definite systems are expected, so don't treat a failed factorization as fatal
+    m_common.error_handler = NULL;
+    m_common.print = 0;
+}
+
+CholeskyEquation::~CholeskyEquation() {
+    cholmod_free_factor(&m_factor, &m_common);
+    cholmod_finish(&m_common);
+}
+
+void CholeskyEquation::setA(const SparseMatrix *A) {
+    LinearEquation::setA(A);
+}
+
+void CholeskyEquation::setA(const CompressedMatrix *A) {
+    LinearEquation::setA(A);
+}
+
+bool CholeskyEquation::factor() {
+    const CompressedMatrix &A = *m_compressed;
+    int n = A.getNumRows();
+
+    // Wrap A without copying, CHOLMOD only reads the lower triangle given stype -1
+    cholmod_sparse sparse;
+    memset(&sparse, 0, sizeof(sparse));
+    sparse.nrow = n;
+    sparse.ncol = n;
+    sparse.nzmax = A.getNumNonZeros();
+    sparse.p = (void *)A.starts.data();
+    sparse.i = (void *)A.indices.data();
+    sparse.x = (void *)A.values.data();
+    sparse.stype = -1;
+    sparse.itype = CHOLMOD_INT;
+    sparse.xtype = CHOLMOD_REAL;
+    sparse.dtype = CHOLMOD_DOUBLE;
+    sparse.sorted = 1;
+    sparse.packed = 1;
+
+    // Only analyze again when the pattern changed
+    bool reuse = m_factor != NULL && (int)m_starts.size() == n + 1 &&
+                 std::equal(A.starts.begin(), A.starts.end(), m_starts.begin()) &&
+                 m_indices.size() == A.indices.size() &&
+                 std::equal(A.indices.begin(), A.indices.end(), m_indices.begin());
+    if (!reuse) {
+        cholmod_free_factor(&m_factor, &m_common);
+        m_factor = cholmod_analyze(&sparse, &m_common);
+        m_numSymbolic++;
+        if (m_factor == NULL) {
+            printf("cholmod_analyze failed: %d\n", m_common.status);
+            m_starts.clear();
+            return false;
+        }
+        m_starts = A.starts;
+        m_indices = A.indices;
+    }
+
+    // Regularize relative to the scale of A
+    double maxDiagonal = 0.;
+    for (int c = 0; c < n; c++) {
+        for (int y = A.starts[c]; y < A.starts[c + 1]; y++) {
+            if (A.indices[y] == c) {
+                maxDiagonal = std::max(maxDiagonal, A.values[y]);
+            }
+        }
+    }
+    double beta[2] = {m_regularization * (maxDiagonal > 0. ? maxDiagonal : 1.), 0.};
+
+    m_numNumeric++;
+    int ok = cholmod_factorize_p(&sparse, beta, NULL, 0, m_factor, &m_common);
+    if (!ok || m_common.status != CHOLMOD_OK) {
+        printf("cholmod_factorize_p failed: %d\n", m_common.status);
+        return false;
+    }
+    return true;
+}
+
+bool CholeskyEquation::solve(const double *b, double *x) {
+    if (m_compressed == NULL) {
+        printf("CholeskyEquation needs A in compressed form\n");
+        return false;
+    }
+
+    if (m_dirty) {
+        if (!factor())
+            return false;
+
+        m_dirty = false;
+    }
+
+    int n = m_compressed->getNumRows();
+    cholmod_dense dense;
+    memset(&dense, 0, sizeof(dense));
+    dense.nrow = n;
+    dense.ncol = 1;
+    dense.nzmax = n;
+    dense.d = n;
+    dense.x = (void *)b;
+    dense.xtype = CHOLMOD_REAL;
+    dense.dtype = CHOLMOD_DOUBLE;
+
+    cholmod_dense *solution = cholmod_solve(CHOLMOD_A, m_factor, &dense, &m_common);
+    if (solution == NULL) {
+        printf("cholmod_solve failed: %d\n", m_common.status);
+        return false;
+    }
+
+    memcpy(x, solution->x, sizeof(double) * n);
+    cholmod_free_dense(&solution, &m_common);
+    return true;
+}
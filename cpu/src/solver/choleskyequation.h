@@ -0,0 +1,44 @@
+#ifndef CHOLESKYEQUATION_H
+#define CHOLESKYEQUATION_H
+
+#include "compressedmatrix.h"
+#include "lineareq.h"
+
+#include <cholmod.h>
+
+// Solves Ax=b for symmetric positive semi-definite A with a supernodal Cholesky factorization
+// from CHOLMOD, factoring A + beta I so rank-deficient systems (redundant or inactive constraints)
+// still factor. beta is the regularization times the largest diagonal entry of A. Like
+// LinearData, the symbolic analysis is kept for as long as A keeps the same sparsity pattern.
+class CholeskyEquation : public LinearEquation {
+public:
+    CholeskyEquation(double regularization = 1e-10);
+    virtual ~CholeskyEquation();
+
+    virtual bool solve(const double *b, double *x);
+
+    // Only kept for the interface, solve fails on an A that isn't in compressed form
+    virtual void setA(const SparseMatrix *A);
+
+    // A must hold both triangles, only the lower one is read
+    virtual void setA(const CompressedMatrix *A);
+
+    inline void setRegularization(double regularization) { m_regularization = regularization; }
+
+    // How many symbolic and numeric factorizations have been run
+    inline int getNumSymbolic() const { return m_numSymbolic; }
+    inline int getNumNumeric() const { return m_numNumeric; }
+
+private:
+    bool factor();
+
+    cholmod_common m_common;
+    cholmod_factor *m_factor;
+    double m_regularization;
+
+    // Pattern the current symbolic analysis was done for
+    std::vector<int> m_starts, m_indices;
+    int m_numSymbolic, m_numNumeric;
+};
+
+#endif // CHOLESKYEQUATION_H
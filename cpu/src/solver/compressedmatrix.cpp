@@ -0,0 +1,43 @@
+#include "compressedmatrix.h"
+
+CompressedMatrix::CompressedMatrix()
+    : m_numRows(0), m_numCols(0) {
+    starts.assign(1, 0);
+}
+
+CompressedMatrix::~CompressedMatrix() {
+}
+
+void CompressedMatrix::reset(int numRows, int numCols) {
+    m_numRows = numRows;
+    m_numCols = numCols;
+    starts.assign(1, 0);
+    indices.clear();
+    values.clear();
+}
+
+void CompressedMatrix::transpose(CompressedMatrix *out) const {
+    out->m_numRows = m_numCols;
+    out->m_numCols = m_numRows;
+
+    // Count the entries in each column, then turn the counts into row starts of the transpose
+    out->starts.assign(m_numCols + 1, 0);
+    for (unsigned int x = 0; x < indices.size(); x++) {
+        out->starts[indices[x] + 1]++;
+    }
+    for (int c = 0; c < m_numCols; c++) {
+        out->starts[c + 1] += out->starts[c];
+    }
+
+    // Walking our rows in order leaves every row of the transpose sorted
+    out->indices.resize(indices.size());
+    out->values.resize(values.size());
+    std::vector<int> next(out->starts.begin(), out->starts.end() - 1);
+    for (int r = 0; r < m_numRows; r++) {
+        for (int x = starts[r]; x < starts[r + 1]; x++) {
+            int dest = next[indices[x]]++;
+            out->indices[dest] = r;
+            out->values[dest] = values[x];
+        }
+    }
+}
@@ -0,0 +1,38 @@
+#ifndef COMPRESSEDMATRIX_H
+#define COMPRESSEDMATRIX_H
+
+#include <vector>
+
+// A sparse matrix stored as flat compressed rows. Row r holds the entries indices[starts[r]] to
+// indices[starts[r + 1] - 1] with their values, sorted by column. Read the other way around, the
+// same arrays hold the transpose in compressed column form, which is what UMFPACK expects.
+class CompressedMatrix {
+public:
+    CompressedMatrix();
+    virtual ~CompressedMatrix();
+
+    // Empty the matrix, keeping its allocations for the next assembly
+    void reset(int numRows, int numCols);
+
+    // Rows are filled in order, appending entries by increasing column and then closing the row
+    inline void append(int col, double value) {
+        indices.push_back(col);
+        values.push_back(value);
+    }
+    inline void endRow() { starts.push_back(indices.size()); }
+
+    inline int getNumRows() const { return m_numRows; }
+    inline int getNumCols() const { return m_numCols; }
+    inline int getNumNonZeros() const { return indices.size(); }
+
+    // Fill out with the transpose of this matrix, in O(nnz)
+    void transpose(CompressedMatrix *out) const;
+
+    std::vector<int> starts, indices;
+    std::vector<double> values;
+
+private:
+    int m_numRows, m_numCols;
+};
+
+#endif // COMPRESSEDMATRIX_H
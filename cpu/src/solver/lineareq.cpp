@@ -48,6 +48,17 @@ struct SparseMatrixElement {
     }
 };
 
+// FNV-1a over the column starts and row indices
+static unsigned long long hashPattern(unsigned n, unsigned nElements, const int *Ap, const int *Ai) {
+    unsigned long long hash = 14695981039346656037ull;
+    hash = (hash ^ n) * 1099511628211ull;
+    for (unsigned i = 0; i <= n; ++i)
+        hash = (hash ^ (unsigned)Ap[i]) * 1099511628211ull;
+    for (unsigned i = 0; i < nElements; ++i)
+        hash = (hash ^ (unsigned)Ai[i]) * 1099511628211ull;
+    return hash;
+}
+
 void LinearData::clean() {
     umfpack_di_free_symbolic(&symbolic);
     umfpack_di_free_numeric(&numeric);
@@ -57,17 +68,41 @@ void LinearData::clean() {
         delete[] Ai;
     if (Ax)
         delete[] Ax;
+
+    Ap = NULL;
+    Ai = NULL;
+    Ax = NULL;
+    n = 0;
+    nElements = 0;
+    nCapacity = 0;
+    elementCapacity = 0;
+    patternHash = 0;
 }
 
 void LinearData::init(unsigned n_, unsigned nElements_) {
-    clean();
+    umfpack_di_free_symbolic(&symbolic);
+    umfpack_di_free_numeric(&numeric);
+    patternHash = 0;
 
     n = n_;
     nElements = nElements_;
 
-    Ap = new int[n + 1];
-    Ai = new int[nElements];
-    Ax = new double[nElements];
+    if (n + 1 > nCapacity) {
+        if (Ap)
+            delete[] Ap;
+        nCapacity = n + 1;
+        Ap = new int[nCapacity];
+    }
+
+    if (nElements > elementCapacity || !Ai) {
+        if (Ai)
+            delete[] Ai;
+        if (Ax)
+            delete[] Ax;
+        elementCapacity = nElements > 0 ? nElements : 1;
+        Ai = new int[elementCapacity];
+        Ax = new double[elementCapacity];
+    }
 }
 
 bool LinearData::init(const SparseMatrix &A) {
@@ -84,39 +119,60 @@ bool LinearData::init(const SparseMatrix &A) {
     }
 
     std::sort(temp.begin(), temp.end());
-    init(A.getN(), temp.size());
-
-    Ap[0] = 0;
-    Ap[1] = 0;
-
-    unsigned cur = 1;
-    unsigned index = 0;
 
     // convert the sparse data into the format umfpack expects
+    vector<int> starts(A.getN() + 1, 0), rows(temp.size());
+    vector<double> values(temp.size());
     for (unsigned i = 0; i < temp.size(); ++i) {
-        const SparseMatrixElement &element = temp[i];
+        ++starts[temp[i].col + 1];
+        rows[i] = temp[i].row;
+        values[i] = temp[i].value;
+    }
+    for (int c = 0; c < A.getN(); ++c)
+        starts[c + 1] += starts[c];
 
-        Ax[index] = element.value;
-        Ai[index] = element.row;
-        ++index;
+    return init(A.getN(), temp.size(), starts.data(), rows.data(), values.data());
+}
 
-        if (element.col == cur) {
-            ++cur;
-            Ap[cur] = Ap[cur - 1];
-        }
+bool LinearData::init(const CompressedMatrix &A) {
+    return init(A.getNumRows(), A.getNumNonZeros(), A.starts.data(), A.indices.data(), A.values.data());
+}
+
+bool LinearData::init(unsigned n_, unsigned nElements_, const int *Ap_, const int *Ai_, const double *Ax_) {
+    unsigned long long hash = hashPattern(n_, nElements_, Ap_, Ai_);
+
+    // A matching hash is confirmed against the stored pattern, so a collision only costs
+    // a fresh analysis
+    bool reuse = symbolic != NULL && hash == patternHash &&
+                 (int)n_ == n && (int)nElements_ == nElements &&
+                 std::equal(Ap_, Ap_ + n + 1, Ap) && std::equal(Ai_, Ai_ + nElements, Ai);
 
-        ++Ap[cur];
+    if (!reuse) {
+        init(n_, nElements_);
+        std::copy(Ap_, Ap_ + n + 1, Ap);
+        std::copy(Ai_, Ai_ + nElements, Ai);
+        patternHash = hash;
     }
+    std::copy(Ax_, Ax_ + nElements, Ax);
 
+    return factor(!reuse);
+}
+
+bool LinearData::factor(bool analyze) {
     int status = UMFPACK_OK;
     bool ret = true;
 
-    status = umfpack_di_symbolic(n, n, Ap, Ai, Ax, &symbolic, NULL, NULL);
-    if (status != UMFPACK_OK) {
-        ret = false;
-        printf("umfpack_di_symbolic failed: %d\n", status);
+    if (analyze) {
+        ++numSymbolic;
+        status = umfpack_di_symbolic(n, n, Ap, Ai, Ax, &symbolic, NULL, NULL);
+        if (status != UMFPACK_OK) {
+            ret = false;
+            printf("umfpack_di_symbolic failed: %d\n", status);
+        }
     }
 
+    ++numNumeric;
+    umfpack_di_free_numeric(&numeric);
     status = umfpack_di_numeric(Ap, Ai, Ax, symbolic, &numeric, NULL, NULL);
     if (status != UMFPACK_OK) {
         ret = false;
@@ -128,12 +184,19 @@ bool LinearData::init(const SparseMatrix &A) {
 
 void LinearEquation::setA(const SparseMatrix *A) {
     m_A = A;
+    m_compressed = NULL;
+    m_dirty = true;
+}
+
+void LinearEquation::setA(const CompressedMatrix *A) {
+    m_A = NULL;
+    m_compressed = A;
     m_dirty = true;
 }
 
 bool LinearEquation::solve(const double *b, double *x) {
     if (m_dirty) {
-        if (!m_data.init(*m_A))
+        if (m_compressed ? !m_data.init(*m_compressed) : !m_data.init(*m_A))
             return false;
 
         m_dirty = false;
@@ -16,6 +16,7 @@
 #ifndef LINEAREQ_H
 #define LINEAREQ_H
 
+#include "compressedmatrix.h"
 #include "matrix.h"
 
 /**
@@ -35,9 +36,20 @@ struct LinearData {
     void *symbolic;
     void *numeric;
 
+    // Hash of the sparsity pattern symbolic was computed for, and the sizes Ap and Ai/Ax
+    // were allocated with
+    unsigned long long patternHash;
+    int nCapacity;
+    int elementCapacity;
+
+    // How many symbolic and numeric factorizations have been run
+    int numSymbolic;
+    int numNumeric;
+
     inline LinearData()
         : n(0), nElements(0), Ap(NULL), Ai(NULL), Ax(NULL),
-          symbolic(NULL), numeric(NULL) {}
+          symbolic(NULL), numeric(NULL), patternHash(0), nCapacity(0),
+          elementCapacity(0), numSymbolic(0), numNumeric(0) {}
 
     ~LinearData() {
         clean();
@@ -46,7 +58,18 @@ struct LinearData {
     void clean();
 
     bool init(const SparseMatrix &A);
+    bool init(const CompressedMatrix &A);
+
+    // Factor the n_ x n_ matrix given in compressed column form. When its sparsity pattern
+    // matches the last one, the symbolic analysis is kept and only the numeric
+    // factorization is redone.
+    bool init(unsigned n_, unsigned nElements_, const int *Ap_, const int *Ai_, const double *Ax_);
+
+    // Drop any factorization and size Ap, Ai and Ax, keeping the old arrays if they fit
     void init(unsigned n_, unsigned nElements_);
+
+    // Run the numeric factorization of the current Ap, Ai and Ax, and the symbolic one first if asked
+    bool factor(bool analyze);
 };
 
 class LinearEquation {
@@ -54,11 +77,11 @@ public:
     typedef shared_ptr<LinearEquation> Ref;
 
     inline LinearEquation(const SparseMatrix *A)
-        : m_A(A), m_dirty(true) {
+        : m_A(A), m_compressed(NULL), m_dirty(true) {
     }
 
     LinearEquation()
-        : m_A(NULL), m_dirty(true) {}
+        : m_A(NULL), m_compressed(NULL), m_dirty(true) {}
 
     /**
      * @brief
@@ -120,9 +143,17 @@ public:
      */
     virtual void setA(const SparseMatrix *A);
 
+    /**
+     * @brief
+     *    Same as setA above, but with A already in compressed column form
+     * (column c's row indices in A->indices[A->starts[c]] onwards, sorted),
+     * which skips converting A on every factorization
+     */
+    virtual void setA(const CompressedMatrix *A);
+
     /**
      * @returns the currently set 'A' which will be used in calls to
-     *    solve(b, x) for Ax=b
+     *    solve(b, x) for Ax=b, or NULL if A was set in compressed form
      *
      * @note getLinearData optionally returns the cached LU decomposition
      *    of A in UMFPack format iff the cache is not dirty (iff solve has
@@ -145,6 +176,7 @@ public:
 
 protected:
     const SparseMatrix *m_A;
+    const CompressedMatrix *m_compressed;
 
     LinearData m_data;
     bool m_dirty;
@@ -0,0 +1,173 @@
+#include "pcgequation.h"
+
+#include <math.h>
+
+PCGEquation::PCGEquation(double tolerance, int maxIterations)
+    : LinearEquation(), m_J(NULL), m_JT(NULL), m_invM(NULL), m_tolerance(tolerance),
+      m_maxIterations(maxIterations), m_iterations(0), m_residual(0) {
+}
+
+PCGEquation::~PCGEquation() {
+}
+
+void PCGEquation::setA(const SparseMatrix *A) {
+    LinearEquation::setA(A);
+    m_J = NULL;
+    m_JT = NULL;
+    m_invM = NULL;
+}
+
+void PCGEquation::setA(const CompressedMatrix *A) {
+    LinearEquation::setA(A);
+    m_J = NULL;
+    m_JT = NULL;
+    m_invM = NULL;
+}
+
+void PCGEquation::setOperator(const CompressedMatrix *J, const CompressedMatrix *JT, const double *invM) {
+    m_A = NULL;
+    m_compressed = NULL;
+    m_J = J;
+    m_JT = JT;
+    m_invM = invM;
+    m_dirty = true;
+}
+
+void PCGEquation::apply(const double *x, double *out) {
+    if (m_J == NULL) {
+        int n = m_compressed->getNumRows();
+        memset(out, 0, sizeof(double) * n);
+        for (int c = 0; c < n; c++) {
+            for (int y = m_compressed->starts[c]; y < m_compressed->starts[c + 1]; y++) {
+                out[m_compressed->indices[y]] += m_compressed->values[y] * x[c];
+            }
+        }
+        return;
+    }
+
+    // temp = M^-1 J^T x, one entry per particle coordinate
+    int numCoords = m_JT->getNumRows();
+    m_temp.resize(numCoords);
+    for (int d = 0; d < numCoords; d++) {
+        double sum = 0.;
+        if (m_invM[d] != 0.) {
+            for (int y = m_JT->starts[d]; y < m_JT->starts[d + 1]; y++) {
+                sum += m_JT->values[y] * x[m_JT->indices[y]];
+            }
+        }
+        m_temp[d] = m_invM[d] * sum;
+    }
+
+    // out = J temp
+    for (int k = 0; k < m_J->getNumRows(); k++) {
+        double sum = 0.;
+        for (int y = m_J->starts[k]; y < m_J->starts[k + 1]; y++) {
+            sum += m_J->values[y] * m_temp[m_J->indices[y]];
+        }
+        out[k] = sum;
+    }
+}
+
+void PCGEquation::setupPreconditioner(int n) {
+    m_invDiag.assign(n, 0.);
+
+    if (m_J == NULL) {
+        for (int c = 0; c < n; c++) {
+            for (int y = m_compressed->starts[c]; y < m_compressed->starts[c + 1]; y++) {
+                if (m_compressed->indices[y] == c) {
+                    m_invDiag[c] = m_compressed->values[y];
+                }
+            }
+        }
+    } else {
+        for (int k = 0; k < n; k++) {
+            for (int y = m_J->starts[k]; y < m_J->starts[k + 1]; y++) {
+                double v = m_J->values[y];
+                m_invDiag[k] += v * v * m_invM[m_J->indices[y]];
+            }
+        }
+    }
+
+    for (int k = 0; k < n; k++) {
+        m_invDiag[k] = m_invDiag[k] > 0. ? 1. / m_invDiag[k] : 0.;
+    }
+}
+
+bool PCGEquation::solve(const double *b, double *x) {
+    if (m_J == NULL && m_compressed == NULL) {
+        printf("PCGEquation needs A in compressed form or as an operator\n");
+        return false;
+    }
+
+    int n = m_J ? m_J->getNumRows() : m_compressed->getNumRows();
+
+    // The preconditioner only changes along with A
+    if (m_dirty) {
+        setupPreconditioner(n);
+        m_dirty = false;
+    }
+
+    m_r.resize(n);
+    m_z.resize(n);
+    m_p.resize(n);
+    m_Ap.resize(n);
+
+    double bNorm = 0.;
+    for (int k = 0; k < n; k++) {
+        bNorm += b[k] * b[k];
+    }
+    bNorm = sqrt(bNorm);
+
+    m_iterations = 0;
+    if (bNorm == 0.) {
+        memset(x, 0, sizeof(double) * n);
+        m_residual = 0.;
+        return true;
+    }
+
+    // r = b - Ax from the warm start, z = P^-1 r
+    apply(x, m_Ap.data());
+    double rz = 0., rNorm = 0.;
+    for (int k = 0; k < n; k++) {
+        m_r[k] = b[k] - m_Ap[k];
+        m_z[k] = m_invDiag[k] * m_r[k];
+        m_p[k] = m_z[k];
+        rz += m_r[k] * m_z[k];
+        rNorm += m_r[k] * m_r[k];
+    }
+    m_residual = sqrt(rNorm) / bNorm;
+
+    while (m_residual > m_tolerance && m_iterations < m_maxIterations && rz > 0.) {
+        apply(m_p.data(), m_Ap.data());
+        double pAp = 0.;
+        for (int k = 0; k < n; k++) {
+            pAp += m_p[k] * m_Ap[k];
+        }
+
+        // A is only semi-definite, so stop once the search direction is in its null space
+        if (pAp <= 0.) {
+            break;
+        }
+
+        double alpha = rz / pAp, rzNext = 0.;
+        rNorm = 0.;
+        for (int k = 0; k < n; k++) {
+            x[k] += alpha * m_p[k];
+            m_r[k] -= alpha * m_Ap[k];
+            m_z[k] = m_invDiag[k] * m_r[k];
+            rzNext += m_r[k] * m_z[k];
+            rNorm += m_r[k] * m_r[k];
+        }
+
+        double beta = rzNext / rz;
+        rz = rzNext;
+        for (int k = 0; k < n; k++) {
+            m_p[k] = m_z[k] + beta * m_p[k];
+        }
+
+        m_residual = sqrt(rNorm) / bNorm;
+        m_iterations++;
+    }
+
+    return m_residual <= m_tolerance;
+}
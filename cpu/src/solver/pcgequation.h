@@ -0,0 +1,52 @@
+#ifndef PCGEQUATION_H
+#define PCGEQUATION_H
+
+#include "compressedmatrix.h"
+#include "lineareq.h"
+
+// Solves Ax=b with Jacobi-preconditioned conjugate gradient instead of factoring A. A is either given
+// explicitly in compressed column form through setA, or left implicit as A = J M^-1 J^T through
+// setOperator, in which case it is applied as J (M^-1 (J^T x)) and never formed. Either way A must be
+// symmetric positive (semi-)definite, and memory stays linear in the size of J.
+class PCGEquation : public LinearEquation {
+public:
+    PCGEquation(double tolerance = 1e-10, int maxIterations = 100);
+    virtual ~PCGEquation();
+
+    // x holds the starting guess on entry, usually the previous solution, and the answer on return.
+    // Returns whether the residual dropped below tolerance * |b| within the iteration cap.
+    virtual bool solve(const double *b, double *x);
+
+    // A SparseMatrix is not supported, solve reports it and fails until A is set another way
+    virtual void setA(const SparseMatrix *A);
+    virtual void setA(const CompressedMatrix *A);
+
+    // Use A = J M^-1 J^T, with J and its transpose in compressed rows and the diagonal of M^-1
+    void setOperator(const CompressedMatrix *J, const CompressedMatrix *JT, const double *invM);
+
+    inline void setTolerance(double tolerance) { m_tolerance = tolerance; }
+    inline void setMaxIterations(int maxIterations) { m_maxIterations = maxIterations; }
+
+    // How the last solve went
+    inline int getIterations() const { return m_iterations; }
+    inline double getResidual() const { return m_residual; }
+
+private:
+    // out = A x
+    void apply(const double *x, double *out);
+
+    // Inverse of the diagonal of A, or zero for empty rows
+    void setupPreconditioner(int n);
+
+    const CompressedMatrix *m_J, *m_JT;
+    const double *m_invM;
+
+    double m_tolerance;
+    int m_maxIterations;
+    int m_iterations;
+    double m_residual;
+
+    std::vector<double> m_r, m_z, m_p, m_Ap, m_temp, m_invDiag;
+};
+
+#endif // PCGEQUATION_H
@@ -1,6 +1,11 @@
 #include "solver.h"
 
-Solver::Solver() {
+#include "tracewriter.h"
+
+#include <algorithm>
+
+Solver::Solver()
+    : m_backend(SOLVER_BACKEND), m_cg(CG_TOLERANCE, CG_MAX_ITERATIONS), m_cholesky(CHOLESKY_REGULARIZATION) {
     m_b = new double[2];
     m_gamma = new double[2];
     m_nCons = -1;
@@ -21,19 +26,18 @@ int Solver::getCount(int idx) {
     return m_counts[idx];
 }
 
-void Solver::setupM(QList<Particle *> *particles, bool contact) {
-    m_invM.reset(particles->size() * 2, particles->size() * 2);
+void Solver::setupM(ParticleStore *particles, bool contact) {
+    m_invM.resize(particles->size() * 2);
     for (int i = 0; i < particles->size(); i++) {
 
         // Down the diagonal
-        Particle *p = particles->at(i);
-        m_invM.setValue(2 * i, 2 * i, contact ? p->tmass : p->imass);
-        m_invM.setValue(2 * i + 1, 2 * i + 1, contact ? p->tmass : p->imass);
+        double m = contact ? particles->tmass[i] : particles->imass[i];
+        m_invM[2 * i] = m;
+        m_invM[2 * i + 1] = m;
     }
 }
 
 void Solver::setupSizes(int numParts, QList<Constraint *> *constraints) {
-    bool change = true;
     int numCons = constraints->size();
 
     // Only update some things if the number of particles changed
@@ -43,7 +47,6 @@ void Solver::setupSizes(int numParts, QList<Constraint *> *constraints) {
         delete[] m_counts;
         m_dp = new double[m_nParts * 2];
         m_counts = new int[m_nParts];
-        change = true;
     }
 
     // Update how many constraints affect each particle
@@ -60,68 +63,133 @@ void Solver::setupSizes(int numParts, QList<Constraint *> *constraints) {
         delete[] m_gamma;
         m_b = new double[m_nCons];
         m_gamma = new double[m_nCons];
-        change = true;
-    }
 
-    if (change) {
-        m_JT.reset(m_nParts * 2, m_nCons);
+        // Nothing to warm start from
+        memset(m_gamma, 0, sizeof(double) * m_nCons);
     }
 }
 
-void Solver::solveAndUpdate(QList<Particle *> *particles, QList<Constraint *> *constraints, bool stable) {
-    if (constraints->size() == 0) {
-        return;
+void Solver::assembleJacobian(ParticleStore *particles, QList<Constraint *> *constraints) {
+    m_J.reset(constraints->size(), particles->size() * 2);
+
+    for (int j = 0; j < constraints->size(); j++) {
+        Constraint *cons = constraints->at(j);
+
+        // Update b
+        m_b[j] = -cons->evaluate(particles);
+
+        // Only the particles in the stencil can have nonzero gradients, kept in column order
+        m_stencil.clear();
+        cons->getStencil(&m_stencil);
+        std::sort(m_stencil.begin(), m_stencil.end());
+
+        for (unsigned int s = 0; s < m_stencil.size(); s++) {
+            int i = m_stencil[s];
+            glm::vec2 grad_ji = cons->gradient(particles, i);
+            if (grad_ji.x != 0.) {
+                m_J.append(2 * i, grad_ji.x);
+            }
+            if (grad_ji.y != 0.) {
+                m_J.append(2 * i + 1, grad_ji.y);
+            }
+        }
+        m_J.endRow();
     }
 
-    // Reset J^T and b
-    bool updated = false;
+    m_J.transpose(&m_JT);
+}
 
-    // Loop!
-    for (int i = 0; i < particles->size(); i++) {
-        for (int j = 0; j < constraints->size(); j++) {
-            Constraint *cons = constraints->at(j);
+void Solver::assembleSystem() {
+    int numCons = m_J.getNumRows();
+    m_A.reset(numCons, numCons);
+    m_column.assign(numCons, 0.);
+    m_marks.assign(numCons, -1);
+
+    // Column k of A is the sum over the coordinates d constraint k touches of
+    // (J_kd * M^-1_d) times column d of J^T, the constraints sharing that coordinate
+    std::vector<int> rows;
+    for (int k = 0; k < numCons; k++) {
+        rows.clear();
+        for (int x = m_J.starts[k]; x < m_J.starts[k + 1]; x++) {
+            int d = m_J.indices[x];
+            if (m_invM[d] == 0.) {
+                continue;
+            }
 
-            // Update b
-            if (!updated) {
-                m_b[j] = -cons->evaluate(particles);
+            double weighted = m_J.values[x] * m_invM[d];
+            for (int y = m_JT.starts[d]; y < m_JT.starts[d + 1]; y++) {
+                int j = m_JT.indices[y];
+                if (m_marks[j] != k) {
+                    m_marks[j] = k;
+                    m_column[j] = 0.;
+                    rows.push_back(j);
+                }
+                m_column[j] += weighted * m_JT.values[y];
             }
-            glm::vec2 grad_ji = cons->gradient(particles, i);
-            m_JT.setValue(2 * i, j, grad_ji.x);
-            m_JT.setValue(2 * i + 1, j, grad_ji.y);
         }
-        updated = true;
+
+        std::sort(rows.begin(), rows.end());
+        for (unsigned int r = 0; r < rows.size(); r++) {
+            m_A.append(rows[r], m_column[rows[r]]);
+        }
+        m_A.endRow();
     }
+}
 
-    SparseMatrix temp = m_invM * m_JT;
-    m_A = m_JT.getTranspose() * temp;
-    // m_JT.printMatrix(4,false);
-    m_eq.setA(&m_A);
-    // cout << endl;
-    // for (int i = 0; i < particles->size(); i++) {
-    //     printf("%.4f\n", m_b[i]);
-    // }
-    bool result = m_eq.solve(m_b, m_gamma);
+void Solver::solveAndUpdate(ParticleStore *particles, QList<Constraint *> *constraints, bool stable) {
+    if (constraints->size() == 0) {
+        return;
+    }
+
+    assembleJacobian(particles, constraints);
+
+    bool result;
+    if (m_backend == CG_SOLVER) {
+        m_cg.setOperator(&m_J, &m_JT, m_invM.data());
+        TraceScope trace("linear solve", "solver");
+        result = m_cg.solve(m_b, m_gamma);
+    } else {
+        assembleSystem();
+
+        LinearEquation *eq = m_backend == CHOLESKY_SOLVER ? &m_cholesky : &m_eq;
+        eq->setA(&m_A);
+        // cout << endl;
+        // for (int i = 0; i < particles->size(); i++) {
+        //     printf("%.4f\n", m_b[i]);
+        // }
+        TraceScope trace("linear solve", "solver");
+        result = eq->solve(m_b, m_gamma);
+    }
     // cout << result << endl;
     // for (int i = 0; i < particles->size(); i++) {
     //     printf("%.4f\n", m_gamma[i]);
     // }
     // cout << endl;
-    temp.multiply(m_dp, m_gamma, particles->size() * 2, 1);
+
+    // dp = M^-1 J^T gamma
+    for (int d = 0; d < particles->size() * 2; d++) {
+        double dp = 0.;
+        if (m_invM[d] != 0.) {
+            for (int y = m_JT.starts[d]; y < m_JT.starts[d + 1]; y++) {
+                dp += m_JT.values[y] * m_invM[d] * m_gamma[m_JT.indices[y]];
+            }
+        }
+        m_dp[d] = dp;
+    }
 
     for (int i = 0; i < particles->size(); i++) {
-        Particle *p = particles->at(i);
         int n = m_counts[i];
         double mult = n > 0 ? (RELAXATION_PARAMETER / (double)n) : 0.,
                dx = m_dp[2 * i] * mult,
                dy = m_dp[2 * i + 1] * mult;
         // cout << dx << " " << dy << endl;
 
-        p->ep.x += (fabs(dx) > EPSILON ? dx : 0);
-        p->ep.y += (fabs(dy) > EPSILON ? dy : 0);
+        particles->ep[i].x += (fabs(dx) > EPSILON ? dx : 0);
+        particles->ep[i].y += (fabs(dy) > EPSILON ? dy : 0);
 
         if (stable) {
-            p->p.x += (fabs(dx) > EPSILON ? dx : 0);
-            p->p.y += (fabs(dy) > EPSILON ? dy : 0);
+            particles->p[i].x += (fabs(dx) > EPSILON ? dx : 0);
+            particles->p[i].y += (fabs(dy) > EPSILON ? dy : 0);
         }
     }
 }
@@ -1,28 +1,69 @@
 #ifndef SOLVER_H
 #define SOLVER_H
 
+#include "choleskyequation.h"
+#include "compressedmatrix.h"
 #include "lineareq.h"
-#include "matrix.h"
-#include "particle.h"
+#include "particlestore.h"
+#include "pcgequation.h"
 
 #define RELAXATION_PARAMETER 1.
 
+// Ways of solving J M^-1 J^T gamma = b
+enum SolverBackend {
+    LU_SOLVER,       // UMFPACK LU factorization of A
+    CG_SOLVER,       // matrix-free conjugate gradient, never forming A
+    CHOLESKY_SOLVER, // CHOLMOD supernodal Cholesky factorization of A
+    NUM_SOLVER_BACKENDS
+};
+
+// Backend new solvers start out with
+#define SOLVER_BACKEND LU_SOLVER
+
+// Conjugate gradient starts from the previous gamma and stops at the tolerance (relative to |b|)
+// or iteration cap
+#define CG_TOLERANCE 1e-8
+#define CG_MAX_ITERATIONS 100
+
+// Cholesky factors A + beta I, with beta this times the largest diagonal entry of A
+#define CHOLESKY_REGULARIZATION 1e-10
+
 class Solver {
 public:
     Solver();
     virtual ~Solver();
 
-    SparseMatrix m_invM, m_JT, m_A;
+    // Diagonal of M^-1, one entry per particle coordinate
+    std::vector<double> m_invM;
+
+    // The Jacobian J by rows (one per constraint) and by columns (one per particle coordinate),
+    // and A = J M^-1 J^T in compressed column form
+    CompressedMatrix m_J, m_JT, m_A;
+    std::vector<int> m_stencil;
+    std::vector<double> m_column;
+    std::vector<int> m_marks;
+
     double *m_b, *m_gamma, *m_dp;
     int *m_counts;
     int m_nParts, m_nCons;
+    SolverBackend m_backend;
     LinearEquation m_eq;
+    PCGEquation m_cg;
+    CholeskyEquation m_cholesky;
 
     int getCount(int idx);
+    inline void setBackend(SolverBackend backend) { m_backend = backend; }
 
-    void setupM(QList<Particle *> *particles, bool contact = false);
+    void setupM(ParticleStore *particles, bool contact = false);
     void setupSizes(int numParts, QList<Constraint *> *constraints);
-    void solveAndUpdate(QList<Particle *> *particles, QList<Constraint *> *constraints, bool stable = false);
+    void solveAndUpdate(ParticleStore *particles, QList<Constraint *> *constraints, bool stable = false);
+
+private:
+    // Evaluate every constraint into b and fill J from the gradients over each constraint's stencil
+    void assembleJacobian(ParticleStore *particles, QList<Constraint *> *constraints);
+
+    // A = J M^-1 J^T, built a column at a time from the particle coordinates each constraint touches
+    void assembleSystem();
 };
 
 #endif // SOLVER_H
@@ -0,0 +1,101 @@
+#include "spatialgrid.h"
+
+SpatialGrid::SpatialGrid(double cellSize)
+    : m_cellSize(cellSize), m_gridSize(glm::ivec2(1, 1)), m_numCells(0), m_numParticles(0) {
+}
+
+SpatialGrid::~SpatialGrid() {
+}
+
+void SpatialGrid::build(const std::vector<glm::dvec2> &positions) {
+    m_numParticles = positions.size();
+    if (m_numParticles == 0) {
+        return;
+    }
+
+    // Fit the grid around the particles, with a one cell margin on every side
+    glm::dvec2 lo = glm::dvec2(INFINITY, INFINITY), hi = glm::dvec2(-INFINITY, -INFINITY);
+    for (int i = 0; i < m_numParticles; i++) {
+        lo = glm::min(lo, positions[i]);
+        hi = glm::max(hi, positions[i]);
+    }
+    m_origin = glm::floor(lo / m_cellSize) * m_cellSize - m_cellSize;
+
+    // Round each dimension up to a power of 2, anything past the cap wraps around
+    glm::dvec2 want = (hi - m_origin) / m_cellSize + 2.;
+    m_gridSize = glm::ivec2(1, 1);
+    while (m_gridSize.x < MAX_GRID_DIM && m_gridSize.x < want.x) {
+        m_gridSize.x <<= 1;
+    }
+    while (m_gridSize.y < MAX_GRID_DIM && m_gridSize.y < want.y) {
+        m_gridSize.y <<= 1;
+    }
+
+    m_numCells = m_gridSize.x * m_gridSize.y;
+    m_cellStart.assign(m_numCells, EMPTY_CELL);
+    m_cellEnd.assign(m_numCells, 0);
+
+    calcHash(positions);
+    sortParticles();
+    findCellStart();
+}
+
+void SpatialGrid::getCandidates(const glm::dvec2 &pos, double radius, std::vector<int> *out) const {
+    forEachCandidate(pos, radius, [out](int j) { out->push_back(j); });
+}
+
+// Calculate the grid hash value for each particle
+void SpatialGrid::calcHash(const std::vector<glm::dvec2> &positions) {
+    m_unsortedHash.resize(m_numParticles);
+    m_unsortedIndex.resize(m_numParticles);
+
+    for (int i = 0; i < m_numParticles; i++) {
+        m_unsortedHash[i] = calcGridHash(calcGridPos(positions[i]));
+        m_unsortedIndex[i] = i;
+    }
+}
+
+// Counting sort by hash, which keeps particles in index order within each cell.
+// m_cellEnd is borrowed as the per-cell counter and is rebuilt afterwards.
+void SpatialGrid::sortParticles() {
+    m_particleHash.resize(m_numParticles);
+    m_particleIndex.resize(m_numParticles);
+
+    for (int i = 0; i < m_numParticles; i++) {
+        m_cellEnd[m_unsortedHash[i]]++;
+    }
+
+    unsigned int offset = 0;
+    for (int c = 0; c < m_numCells; c++) {
+        unsigned int count = m_cellEnd[c];
+        m_cellEnd[c] = offset;
+        offset += count;
+    }
+
+    for (int i = 0; i < m_numParticles; i++) {
+        unsigned int slot = m_cellEnd[m_unsortedHash[i]]++;
+        m_particleHash[slot] = m_unsortedHash[i];
+        m_particleIndex[slot] = m_unsortedIndex[i];
+    }
+}
+
+// Find the start and end of each cell in the sorted hash array
+void SpatialGrid::findCellStart() {
+    for (int index = 0; index < m_numParticles; index++) {
+        unsigned int hash = m_particleHash[index];
+
+        // If this particle has a different cell index to the previous particle then it must
+        // be the first particle in the cell, and the end of the previous particle's cell
+        if (index == 0 || hash != m_particleHash[index - 1]) {
+            m_cellStart[hash] = index;
+
+            if (index > 0) {
+                m_cellEnd[m_particleHash[index - 1]] = index;
+            }
+        }
+
+        if (index == m_numParticles - 1) {
+            m_cellEnd[hash] = index + 1;
+        }
+    }
+}
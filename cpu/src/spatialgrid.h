@@ -0,0 +1,98 @@
+#ifndef SPATIALGRID_H
+#define SPATIALGRID_H
+
+#include "particlestore.h"
+
+#include <vector>
+
+// Largest number of cells along either axis before the grid wraps around
+#define MAX_GRID_DIM 512
+
+// Marks a cell with no particles in it
+#define EMPTY_CELL 0xffffffff
+
+// Uniform grid over particle positions, rebuilt every tick. Follows the same
+// calcHash / sort / cellStart / cellEnd pipeline as the GPU build: particles are
+// hashed to cells, sorted by hash, and each cell remembers the range it occupies
+// in the sorted order.
+class SpatialGrid {
+public:
+    SpatialGrid(double cellSize = PARTICLE_DIAM);
+    virtual ~SpatialGrid();
+
+    // Rebuild the grid from a set of particle positions
+    void build(const std::vector<glm::dvec2> &positions);
+
+    // Call f(j) for every particle index j whose cell lies within radius of pos.
+    // Candidates still need an exact distance check.
+    template <typename F>
+    void forEachCandidate(const glm::dvec2 &pos, double radius, F f) const;
+
+    // Append all candidate indices within radius of pos to out
+    void getCandidates(const glm::dvec2 &pos, double radius, std::vector<int> *out) const;
+
+    inline double getCellSize() const { return m_cellSize; }
+    inline void setCellSize(double cellSize) { m_cellSize = cellSize; }
+    inline int getNumParticles() const { return m_numParticles; }
+
+private:
+    inline glm::ivec2 calcGridPos(const glm::dvec2 &p) const;
+    inline unsigned int calcGridHash(glm::ivec2 gridPos) const;
+
+    void calcHash(const std::vector<glm::dvec2> &positions);
+    void sortParticles();
+    void findCellStart();
+
+    double m_cellSize;
+    glm::dvec2 m_origin;
+    glm::ivec2 m_gridSize;
+    int m_numCells, m_numParticles;
+
+    std::vector<unsigned int> m_particleHash;  // hash of each particle, in sorted order after sorting
+    std::vector<unsigned int> m_particleIndex; // original index of each particle, in sorted order
+    std::vector<unsigned int> m_cellStart, m_cellEnd;
+
+    // Scratch space for the counting sort
+    std::vector<unsigned int> m_unsortedHash, m_unsortedIndex;
+};
+
+inline glm::ivec2 SpatialGrid::calcGridPos(const glm::dvec2 &p) const {
+    return glm::ivec2((int)floor((p.x - m_origin.x) / m_cellSize),
+                      (int)floor((p.y - m_origin.y) / m_cellSize));
+}
+
+// Wrap the grid, assumes the size is a power of 2
+inline unsigned int SpatialGrid::calcGridHash(glm::ivec2 gridPos) const {
+    gridPos.x = gridPos.x & (m_gridSize.x - 1);
+    gridPos.y = gridPos.y & (m_gridSize.y - 1);
+    return gridPos.y * m_gridSize.x + gridPos.x;
+}
+
+template <typename F>
+void SpatialGrid::forEachCandidate(const glm::dvec2 &pos, double radius, F f) const {
+    if (m_numParticles == 0) {
+        return;
+    }
+
+    // If the search area covers a whole (wrapped) axis, visit each cell on it exactly once
+    int rad = (int)ceil(radius / m_cellSize);
+    int spanX = min(2 * rad + 1, m_gridSize.x), spanY = min(2 * rad + 1, m_gridSize.y);
+    int fromX = spanX == m_gridSize.x ? 0 : -rad, fromY = spanY == m_gridSize.y ? 0 : -rad;
+    glm::ivec2 gridPos = calcGridPos(pos);
+
+    for (int y = fromY; y < fromY + spanY; y++) {
+        for (int x = fromX; x < fromX + spanX; x++) {
+            unsigned int hash = calcGridHash(gridPos + glm::ivec2(x, y));
+            unsigned int start = m_cellStart[hash];
+            if (start == EMPTY_CELL) {
+                continue;
+            }
+            unsigned int end = m_cellEnd[hash];
+            for (unsigned int k = start; k < end; k++) {
+                f((int)m_particleIndex[k]);
+            }
+        }
+    }
+}
+
+#endif // SPATIALGRID_H
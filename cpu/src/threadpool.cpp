@@ -0,0 +1,91 @@
+#include "threadpool.h"
+
+#include "tracewriter.h"
+
+ThreadPool::ThreadPool(int numThreads)
+    : m_job(NULL), m_n(0), m_chunk(1), m_active(0), m_next(0), m_generation(0), m_quit(false) {
+    if (numThreads <= 0) {
+        numThreads = std::thread::hardware_concurrency();
+    }
+    for (int i = 1; i < numThreads; i++) {
+        m_workers.push_back(std::thread(&ThreadPool::workerLoop, this));
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+    }
+    m_start.notify_all();
+    for (unsigned int i = 0; i < m_workers.size(); i++) {
+        m_workers[i].join();
+    }
+}
+
+void ThreadPool::parallelFor(int n, const std::function<void(int, int)> &f) {
+    if (n <= 0) {
+        return;
+    }
+
+    // Not worth waking anybody up
+    if (m_workers.empty() || n == 1) {
+        f(0, n);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_job = &f;
+        m_n = n;
+
+        // A few chunks per thread so uneven work still balances out
+        m_chunk = n / (4 * getNumThreads());
+        if (m_chunk < 1) {
+            m_chunk = 1;
+        }
+        m_next = 0;
+        m_active = m_workers.size();
+        m_generation++;
+    }
+    m_start.notify_all();
+
+    runChunks();
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done.wait(lock, [this] { return m_active == 0; });
+    m_job = NULL;
+}
+
+void ThreadPool::runChunks() {
+    TraceScope trace("chunks", "pool");
+    while (true) {
+        int begin = m_next.fetch_add(m_chunk);
+        if (begin >= m_n) {
+            return;
+        }
+        int end = begin + m_chunk < m_n ? begin + m_chunk : m_n;
+        (*m_job)(begin, end);
+    }
+}
+
+void ThreadPool::workerLoop() {
+    unsigned int seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_start.wait(lock, [this, &seen] { return m_quit || m_generation != seen; });
+            if (m_quit) {
+                return;
+            }
+            seen = m_generation;
+        }
+
+        runChunks();
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (--m_active == 0) {
+            m_done.notify_one();
+        }
+    }
+}
@@ -0,0 +1,40 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of worker threads that split loops over ranges of indices. The calling
+// thread works on the loop too, so a pool of n threads starts n - 1 workers.
+class ThreadPool {
+public:
+    // 0 threads means one per hardware thread
+    ThreadPool(int numThreads = 0);
+    virtual ~ThreadPool();
+
+    inline int getNumThreads() const { return m_workers.size() + 1; }
+
+    // Call f(begin, end) on chunks covering [0, n), returning once every chunk is done
+    void parallelFor(int n, const std::function<void(int, int)> &f);
+
+private:
+    void workerLoop();
+    void runChunks();
+
+    std::vector<std::thread> m_workers;
+    std::mutex m_mutex;
+    std::condition_variable m_start, m_done;
+
+    // The loop currently being run, guarded by m_mutex except for m_next
+    const std::function<void(int, int)> *m_job;
+    int m_n, m_chunk, m_active;
+    std::atomic<int> m_next;
+    unsigned int m_generation;
+    bool m_quit;
+};
+
+#endif // THREADPOOL_H
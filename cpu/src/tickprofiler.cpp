@@ -0,0 +1,82 @@
+#include "tickprofiler.h"
+
+#include <algorithm>
+
+static const char *STAGE_NAMES[NUM_TICK_STAGES] = {
+    "forces", "contacts", "neighbors", "setup", "stabilization",
+    "solve", "velocities", "islands", "cleanup", "emitters", "recording", "publish"};
+
+static const char *GROUP_NAMES[NUM_CONSTRAINT_GROUPS] = {"stabilization", "contact", "standard", "shape"};
+
+TickProfile::TickProfile()
+    : numTicks(0), seconds(0), numParticles(0), numCandidates(0), numListed(0), numNeighbors(0), maxNeighbors(0),
+      numAsleep(0), numIslands(0) {
+    std::fill(stageSeconds, stageSeconds + NUM_TICK_STAGES, 0.);
+    std::fill(groupSeconds, groupSeconds + NUM_CONSTRAINT_GROUPS, 0.);
+    std::fill(numConstraints, numConstraints + NUM_CONSTRAINT_GROUPS, (int64_t)0);
+}
+
+void TickProfile::add(const TickProfile &other) {
+    numTicks += other.numTicks;
+    seconds += other.seconds;
+    for (int i = 0; i < NUM_TICK_STAGES; i++) {
+        stageSeconds[i] += other.stageSeconds[i];
+    }
+    for (int i = 0; i < NUM_CONSTRAINT_GROUPS; i++) {
+        groupSeconds[i] += other.groupSeconds[i];
+        numConstraints[i] += other.numConstraints[i];
+    }
+    numParticles += other.numParticles;
+    numCandidates += other.numCandidates;
+    numListed += other.numListed;
+    numNeighbors += other.numNeighbors;
+    maxNeighbors = std::max(maxNeighbors, other.maxNeighbors);
+    numAsleep += other.numAsleep;
+    numIslands += other.numIslands;
+}
+
+TickProfiler::TickProfiler()
+    : m_trace(NULL) {
+}
+
+TickProfiler::~TickProfiler() {
+}
+
+void TickProfiler::begin() {
+    m_current = TickProfile();
+    m_current.numTicks = 1;
+    m_begin = m_lap = Clock::now();
+}
+
+void TickProfiler::lap(TickStage stage, int group) {
+    Clock::time_point now = Clock::now();
+    double seconds = std::chrono::duration<double>(now - m_lap).count();
+    m_current.stageSeconds[stage] += seconds;
+    if (group >= 0) {
+        m_current.groupSeconds[group] += seconds;
+    }
+    if (m_trace != NULL) {
+        // Group passes are named by group, so each one shows up separately in the trace
+        m_trace->event(group >= 0 ? GROUP_NAMES[group] : STAGE_NAMES[stage], group >= 0 ? "group" : "stage", m_lap,
+                       now);
+    }
+    m_lap = now;
+}
+
+void TickProfiler::end() {
+    Clock::time_point now = Clock::now();
+    m_current.seconds = std::chrono::duration<double>(now - m_begin).count();
+    if (m_trace != NULL) {
+        m_trace->event("tick", "tick", m_begin, now);
+    }
+    m_last = m_current;
+    m_totals.add(m_current);
+}
+
+void TickProfiler::reset() {
+    m_totals = TickProfile();
+}
+
+const char *TickProfiler::getStageName(TickStage stage) {
+    return STAGE_NAMES[stage];
+}
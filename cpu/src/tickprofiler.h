@@ -0,0 +1,88 @@
+#ifndef TICKPROFILER_H
+#define TICKPROFILER_H
+
+#include "particle.h"
+#include "tracewriter.h"
+
+#include <chrono>
+#include <stdint.h>
+
+// Stages of Simulation::tick, with the steps of the paper's main solve loop each covers
+enum TickStage {
+    STAGE_FORCES,        // (1-5) apply forces, predict positions and scale masses
+    STAGE_CONTACTS,      // (6-9) bin particles and find solid and boundary contacts
+    STAGE_NEIGHBORS,     // gather fluid and gas neighbor lists
+    STAGE_SETUP,         // color, gather and count the tick's constraints
+    STAGE_STABILIZATION, // (10-15) stabilization iterations
+    STAGE_SOLVE,         // (16-22) solver iterations
+    STAGE_VELOCITIES,    // (23-28) update velocities and positions
+    STAGE_ISLANDS,       // build islands and put resting ones to sleep
+    STAGE_CLEANUP,       // release the tick's contact constraints
+    STAGE_EMITTERS,      // tick smoke and fluid emitters
+    STAGE_RECORDING,     // hand the particles to a trajectory writer
+    STAGE_PUBLISH,       // copy the state out for drawing
+    NUM_TICK_STAGES
+};
+
+// Where the time of one or more ticks went, and how big the problem was
+struct TickProfile {
+    TickProfile();
+
+    // Add another tick's times and counts to these
+    void add(const TickProfile &other);
+
+    int numTicks;
+    double seconds;
+    double stageSeconds[NUM_TICK_STAGES];
+    double groupSeconds[NUM_CONSTRAINT_GROUPS]; // solve and stabilization time spent on each group
+
+    // Counts are summed over every tick in the totals, so they are kept wide enough not to
+    // overflow on long runs of large scenes
+    int64_t numParticles;
+    int64_t numConstraints[NUM_CONSTRAINT_GROUPS];
+    int64_t numCandidates;                      // broad phase pairs checked for contact
+    int64_t numListed, numNeighbors;            // particles with neighbor lists, and their total length
+    int maxNeighbors;                           // longest neighbor list
+    int64_t numAsleep, numIslands;              // sleeping particles, and awake islands
+};
+
+// Times the stages of a tick as laps of a single stopwatch, so each stage costs one clock
+// read. Cheap enough to leave on: about a dozen reads per tick, next to ticks of a millisecond
+// or more. Given a trace, every tick and lap is also written to it as an event.
+class TickProfiler {
+public:
+    TickProfiler();
+    virtual ~TickProfiler();
+
+    // Start timing a new tick, the first lap starts here
+    void begin();
+
+    // Charge the time since the last lap to a stage, and to a constraint group if one is given
+    void lap(TickStage stage, int group = -1);
+
+    // Finish the tick, adding it to the totals
+    void end();
+
+    // Counts for the tick being timed are filled in directly
+    inline TickProfile &current() { return m_current; }
+
+    inline const TickProfile &getLast() const { return m_last; }
+    inline const TickProfile &getTotals() const { return m_totals; }
+
+    // Start the totals over
+    void reset();
+
+    // Also record ticks and laps to a trace from now on, NULL to stop
+    inline void setTrace(TraceWriter *trace) { m_trace = trace; }
+
+    static const char *getStageName(TickStage stage);
+
+private:
+    typedef TraceWriter::Clock Clock;
+
+    TickProfile m_current, m_last, m_totals;
+    Clock::time_point m_begin, m_lap;
+    TraceWriter *m_trace;
+};
+
+#endif // TICKPROFILER_H
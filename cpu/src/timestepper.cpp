@@ -0,0 +1,61 @@
+#include "timestepper.h"
+
+#include <algorithm>
+
+TimeStepper::TimeStepper(double seconds, int substeps, int maxCatchup)
+    : m_seconds(seconds), m_accumulator(0), m_dropped(0), m_substeps(1), m_iterations(SOLVER_ITERATIONS),
+      m_maxCatchup(std::max(1, maxCatchup)) {
+    setSubsteps(substeps);
+}
+
+TimeStepper::~TimeStepper() {
+}
+
+void TimeStepper::setTimestep(double seconds) {
+    if (seconds > 0) {
+        m_seconds = seconds;
+        m_accumulator = std::min(m_accumulator, m_seconds);
+    }
+}
+
+void TimeStepper::setMaxCatchup(int steps) {
+    m_maxCatchup = std::max(1, steps);
+}
+
+void TimeStepper::setSubsteps(int substeps, int iterationBudget) {
+    m_substeps = std::max(1, substeps);
+    m_iterations = std::max(1, iterationBudget / m_substeps);
+}
+
+int TimeStepper::advance(Simulation *sim, double elapsed) {
+    m_accumulator += std::max(0., elapsed);
+
+    int steps = 0;
+    while (m_accumulator >= m_seconds && steps < m_maxCatchup) {
+        step(sim);
+        m_accumulator -= m_seconds;
+        steps++;
+    }
+
+    // Out of steps with whole steps still owed, so let the simulation fall behind instead
+    if (m_accumulator >= m_seconds) {
+        double kept = fmod(m_accumulator, m_seconds);
+        m_dropped += m_accumulator - kept;
+        m_accumulator = kept;
+    }
+    return steps;
+}
+
+void TimeStepper::step(Simulation *sim) {
+    int iterations = sim->getSolverIterations();
+    sim->setSolverIterations(m_iterations);
+    for (int i = 0; i < m_substeps; i++) {
+        sim->tick(m_seconds / m_substeps);
+    }
+    sim->setSolverIterations(iterations);
+}
+
+void TimeStepper::reset() {
+    m_accumulator = 0;
+    m_dropped = 0;
+}
@@ -0,0 +1,57 @@
+#ifndef TIMESTEPPER_H
+#define TIMESTEPPER_H
+
+#include "simulation.h"
+
+// Simulated seconds per step, independent of the frame rate
+#define STEP_SECONDS .01
+
+// Substeps each step is split into, sharing the step's solver iterations between them
+#define STEP_SUBSTEPS 1
+
+// Most steps taken to catch up in a single frame. Time beyond that is dropped, so a frame that
+// takes longer to simulate than it covers can't make the next frame take longer still.
+#define STEP_MAX_CATCHUP 5
+
+// Drives a simulation at a fixed timestep from however much real time has passed. Elapsed time
+// piles up in an accumulator and is paid out in whole steps, so the simulation keeps to wall
+// clock speed at any frame rate and stays deterministic for a given sequence of steps.
+class TimeStepper {
+public:
+    TimeStepper(double seconds = STEP_SECONDS, int substeps = STEP_SUBSTEPS, int maxCatchup = STEP_MAX_CATCHUP);
+    virtual ~TimeStepper();
+
+    void setTimestep(double seconds);
+    void setMaxCatchup(int steps);
+
+    // Split each step into substeps, giving each a share of the iteration budget but at least one
+    // iteration. Smaller substeps converge stiff constraints better than extra iterations do, so
+    // 3 substeps of 1 iteration usually beat 1 step of 3 for the same cost.
+    void setSubsteps(int substeps, int iterationBudget = SOLVER_ITERATIONS);
+
+    inline double getTimestep() const { return m_seconds; }
+    inline int getSubsteps() const { return m_substeps; }
+    inline int getIterationsPerSubstep() const { return m_iterations; }
+
+    // Add elapsed real time and take every whole step it pays for, up to the catch-up limit.
+    // Returns the number of steps taken.
+    int advance(Simulation *sim, double elapsed);
+
+    // Take one step regardless of the accumulator
+    void step(Simulation *sim);
+
+    // Forget any time left over, after a pause or when the scene is rebuilt
+    void reset();
+
+    // Fraction of a step waiting in the accumulator, for interpolating what is drawn
+    inline double getAlpha() const { return m_accumulator / m_seconds; }
+
+    // Real time thrown away because catching up would have taken too many steps
+    inline double getDroppedSeconds() const { return m_dropped; }
+
+private:
+    double m_seconds, m_accumulator, m_dropped;
+    int m_substeps, m_iterations, m_maxCatchup;
+};
+
+#endif // TIMESTEPPER_H
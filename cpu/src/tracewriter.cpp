@@ -0,0 +1,124 @@
+#include "tracewriter.h"
+
+#include <algorithm>
+#include <iostream>
+
+std::atomic<TraceWriter *> TraceWriter::s_active(NULL);
+
+// Names go into JSON strings, so quotes, backslashes and control characters are escaped
+static void appendEscaped(std::string *out, const char *s) {
+    for (; *s != '\0'; s++) {
+        if (*s == '"' || *s == '\\') {
+            out->push_back('\\');
+            out->push_back(*s);
+        } else if ((unsigned char)*s < 0x20) {
+            char code[8];
+            snprintf(code, sizeof(code), "\\u%04x", *s);
+            out->append(code);
+        } else {
+            out->push_back(*s);
+        }
+    }
+}
+
+TraceWriter::TraceWriter()
+    : m_file(NULL), m_failed(false), m_first(true) {
+}
+
+TraceWriter::~TraceWriter() {
+    close();
+}
+
+bool TraceWriter::open(const char *path) {
+    close();
+    m_file = fopen(path, "w");
+    if (m_file == NULL) {
+        std::cout << "Could not open trace " << path << " for writing." << std::endl;
+        return false;
+    }
+
+    m_failed = false;
+    m_first = true;
+    m_threads.clear();
+    m_buffer = "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    m_start = Clock::now();
+    return true;
+}
+
+bool TraceWriter::close() {
+    if (m_file == NULL) {
+        return !m_failed;
+    }
+
+    // A trace closed while still active would leave TraceScopes writing to a dead file
+    TraceWriter *self = this;
+    s_active.compare_exchange_strong(self, NULL);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_buffer += "\n]}\n";
+    flush();
+    m_failed |= fclose(m_file) != 0;
+    m_file = NULL;
+    return !m_failed;
+}
+
+void TraceWriter::event(const char *name, const char *category, Clock::time_point start, Clock::time_point end) {
+    // Microseconds, which is what the format expects
+    double ts = std::chrono::duration<double, std::micro>(start - m_start).count();
+    double dur = std::chrono::duration<double, std::micro>(end - start).count();
+
+    std::string json = "{\"name\": \"";
+    appendEscaped(&json, name);
+    json += "\", \"cat\": \"";
+    appendEscaped(&json, category);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    char times[128];
+    snprintf(times, sizeof(times), "\", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, \"pid\": 1, \"tid\": %d}", ts,
+             dur, getThreadId());
+    json += times;
+    append(json);
+}
+
+void TraceWriter::nameThread(const char *name) {
+    std::string json = "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"args\": {\"name\": \"";
+    appendEscaped(&json, name);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    char tid[64];
+    snprintf(tid, sizeof(tid), "\"}, \"tid\": %d}", getThreadId());
+    json += tid;
+    append(json);
+}
+
+int TraceWriter::getThreadId() {
+    std::thread::id id = std::this_thread::get_id();
+    std::vector<std::thread::id>::iterator found = std::find(m_threads.begin(), m_threads.end(), id);
+    if (found != m_threads.end()) {
+        return found - m_threads.begin() + 1;
+    }
+    m_threads.push_back(id);
+    return m_threads.size();
+}
+
+void TraceWriter::append(const std::string &json) {
+    if (m_file == NULL) {
+        return;
+    }
+    if (!m_first) {
+        m_buffer += ",\n";
+    }
+    m_first = false;
+    m_buffer += json;
+    if (m_buffer.size() >= TRACE_FLUSH_BYTES) {
+        flush();
+    }
+}
+
+void TraceWriter::flush() {
+    if (!m_failed && !m_buffer.empty() && fwrite(m_buffer.data(), 1, m_buffer.size(), m_file) != m_buffer.size()) {
+        std::cout << "Writing trace failed." << std::endl;
+        m_failed = true;
+    }
+    m_buffer.clear();
+}
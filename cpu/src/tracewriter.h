@@ -0,0 +1,82 @@
+#ifndef TRACEWRITER_H
+#define TRACEWRITER_H
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <stdio.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Trace events are buffered and written out whenever this many bytes have built up
+#define TRACE_FLUSH_BYTES (1 << 20)
+
+// Writes timed events to a file in the Chrome Trace Event JSON format, which chrome://tracing
+// and Perfetto open directly. Events may come from any thread; each thread gets its own track.
+class TraceWriter {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    TraceWriter();
+    virtual ~TraceWriter();
+
+    // Start a new trace, timestamps count from here
+    bool open(const char *path);
+
+    // Finish the JSON and close the file, returning false if any write failed
+    bool close();
+
+    inline bool isOpen() const { return m_file != NULL; }
+
+    // Record an event that ran on the calling thread from start to end
+    void event(const char *name, const char *category, Clock::time_point start, Clock::time_point end);
+
+    // Label the calling thread's track
+    void nameThread(const char *name);
+
+    // The trace that TraceScopes record to, NULL when nothing is being traced. Only one trace
+    // can be active at a time, and it must stay open while it is.
+    static inline TraceWriter *getActive() { return s_active.load(std::memory_order_relaxed); }
+    static inline void setActive(TraceWriter *trace) { s_active.store(trace); }
+
+private:
+    // Small id of the calling thread, with m_mutex held
+    int getThreadId();
+    void append(const std::string &json);
+    void flush();
+
+    FILE *m_file;
+    bool m_failed, m_first;
+    Clock::time_point m_start;
+    std::mutex m_mutex;
+    std::vector<std::thread::id> m_threads;
+    std::string m_buffer;
+
+    static std::atomic<TraceWriter *> s_active;
+};
+
+// Records the lifetime of a scope as an event in the active trace, if there is one. Costs a
+// single load when nothing is being traced.
+class TraceScope {
+public:
+    inline TraceScope(const char *name, const char *category)
+        : m_trace(TraceWriter::getActive()), m_name(name), m_category(category) {
+        if (m_trace != NULL) {
+            m_start = TraceWriter::Clock::now();
+        }
+    }
+
+    inline ~TraceScope() {
+        if (m_trace != NULL) {
+            m_trace->event(m_name, m_category, m_start, TraceWriter::Clock::now());
+        }
+    }
+
+private:
+    TraceWriter *m_trace;
+    const char *m_name, *m_category;
+    TraceWriter::Clock::time_point m_start;
+};
+
+#endif // TRACEWRITER_H
@@ -0,0 +1,452 @@
+#include "trajectory.h"
+
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+#define VALUES_PER_PARTICLE 4
+
+static inline void putVarint(uint64_t x, std::vector<uint8_t> *out) {
+    while (x >= 0x80) {
+        out->push_back((uint8_t)(x | 0x80));
+        x >>= 7;
+    }
+    out->push_back((uint8_t)x);
+}
+
+static inline bool getVarint(const uint8_t **data, const uint8_t *end, uint64_t *x) {
+    *x = 0;
+    for (int shift = 0; shift < 64 && *data < end; shift += 7) {
+        uint8_t byte = *(*data)++;
+        *x |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Small differences of either sign become small unsigned numbers
+static inline uint64_t zigzag(int64_t x) {
+    return ((uint64_t)x << 1) ^ (uint64_t)(x >> 63);
+}
+
+static inline int64_t unzigzag(uint64_t x) {
+    return (int64_t)(x >> 1) ^ -(int64_t)(x & 1);
+}
+
+TrajectoryCodec::TrajectoryCodec(double quantum)
+    : m_quantum(quantum) {
+}
+
+uint64_t TrajectoryCodec::toWord(double x) const {
+    if (m_quantum > 0) {
+        return (uint64_t)llround(x / m_quantum);
+    }
+    uint64_t w;
+    memcpy(&w, &x, sizeof(w));
+    return w;
+}
+
+double TrajectoryCodec::fromWord(uint64_t w) const {
+    if (m_quantum > 0) {
+        return (int64_t)w * m_quantum;
+    }
+    double x;
+    memcpy(&x, &w, sizeof(x));
+    return x;
+}
+
+void TrajectoryCodec::reset(bool keyframe, int numParticles) {
+    if (keyframe) {
+        m_prev.clear();
+        m_prev2.clear();
+        m_age.clear();
+        m_prevPh.clear();
+    }
+    m_prev.resize(numParticles * VALUES_PER_PARTICLE, 0);
+    m_prev2.resize(numParticles * VALUES_PER_PARTICLE, 0);
+    m_age.resize(numParticles, 0);
+    m_prevPh.resize(numParticles, SOLID);
+}
+
+uint64_t TrajectoryCodec::predict(int i, int k) const {
+    int j = i * VALUES_PER_PARTICLE + k;
+    if (m_age[i] < 2) {
+        return m_prev[j];
+    }
+
+    // Particles mostly keep moving the way they were, so carry on from the last two frames
+    if (m_quantum > 0) {
+        return 2 * m_prev[j] - m_prev2[j];
+    }
+    return toWord(2 * fromWord(m_prev[j]) - fromWord(m_prev2[j]));
+}
+
+void TrajectoryCodec::update(int i, const uint64_t *words) {
+    for (int k = 0; k < VALUES_PER_PARTICLE; k++) {
+        int j = i * VALUES_PER_PARTICLE + k;
+        m_prev2[j] = m_prev[j];
+        m_prev[j] = words[k];
+    }
+    m_age[i] = std::min(m_age[i] + 1, 2);
+}
+
+void TrajectoryCodec::encode(const std::vector<glm::dvec2> &p, const std::vector<glm::dvec2> &v,
+                             const std::vector<Phase> &ph, bool keyframe, std::vector<uint8_t> *out) {
+    int numParticles = p.size(), numPrev = keyframe ? 0 : m_prevPh.size();
+    reset(keyframe, numParticles);
+
+    for (int i = 0; i < numParticles; i++) {
+        double values[VALUES_PER_PARTICLE] = {p[i].x, p[i].y, v[i].x, v[i].y};
+        uint64_t words[VALUES_PER_PARTICLE];
+        for (int k = 0; k < VALUES_PER_PARTICLE; k++) {
+            words[k] = toWord(values[k]);
+
+            // Matching sign, exponent and leading mantissa bits cancel out of the XOR
+            uint64_t predicted = predict(i, k);
+            putVarint(m_quantum > 0 ? zigzag(words[k] - predicted) : words[k] ^ predicted, out);
+        }
+        update(i, words);
+    }
+
+    // Phases rarely change, so only the particles whose phase did are listed
+    int numChanged = 0;
+    for (int i = 0; i < numParticles; i++) {
+        numChanged += i >= numPrev || ph[i] != m_prevPh[i];
+    }
+    putVarint(numChanged, out);
+    for (int i = 0, last = 0; i < numParticles; i++) {
+        if (i >= numPrev || ph[i] != m_prevPh[i]) {
+            putVarint(i - last, out);
+            out->push_back((uint8_t)ph[i]);
+            m_prevPh[i] = ph[i];
+            last = i;
+        }
+    }
+}
+
+bool TrajectoryCodec::decode(const uint8_t *data, size_t size, int numParticles, bool keyframe,
+                             TrajectoryFrame *out) {
+    reset(keyframe, numParticles);
+    out->p.resize(numParticles);
+    out->v.resize(numParticles);
+
+    const uint8_t *end = data + size;
+    for (int i = 0; i < numParticles; i++) {
+        uint64_t words[VALUES_PER_PARTICLE];
+        for (int k = 0; k < VALUES_PER_PARTICLE; k++) {
+            uint64_t delta;
+            if (!getVarint(&data, end, &delta)) {
+                return false;
+            }
+            uint64_t predicted = predict(i, k);
+            words[k] = m_quantum > 0 ? predicted + unzigzag(delta) : predicted ^ delta;
+        }
+        update(i, words);
+        out->p[i] = glm::dvec2(fromWord(words[0]), fromWord(words[1]));
+        out->v[i] = glm::dvec2(fromWord(words[2]), fromWord(words[3]));
+    }
+
+    uint64_t numChanged, index = 0;
+    if (!getVarint(&data, end, &numChanged) || numChanged > (uint64_t)numParticles) {
+        return false;
+    }
+    for (uint64_t i = 0; i < numChanged; i++) {
+        uint64_t step;
+        if (!getVarint(&data, end, &step) || data >= end || (index += step) >= (uint64_t)numParticles ||
+            *data >= NUM_PHASES) {
+            return false;
+        }
+        m_prevPh[index] = (Phase)*data++;
+    }
+    out->ph = m_prevPh;
+    return data == end;
+}
+
+TrajectoryWriter::TrajectoryWriter()
+    : m_file(NULL), m_keyframeInterval(TRAJECTORY_KEYFRAME_INTERVAL), m_numPushed(0), m_offset(0),
+      m_failed(false), m_closing(false) {
+}
+
+TrajectoryWriter::~TrajectoryWriter() {
+    close();
+    for (unsigned int i = 0; i < m_free.size(); i++) {
+        delete m_free[i];
+    }
+}
+
+bool TrajectoryWriter::open(const char *path, double quantum, int keyframeInterval) {
+    close();
+    m_file = fopen(path, "wb");
+    if (m_file == NULL) {
+        cout << "Could not open trajectory " << path << " for writing." << endl;
+        return false;
+    }
+
+    m_codec = TrajectoryCodec(quantum);
+    m_keyframeInterval = std::max(1, keyframeInterval);
+    m_numPushed = 0;
+    m_offset = 0;
+    m_failed = false;
+    m_closing = false;
+    m_index.clear();
+
+    TrajectoryHeader header;
+    memset(&header, 0, sizeof(header));
+    strncpy(header.magic, TRAJECTORY_MAGIC, sizeof(header.magic));
+    header.version = TRAJECTORY_VERSION;
+    header.keyframeInterval = m_keyframeInterval;
+    header.quantum = std::max(0., quantum);
+    write(&header, sizeof(header));
+
+    m_worker = std::thread(&TrajectoryWriter::workerLoop, this);
+    return !m_failed;
+}
+
+bool TrajectoryWriter::close() {
+    if (m_file == NULL) {
+        return !m_failed;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closing = true;
+    }
+    m_wake.notify_one();
+    m_worker.join();
+
+    TrajectoryTrailer trailer;
+    memset(&trailer, 0, sizeof(trailer));
+    trailer.numKeyframes = m_index.size();
+    trailer.indexOffset = m_offset;
+    trailer.numFrames = m_numPushed;
+    strncpy(trailer.magic, TRAJECTORY_INDEX_MAGIC, sizeof(trailer.magic));
+    write(m_index.data(), m_index.size() * sizeof(TrajectoryIndexEntry));
+    write(&trailer, sizeof(trailer));
+
+    m_failed |= fclose(m_file) != 0;
+    m_file = NULL;
+    return !m_failed;
+}
+
+void TrajectoryWriter::push(const ParticleStore *particles) {
+    if (m_file == NULL) {
+        return;
+    }
+
+    TrajectoryFrame *frame = NULL;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_free.empty()) {
+            frame = m_free.back();
+            m_free.pop_back();
+        }
+    }
+    if (frame == NULL) {
+        frame = new TrajectoryFrame();
+    }
+
+    // Copying into a recycled frame keeps the simulation thread free of allocations once warm
+    frame->frame = m_numPushed++;
+    frame->p = particles->p;
+    frame->v = particles->v;
+    frame->ph = particles->ph;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queue.push_back(frame);
+    }
+    m_wake.notify_one();
+}
+
+void TrajectoryWriter::workerLoop() {
+    while (true) {
+        TrajectoryFrame *frame;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [this] { return m_closing || !m_queue.empty(); });
+            if (m_queue.empty()) {
+                return;
+            }
+            frame = m_queue.front();
+            m_queue.pop_front();
+        }
+
+        writeFrame(frame);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_free.push_back(frame);
+    }
+}
+
+void TrajectoryWriter::writeFrame(TrajectoryFrame *frame) {
+    bool keyframe = frame->frame % m_keyframeInterval == 0;
+    if (keyframe) {
+        TrajectoryIndexEntry entry;
+        entry.frame = frame->frame;
+        entry.padding = 0;
+        entry.offset = m_offset;
+        m_index.push_back(entry);
+    }
+
+    m_payload.clear();
+    m_codec.encode(frame->p, frame->v, frame->ph, keyframe, &m_payload);
+
+    TrajectoryFrameHeader header;
+    header.payloadBytes = m_payload.size();
+    header.frame = frame->frame;
+    header.numParticles = frame->p.size();
+    header.keyframe = keyframe;
+    write(&header, sizeof(header));
+    write(m_payload.data(), m_payload.size());
+}
+
+void TrajectoryWriter::write(const void *data, size_t size) {
+    if (m_failed || size == 0) {
+        return;
+    }
+    if (fwrite(data, 1, size, m_file) != size) {
+        cout << "Writing trajectory failed." << endl;
+        m_failed = true;
+        return;
+    }
+    m_offset += size;
+}
+
+TrajectoryReader::TrajectoryReader()
+    : m_file(NULL), m_numFrames(0), m_next(0) {
+    memset(&m_header, 0, sizeof(m_header));
+}
+
+TrajectoryReader::~TrajectoryReader() {
+    close();
+}
+
+bool TrajectoryReader::open(const char *path) {
+    close();
+    m_file = fopen(path, "rb");
+    if (m_file == NULL) {
+        cout << "Could not open trajectory " << path << "." << endl;
+        return false;
+    }
+
+    if (fread(&m_header, sizeof(m_header), 1, m_file) != 1 ||
+        strncmp(m_header.magic, TRAJECTORY_MAGIC, sizeof(m_header.magic)) != 0) {
+        cout << path << " is not a trajectory." << endl;
+    } else if (m_header.version != TRAJECTORY_VERSION) {
+        cout << "Trajectory " << path << " is version " << m_header.version << ", expected "
+             << TRAJECTORY_VERSION << "." << endl;
+    } else if (m_header.keyframeInterval == 0 || !(m_header.quantum >= 0)) {
+        cout << "Trajectory " << path << " has a broken header." << endl;
+    } else {
+        m_codec = TrajectoryCodec(m_header.quantum);
+
+        // Use the index written on close, or find the keyframes the slow way if it's missing
+        TrajectoryTrailer trailer;
+        bool indexed = fseek(m_file, -(long)sizeof(trailer), SEEK_END) == 0 &&
+                       fread(&trailer, sizeof(trailer), 1, m_file) == 1 &&
+                       strncmp(trailer.magic, TRAJECTORY_INDEX_MAGIC, sizeof(trailer.magic)) == 0 &&
+                       fseek(m_file, trailer.indexOffset, SEEK_SET) == 0;
+        if (indexed) {
+            m_keyframes.resize(trailer.numKeyframes);
+            indexed = fread(m_keyframes.data(), sizeof(TrajectoryIndexEntry), m_keyframes.size(), m_file) ==
+                      m_keyframes.size();
+            m_numFrames = trailer.numFrames;
+        }
+        if (indexed || scan()) {
+            m_next = m_numFrames;
+            return true;
+        }
+        cout << "Trajectory " << path << " has no readable frames." << endl;
+    }
+    close();
+    return false;
+}
+
+bool TrajectoryReader::scan() {
+    m_keyframes.clear();
+    m_numFrames = 0;
+    if (fseek(m_file, 0, SEEK_END) != 0) {
+        return false;
+    }
+    uint64_t size = ftell(m_file);
+
+    // Stops at the first frame cut short, as the last one of a crashed run would be
+    uint64_t offset = sizeof(TrajectoryHeader);
+    TrajectoryFrameHeader header;
+    while (offset + sizeof(header) <= size && fseek(m_file, offset, SEEK_SET) == 0 &&
+           fread(&header, sizeof(header), 1, m_file) == 1 && header.frame == (uint32_t)m_numFrames &&
+           offset + sizeof(header) + header.payloadBytes <= size) {
+        if (header.keyframe) {
+            TrajectoryIndexEntry entry;
+            entry.frame = header.frame;
+            entry.padding = 0;
+            entry.offset = offset;
+            m_keyframes.push_back(entry);
+        }
+        m_numFrames++;
+        offset += sizeof(header) + header.payloadBytes;
+    }
+    return !m_keyframes.empty();
+}
+
+void TrajectoryReader::close() {
+    if (m_file != NULL) {
+        fclose(m_file);
+    }
+    m_file = NULL;
+    m_keyframes.clear();
+    m_numFrames = m_next = 0;
+}
+
+bool TrajectoryReader::readFrame(int frame, TrajectoryFrame *out) {
+    if (m_file == NULL || frame < 0 || frame >= m_numFrames || m_keyframes.empty()) {
+        return false;
+    }
+
+    // Last keyframe at or before the frame
+    int lo = 0, hi = m_keyframes.size();
+    while (hi - lo > 1) {
+        int mid = (lo + hi) / 2;
+        if (m_keyframes[mid].frame <= (uint32_t)frame) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    const TrajectoryIndexEntry &keyframe = m_keyframes[lo];
+    if (keyframe.frame > (uint32_t)frame) {
+        return false;
+    }
+
+    if (m_next > frame || m_next < (int)keyframe.frame) {
+        if (fseek(m_file, keyframe.offset, SEEK_SET) != 0) {
+            return false;
+        }
+        m_next = keyframe.frame;
+    }
+    while (m_next <= frame) {
+        if (!readNext(out)) {
+            // Whatever state the codec is left in, start over from a keyframe next time
+            m_next = m_numFrames;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool TrajectoryReader::readNext(TrajectoryFrame *out) {
+    TrajectoryFrameHeader header;
+    if (fread(&header, sizeof(header), 1, m_file) != 1 || header.frame != (uint32_t)m_next ||
+        header.numParticles < 0) {
+        return false;
+    }
+    m_payload.resize(header.payloadBytes);
+    if (fread(m_payload.data(), 1, m_payload.size(), m_file) != m_payload.size() ||
+        !m_codec.decode(m_payload.data(), m_payload.size(), header.numParticles, header.keyframe, out)) {
+        return false;
+    }
+    out->frame = m_next++;
+    return true;
+}
@@ -0,0 +1,161 @@
+#ifndef TRAJECTORY_H
+#define TRAJECTORY_H
+
+#include "particlestore.h"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <stdint.h>
+#include <stdio.h>
+#include <thread>
+#include <vector>
+
+#define TRAJECTORY_MAGIC "PBDTRAJ"
+#define TRAJECTORY_INDEX_MAGIC "PBDTIDX"
+#define TRAJECTORY_VERSION 1
+
+// Frames between keyframes, which are encoded on their own so reading can start from them
+#define TRAJECTORY_KEYFRAME_INTERVAL 60
+
+// Particle positions, velocities and phases for one recorded frame
+struct TrajectoryFrame {
+    int frame;
+    std::vector<glm::dvec2> p, v;
+    std::vector<Phase> ph;
+};
+
+// A trajectory file is this header, then the frames one after another, each a
+// TrajectoryFrameHeader followed by its encoded payload. Closing the writer appends an index
+// of the keyframes; files without one, say from a crashed run, are scanned instead.
+//
+// Each frame stores every particle's p.x, p.y, v.x and v.y as a delta against a prediction:
+// zero in keyframes and for particles new to the frame, the previous value one frame later, and
+// the straight line through the previous two values after that. Lossless files store the XOR
+// of the raw bits, quantized files the difference of the values rounded to multiples of
+// quantum. Either way the result is written as a varint, so well predicted values take only a
+// byte or two. Phases follow as a list of the particles whose phase changed.
+struct TrajectoryHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t keyframeInterval;
+    double quantum; // 0 for lossless
+};
+
+struct TrajectoryFrameHeader {
+    uint32_t payloadBytes;
+    uint32_t frame;
+    int32_t numParticles;
+    uint32_t keyframe;
+};
+
+struct TrajectoryIndexEntry {
+    uint32_t frame, padding;
+    uint64_t offset;
+};
+
+struct TrajectoryTrailer {
+    uint64_t numKeyframes, indexOffset;
+    uint32_t numFrames, padding;
+    char magic[8];
+};
+
+// Predictive delta coding shared by the writer and reader
+class TrajectoryCodec {
+public:
+    TrajectoryCodec(double quantum = 0);
+
+    // Code a frame against the previous one, forgetting it first for keyframes
+    void encode(const std::vector<glm::dvec2> &p, const std::vector<glm::dvec2> &v, const std::vector<Phase> &ph,
+                bool keyframe, std::vector<uint8_t> *out);
+    bool decode(const uint8_t *data, size_t size, int numParticles, bool keyframe, TrajectoryFrame *out);
+
+private:
+    inline uint64_t toWord(double x) const;
+    inline double fromWord(uint64_t w) const;
+
+    void reset(bool keyframe, int numParticles);
+    uint64_t predict(int i, int k) const;
+    void update(int i, const uint64_t *words);
+
+    double m_quantum;
+
+    // p.x, p.y, v.x, v.y of each particle in the last two frames, and how many of those it was in
+    std::vector<uint64_t> m_prev, m_prev2;
+    std::vector<int> m_age;
+    std::vector<Phase> m_prevPh;
+};
+
+// Streams frames to a trajectory file from a background thread. push() only copies the
+// particle arrays, the encoding and writing happen off the simulation thread. Frames queue up
+// in memory if the disk can't keep up.
+class TrajectoryWriter {
+public:
+    TrajectoryWriter();
+    virtual ~TrajectoryWriter();
+
+    // Start a new file, quantum 0 for lossless
+    bool open(const char *path, double quantum = 0, int keyframeInterval = TRAJECTORY_KEYFRAME_INTERVAL);
+
+    // Write out everything pushed so far and the keyframe index, returning false if any write failed
+    bool close();
+
+    // Queue the current state of the particles as the next frame
+    void push(const ParticleStore *particles);
+
+    inline int getNumFrames() const { return m_numPushed; }
+
+    // Size of the finished file, only valid once closed
+    inline uint64_t getBytesWritten() const { return m_offset; }
+
+private:
+    void workerLoop();
+    void writeFrame(TrajectoryFrame *frame);
+    void write(const void *data, size_t size);
+
+    FILE *m_file;
+    TrajectoryCodec m_codec;
+    int m_keyframeInterval, m_numPushed;
+    uint64_t m_offset;
+    bool m_failed;
+    std::vector<TrajectoryIndexEntry> m_index;
+    std::vector<uint8_t> m_payload;
+
+    // Frames waiting to be written, and spare frames to copy the next ones into
+    std::thread m_worker;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::deque<TrajectoryFrame *> m_queue;
+    std::vector<TrajectoryFrame *> m_free;
+    bool m_closing;
+};
+
+// Reads frames back from a trajectory file, in order or at random through the keyframes
+class TrajectoryReader {
+public:
+    TrajectoryReader();
+    virtual ~TrajectoryReader();
+
+    bool open(const char *path);
+    void close();
+
+    inline int getNumFrames() const { return m_numFrames; }
+    inline double getQuantum() const { return m_header.quantum; }
+
+    // Decode a frame, reading on from the current position when no keyframe lies between it and
+    // the frame, and from the closest keyframe before the frame otherwise
+    bool readFrame(int frame, TrajectoryFrame *out);
+
+private:
+    bool readNext(TrajectoryFrame *out);
+    bool scan();
+
+    FILE *m_file;
+    TrajectoryHeader m_header;
+    TrajectoryCodec m_codec;
+    std::vector<TrajectoryIndexEntry> m_keyframes;
+    std::vector<uint8_t> m_payload;
+    int m_numFrames, m_next; // m_next is the frame the file is positioned at
+};
+
+#endif // TRAJECTORY_H
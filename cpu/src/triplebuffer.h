@@ -0,0 +1,45 @@
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+
+#include <atomic>
+
+// Hands the latest of a stream of values from one writer thread to one reader thread without
+// either ever waiting on the other. The writer fills the back buffer and publishes it, which
+// swaps it with the middle one; the reader swaps the middle buffer into the front whenever a
+// newer one has been published. Values the reader never got to are simply overwritten.
+template <typename T>
+class TripleBuffer {
+public:
+    TripleBuffer()
+        : m_middle(1), m_back(0), m_front(2) {
+    }
+
+    // Writer side: the buffer to fill next, and handing it over once it's complete
+    inline T &back() { return m_buffers[m_back]; }
+    inline void publish() {
+        m_back = m_middle.exchange(m_back | FRESH, std::memory_order_acq_rel) & INDEX;
+    }
+
+    // Reader side: the newest published value, which stays put until the next call
+    inline const T &read() {
+        if (m_middle.load(std::memory_order_relaxed) & FRESH) {
+            m_front = m_middle.exchange(m_front, std::memory_order_acq_rel) & INDEX;
+        }
+        return m_buffers[m_front];
+    }
+
+    // Reader side: the value last returned by read()
+    inline const T &front() const { return m_buffers[m_front]; }
+
+private:
+    enum {
+        INDEX = 3,
+        FRESH = 4
+    };
+
+    T m_buffers[3];
+    std::atomic<int> m_middle; // index of the middle buffer, flagged FRESH until the reader takes it
+    int m_back, m_front;
+};
+
+#endif // TRIPLEBUFFER_H
@@ -2,7 +2,7 @@
 #include <QApplication>
 #include <QKeyEvent>
 
-View::View(QWidget *parent) : QGLWidget(parent) {
+View::View(QWidget *parent) : QGLWidget(parent), worker(&sim) {
     // View needs all mouse move events, not just mouse drag events
     setMouseTracking(true);
 
@@ -17,7 +17,6 @@ View::View(QWidget *parent) : QGLWidget(parent) {
 
     fps = 60;
     scale = 10;
-    tickTime = 0.0;
     timestepMode = true;
     current = SMOKE_OPEN_TEST;
 }
@@ -34,6 +33,8 @@ void View::initializeGL() {
     // frame rate depends on the operating system and other running programs)
     time.start();
     timer.start(1000 / 60);
+    worker.setPaused(timestepMode);
+    worker.start();
 
     // Center the mouse, which is explained more in mouseMoveEvent() below.
     // This needs to be done here because the mouse may be initially outside
@@ -59,8 +60,10 @@ void View::paintGL() {
 
     glColor3f(1, 1, 1);
     renderText(10, 20, "FPS: " + QString::number((int)(fps)), this->font());
-    renderText(10, 40, "# Particles: " + QString::number(sim.getNumParticles()), this->font());
-    renderText(10, 60, "Kinetic Energy: " + QString::number(sim.getKineticEnergy()), this->font());
+    const RenderSnapshot &snapshot = sim.getRenderSnapshot();
+    renderText(10, 40, "# Particles: " + QString::number((int)snapshot.p.size()), this->font());
+    renderText(10, 60, "Kinetic Energy: " + QString::number(snapshot.kineticEnergy), this->font());
+    renderText(10, 80, "Substeps: " + QString::number(worker.getSubsteps()), this->font());
 }
 
 void View::resizeGL(int w, int h) {
@@ -74,7 +77,7 @@ void View::resizeGL(int w, int h) {
 void View::mousePressEvent(QMouseEvent *event) {
     glm::dvec2 screen(event->x(), height() - event->y());
     glm::dvec2 world = (scale * 2.) * (screen / glm::dvec2(width(), height())) - glm::dvec2((double)scale, (double)scale);
-    sim.mousePressed(world);
+    worker.post([world](Simulation *s) { s->mousePressed(world); });
 }
 
 void View::mouseMoveEvent(QMouseEvent *event) {
@@ -110,87 +113,91 @@ void View::keyPressEvent(QKeyEvent *event) {
     if (event->key() == Qt::Key_Escape)
         QApplication::quit();
     if (event->key() == Qt::Key_R)
-        sim.init(current);
-    if (event->key() == Qt::Key_T)
+        restart();
+    if (event->key() == Qt::Key_T) {
         timestepMode = !timestepMode;
-    if (event->key() == Qt::Key_Space)
-        tickTime = .01;
-    if (event->key() == Qt::Key_Backspace)
-        tickTime = -.01;
+        worker.setPaused(timestepMode);
+    }
+    if (event->key() == Qt::Key_Space && timestepMode)
+        worker.post([](Simulation *s) { s->tick(.01); });
+    if (event->key() == Qt::Key_Backspace && timestepMode)
+        worker.post([](Simulation *s) { s->tick(-.01); });
     if (event->key() == Qt::Key_C)
         sim.debug = !sim.debug;
+    if (event->key() == Qt::Key_U)
+        worker.setSubsteps(worker.getSubsteps() % SOLVER_ITERATIONS + 1);
+    if (event->key() == Qt::Key_F5)
+        worker.post([](Simulation *s) { s->saveSnapshot(CHECKPOINT_PATH); });
+    if (event->key() == Qt::Key_F9)
+        worker.post([](Simulation *s) { s->loadSnapshot(CHECKPOINT_PATH); });
 
     if (event->key() == Qt::Key_1) {
         current = GRANULAR_TEST;
-        sim.init(current);
+        restart();
     } else if (event->key() == Qt::Key_2) {
         current = STACKS_TEST;
-        sim.init(current);
+        restart();
     } else if (event->key() == Qt::Key_3) {
         current = WALL_TEST;
-        sim.init(current);
+        restart();
     } else if (event->key() == Qt::Key_4) {
         current = PENDULUM_TEST;
-        sim.init(current);
+        restart();
     } else if (event->key() == Qt::Key_5) {
         current = ROPE_TEST;
-        sim.init(current);
+        restart();
     } else if (event->key() == Qt::Key_6) {
         current = FLUID_TEST;
-        sim.init(current);
+        restart();
     } else if (event->key() == Qt::Key_7) {
         current = FLUID_SOLID_TEST;
-        sim.init(current);
+        restart();
     } else if (event->key() == Qt::Key_8) {
         current = GAS_ROPE_TEST;
-        sim.init(current);
+        restart();
     } else if (event->key() == Qt::Key_G) {
         current = GAS_TEST;
-        sim.init(current);
+        restart();
     } else if (event->key() == Qt::Key_9) {
         current = FRICTION_TEST;
-        sim.init(current);
+        restart();
     } else if (event->key() == Qt::Key_0) {
         current = WATER_BALLOON_TEST;
-        sim.init(current);
+        restart();
     } else if (event->key() == Qt::Key_N) {
         current = CRADLE_TEST;
-        sim.init(current);
+        restart();
     } else if (event->key() == Qt::Key_S) {
         current = SMOKE_OPEN_TEST;
-        sim.init(current);
+        restart();
     } else if (event->key() == Qt::Key_D) {
         current = SMOKE_CLOSED_TEST;
-        sim.init(current);
+        restart();
     } else if (event->key() == Qt::Key_Period) {
         current = SDF_TEST;
-        sim.init(current);
+        restart();
     } else if (event->key() == Qt::Key_V) {
         current = VOLCANO_TEST;
-        sim.init(current);
+        restart();
     } else if (event->key() == Qt::Key_W) {
         current = WRECKING_BALL;
-        sim.init(current);
+        restart();
     }
 }
 
 void View::keyReleaseEvent(QKeyEvent *event) {
 }
 
+void View::restart() {
+    SimulationType type = current;
+    worker.post([type](Simulation *s) { s->init(type); });
+}
+
 void View::tick() {
     // Get the number of seconds since the last tick (variable update rate)
     double seconds = time.restart() * 0.001;
     fps = .02 / seconds + .98 * fps;
 
-    if (timestepMode) {
-        if (tickTime != 0.0) {
-            sim.tick(tickTime);
-            tickTime = 0.0;
-        }
-    } else {
-        sim.tick(.01);
-    }
-
     // Flag this view for repainting (Qt will call paintGL() soon after)
     update();
 }
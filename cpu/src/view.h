@@ -2,10 +2,14 @@
 #define VIEW_H
 
 #include "simulation.h"
+#include "simulationthread.h"
 
 #include <QTime>
 #include <QTimer>
 
+// Snapshot written by F5 and restored by F9, relative to the working directory
+#define CHECKPOINT_PATH "checkpoint.snap"
+
 class View : public QGLWidget {
     Q_OBJECT
 
@@ -17,14 +21,19 @@ private:
     QTime time;
     QTimer timer;
     double fps;
-    double tickTime;
     double scale;
     bool timestepMode;
 
     glm::ivec2 dimensions;
-    Simulation sim;
     SimulationType current;
 
+    // The simulation runs on its own thread, the view only draws what it publishes
+    Simulation sim;
+    SimulationThread worker;
+
+    // Rebuild the current scene on the simulation thread
+    void restart();
+
     void initializeGL();
     void paintGL();
     void resizeGL(int w, int h);